@@ -0,0 +1,671 @@
+// Microbenchmarks of the curve primitives, serialization and the GS_* API.
+//
+// Usage: bench [-n samples] [-w warmup] [-f filter] [-o output.json]
+//
+// Each benchmark is run `warmup` times, then timed `samples` times, one call
+// at a time, with both the cycle counter and the monotonic clock. A table of
+// percentiles is printed to stderr and the results are written as JSON (to
+// stdout, or to the output file), which bench/compare.js compares against a
+// baseline. Built by build-bench.sh.
+//
+// The core is included (not linked) so that static primitives such as
+// mapit and myhash can be timed directly.
+#define _POSIX_C_SOURCE 199309L // clock_gettime
+#include "../core/group-sign.c"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define COUNTER_NAME "rdtsc"
+#elif defined(__aarch64__)
+#define COUNTER_NAME "cntvct_el0"
+#else
+#define COUNTER_NAME "clock_gettime"
+#endif
+
+static uint64_t nanoseconds()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Note that cntvct_el0 ticks at a fixed frequency, not per cycle
+static uint64_t cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#elif defined(__aarch64__)
+  uint64_t v;
+  __asm__ volatile("isb; mrs %0, cntvct_el0" : "=r"(v));
+  return v;
+#else
+  return nanoseconds();
+#endif
+}
+
+// Fixtures, set up once by setupFixtures
+
+#define BATCH 16
+#define BUFSIZE 2048
+
+static csprng rng;
+static char seed[128];
+static char msg[32];
+static char bsn[32];
+static char challenge[32];
+
+static char issuer[sizeof(GS_State)];
+static char signer[sizeof(GS_State)];
+static char verifier[sizeof(GS_State)];
+static char scratch[sizeof(GS_State)];
+static char preparedKey[sizeof(struct PreparedGroupPublicKey)];
+static char preparedScratch[sizeof(struct PreparedGroupPublicKey)];
+static drbg verifierRng;
+
+static char groupPubKey[BUFSIZE], groupPrivKey[BUFSIZE], gsk[BUFSIZE], joinmsg[BUFSIZE];
+static char joinresp[BUFSIZE], credentials[BUFSIZE], signature[BUFSIZE], signatureV2[BUFSIZE];
+static char preparedExport[sizeof(struct SharedGroupPublicKey)];
+static int groupPubKeyLen, groupPrivKeyLen, gskLen, joinmsgLen, joinrespLen, credentialsLen;
+static int signatureLen, signatureV2Len, preparedExportLen;
+static char out[BUFSIZE], out2[BUFSIZE];
+
+static char* batchMsgs[BATCH];
+static char* batchBsns[BATCH];
+static char* batchSigs[BATCH];
+static char* batchChallenges[BATCH];
+static char* batchJoinmsgs[BATCH];
+static char* batchOuts[BATCH];
+static int batchMsgLens[BATCH], batchBsnLens[BATCH], batchSigLens[BATCH];
+static int batchChallengeLens[BATCH], batchJoinmsgLens[BATCH], batchOutLens[BATCH];
+static char batchOutBuf[BATCH][BUFSIZE];
+static int batchResults[BATCH];
+
+static BIG scalar;
+static ECP g1, p1;
+static ECP2 g2, p2;
+static char hashed[MODBYTES];
+static char big[1024];
+static char ecpBuf[BUFSIZE], ecpBufV2[BUFSIZE], ecp2Buf[BUFSIZE], ecp2BufV2[BUFSIZE];
+static int ecpLen, ecpLenV2, ecp2Len, ecp2LenV2;
+
+static void check(int ret, const char* what)
+{
+  if (ret != GS_RETURN_SUCCESS) {
+    fprintf(stderr, "%s: %s\n", what, GS_error(ret));
+    exit(1);
+  }
+}
+
+static void setupFixtures()
+{
+  // Timings of a broken generator would be meaningless
+  check(GS_selfTest(), "GS_selfTest");
+
+  for (int i = 0; i < 128; ++i) {
+    seed[i] = (char)i;
+  }
+  RAND_seed(&rng, sizeof(seed), seed);
+  drbgSeed(&verifierRng, sizeof(seed), seed);
+
+  GS_initState(issuer);
+  check(GS_seed(issuer, seed, sizeof(seed)), "GS_seed");
+  check(GS_setupGroup(issuer), "GS_setupGroup");
+  groupPubKeyLen = BUFSIZE;
+  check(GS_exportGroupPubKey(issuer, groupPubKey, &groupPubKeyLen), "GS_exportGroupPubKey");
+  groupPrivKeyLen = BUFSIZE;
+  check(GS_exportGroupPrivKey(issuer, groupPrivKey, &groupPrivKeyLen), "GS_exportGroupPrivKey");
+  preparedExportLen = sizeof(preparedExport);
+  check(GS_exportPreparedGroupPubKey(issuer, preparedExport, &preparedExportLen), "GS_exportPreparedGroupPubKey");
+
+  GS_initState(signer);
+  check(GS_seed(signer, seed, sizeof(seed)), "GS_seed");
+  gskLen = joinmsgLen = BUFSIZE;
+  check(GS_startJoin(signer, challenge, sizeof(challenge), gsk, &gskLen, joinmsg, &joinmsgLen), "GS_startJoin");
+  joinrespLen = BUFSIZE;
+  check(GS_processJoin(issuer, joinmsg, joinmsgLen, challenge, sizeof(challenge), joinresp, &joinrespLen), "GS_processJoin");
+  credentialsLen = BUFSIZE;
+  check(GS_finishJoin(groupPubKey, groupPubKeyLen, gsk, gskLen, joinresp, joinrespLen, credentials, &credentialsLen), "GS_finishJoin");
+  check(GS_loadUserCredentials(signer, credentials, credentialsLen), "GS_loadUserCredentials");
+  signatureLen = BUFSIZE;
+  check(GS_sign(signer, msg, sizeof(msg), bsn, sizeof(bsn), signature, &signatureLen), "GS_sign");
+  check(GS_setWireFormat(signer, 2), "GS_setWireFormat");
+  signatureV2Len = BUFSIZE;
+  check(GS_sign(signer, msg, sizeof(msg), bsn, sizeof(bsn), signatureV2, &signatureV2Len), "GS_sign");
+  check(GS_setWireFormat(signer, 1), "GS_setWireFormat");
+
+  GS_initState(verifier);
+  check(GS_seed(verifier, seed, sizeof(seed)), "GS_seed");
+  check(GS_loadGroupPubKey(verifier, groupPubKey, groupPubKeyLen), "GS_loadGroupPubKey");
+  check(GS_prepareGroupPubKey(preparedKey, groupPubKey, groupPubKeyLen), "GS_prepareGroupPubKey");
+
+  for (int i = 0; i < BATCH; ++i) {
+    batchMsgs[i] = msg;
+    batchMsgLens[i] = sizeof(msg);
+    batchBsns[i] = bsn;
+    batchBsnLens[i] = sizeof(bsn);
+    batchSigs[i] = signature;
+    batchSigLens[i] = signatureLen;
+    batchChallenges[i] = challenge;
+    batchChallengeLens[i] = sizeof(challenge);
+    batchJoinmsgs[i] = joinmsg;
+    batchJoinmsgLens[i] = joinmsgLen;
+    batchOuts[i] = batchOutBuf[i];
+  }
+
+  setG1(&g1);
+  setG2(&g2);
+  randomModOrder(scalar, &rng);
+  ECP_copy(&p1, &g1);
+  PAIR_G1mul(&p1, scalar);
+  ECP2_copy(&p2, &g2);
+  PAIR_G2mul(&p2, scalar);
+
+  octet o1 = {0, BUFSIZE, ecpBuf};
+  serialize_ECP_wire(&p1, &o1, WIRE_V1);
+  ecpLen = o1.len;
+  octet o2 = {0, BUFSIZE, ecpBufV2};
+  serialize_ECP_wire(&p1, &o2, WIRE_V2);
+  ecpLenV2 = o2.len;
+  octet o3 = {0, BUFSIZE, ecp2Buf};
+  serialize_ECP2_wire(&p2, &o3, WIRE_V1);
+  ecp2Len = o3.len;
+  octet o4 = {0, BUFSIZE, ecp2BufV2};
+  serialize_ECP2_wire(&p2, &o4, WIRE_V2);
+  ecp2LenV2 = o4.len;
+}
+
+// Untimed preparation steps, run before each timed call
+
+static void newScalar(int i)
+{
+  randomModOrder(scalar, &rng);
+}
+
+static void newHash(int i)
+{
+  memcpy(big, &i, sizeof(i));
+  myhash(big, sizeof(i), hashed);
+}
+
+static void newScratchState(int i)
+{
+  GS_initState(scratch);
+  GS_seed(scratch, seed, sizeof(seed));
+}
+
+static void emptyPreissuePool(int i)
+{
+  clearIssuanceTuples((GS_State*)issuer);
+}
+
+static void emptyPresignPool(int i)
+{
+  clearPresignatures((GS_State*)signer);
+}
+
+static void fillPresignPool(int i)
+{
+  if (GS_getPresignCount(signer, bsn, sizeof(bsn)) == 0) {
+    check(GS_presign(signer, bsn, sizeof(bsn), GS_PRESIGN_POOL_SIZE), "GS_presign");
+  }
+}
+
+static void emptyBasenameCache(int i)
+{
+  GS_setBasenameCacheCapacity(bsnCache.capacity);
+}
+
+// Timed calls
+
+static void bench_PAIR_G1mul(int i)
+{
+  ECP_copy(&p1, &g1);
+  PAIR_G1mul(&p1, scalar);
+}
+
+static void bench_PAIR_G2mul(int i)
+{
+  ECP2_copy(&p2, &g2);
+  PAIR_G2mul(&p2, scalar);
+}
+
+static void bench_combG1mul(int i)
+{
+  combG1mul(&p1, scalar);
+}
+
+static void bench_combG2mul(int i)
+{
+  combG2mul(&p2, scalar);
+}
+
+// Same double-scalar multiplication as proof verification, in constant
+// time (signers and issuers) and variable time (verifiers)
+static void bench_G1mul2(int i)
+{
+  ECP_copy(&p1, &g1);
+  G1mul2(&p1, scalar, &g1, scalar);
+}
+
+static void bench_vtMulN_2(int i)
+{
+  ECP* P[2] = {&g1, &g1};
+  BIG e[2];
+  BIG_copy(e[0], scalar);
+  BIG_copy(e[1], scalar);
+  vtMulN(&p1, P, e, 2);
+}
+
+// Scalars for keys (csprng) and for nonces (see GS_DRBG)
+static void bench_randomModOrder(int i)
+{
+  randomModOrder(scalar, &rng);
+}
+
+static void bench_drbgScalars(int i)
+{
+  drbgScalars(&verifierRng, &scalar, 1, 0);
+}
+
+static void bench_triple_ate(int i)
+{
+  FP12 r;
+  PAIR_normalized_triple_ate(&r, &g2, &p1, &p2, &g1, &g2, &g1);
+}
+
+static void bench_prepared_triple_ate(int i)
+{
+  FP12 r;
+  PAIR_prepared_triple_ate(&r, (struct PreparedGroupPublicKey*)preparedKey, &p1, &g1, &p1);
+}
+
+static void bench_mapit(int i)
+{
+  mapit(hashed, &p1);
+}
+
+static void bench_myhash_32(int i)
+{
+  myhash(msg, sizeof(msg), hashed);
+}
+
+static void bench_myhash_1024(int i)
+{
+  myhash(big, sizeof(big), hashed);
+}
+
+static void bench_serialize_ECP_v1(int i)
+{
+  octet o = {0, BUFSIZE, out};
+  serialize_ECP_wire(&p1, &o, WIRE_V1);
+}
+
+static void bench_serialize_ECP_v2(int i)
+{
+  octet o = {0, BUFSIZE, out};
+  serialize_ECP_wire(&p1, &o, WIRE_V2);
+}
+
+static void bench_deserialize_ECP_v1(int i)
+{
+  octet o = {0, ecpLen, ecpBuf};
+  deserialize_ECP_wire(&o, &p1, WIRE_V1);
+}
+
+static void bench_deserialize_ECP_v2(int i)
+{
+  octet o = {0, ecpLenV2, ecpBufV2};
+  deserialize_ECP_wire(&o, &p1, WIRE_V2);
+}
+
+static void bench_serialize_ECP2_v1(int i)
+{
+  octet o = {0, BUFSIZE, out};
+  serialize_ECP2_wire(&p2, &o, WIRE_V1);
+}
+
+static void bench_serialize_ECP2_v2(int i)
+{
+  octet o = {0, BUFSIZE, out};
+  serialize_ECP2_wire(&p2, &o, WIRE_V2);
+}
+
+static void bench_deserialize_ECP2_v1(int i)
+{
+  octet o = {0, ecp2Len, ecp2Buf};
+  deserialize_ECP2_wire(&o, &p2, WIRE_V1);
+}
+
+static void bench_deserialize_ECP2_v2(int i)
+{
+  octet o = {0, ecp2LenV2, ecp2BufV2};
+  deserialize_ECP2_wire(&o, &p2, WIRE_V2);
+}
+
+static void bench_deserialize_signature(int i)
+{
+  struct Signature sig;
+  octet o = {0, signatureLen, signature};
+  int wire, points;
+  if (deserialize_signature_proof(&o, &sig, &wire, &points)) {
+    deserialize_signature_credentials(&o, &sig, wire, points);
+  }
+}
+
+static void bench_GS_seed(int i)
+{
+  GS_seed(scratch, seed, sizeof(seed));
+}
+
+static void bench_GS_setupGroup(int i)
+{
+  GS_setupGroup(scratch);
+}
+
+static void bench_GS_loadGroupPrivKey(int i)
+{
+  GS_loadGroupPrivKey(scratch, groupPrivKey, groupPrivKeyLen);
+}
+
+// Validation of public keys is cached (see isValidatedPublicKey), so once
+// warmed up this measures deserialization and preparation only
+static void bench_GS_loadGroupPubKey(int i)
+{
+  GS_loadGroupPubKey(scratch, groupPubKey, groupPubKeyLen);
+}
+
+static void bench_GS_loadPreparedGroupPubKey(int i)
+{
+  GS_loadPreparedGroupPubKey(scratch, preparedExport, preparedExportLen);
+}
+
+static void bench_GS_prepareGroupPubKey(int i)
+{
+  GS_prepareGroupPubKey(preparedScratch, groupPubKey, groupPubKeyLen);
+}
+
+static void bench_GS_exportGroupPubKey(int i)
+{
+  int len = BUFSIZE;
+  GS_exportGroupPubKey(issuer, out, &len);
+}
+
+static void bench_GS_exportGroupPrivKey(int i)
+{
+  int len = BUFSIZE;
+  GS_exportGroupPrivKey(issuer, out, &len);
+}
+
+static void bench_GS_exportUserCredentials(int i)
+{
+  int len = BUFSIZE;
+  GS_exportUserCredentials(signer, out, &len);
+}
+
+static void bench_GS_startJoin(int i)
+{
+  int len1 = BUFSIZE, len2 = BUFSIZE;
+  GS_startJoin(scratch, challenge, sizeof(challenge), out, &len1, out2, &len2);
+}
+
+static void bench_GS_processJoin(int i)
+{
+  int len = BUFSIZE;
+  GS_processJoin(issuer, joinmsg, joinmsgLen, challenge, sizeof(challenge), out, &len);
+}
+
+static void bench_GS_processJoinBatch(int i)
+{
+  for (int k = 0; k < BATCH; ++k) {
+    batchOutLens[k] = BUFSIZE;
+  }
+  GS_processJoinBatch(issuer, BATCH, batchJoinmsgs, batchJoinmsgLens, batchChallenges, batchChallengeLens, batchOuts, batchOutLens, batchResults);
+}
+
+static void bench_GS_preissue(int i)
+{
+  GS_preissue(issuer, 1);
+}
+
+static void bench_GS_finishJoin(int i)
+{
+  int len = BUFSIZE;
+  GS_finishJoin(groupPubKey, groupPubKeyLen, gsk, gskLen, joinresp, joinrespLen, out, &len);
+}
+
+static void bench_GS_loadUserCredentials(int i)
+{
+  GS_loadUserCredentials(scratch, credentials, credentialsLen);
+}
+
+static void bench_GS_sign(int i)
+{
+  int len = BUFSIZE;
+  GS_sign(signer, msg, sizeof(msg), bsn, sizeof(bsn), out, &len);
+}
+
+static void bench_GS_presign(int i)
+{
+  GS_presign(signer, bsn, sizeof(bsn), 1);
+}
+
+static void bench_GS_onlineSign(int i)
+{
+  int len = BUFSIZE;
+  GS_onlineSign(signer, msg, sizeof(msg), bsn, sizeof(bsn), out, &len);
+}
+
+static void bench_GS_verify(int i)
+{
+  GS_verify(verifier, msg, sizeof(msg), bsn, sizeof(bsn), signature, signatureLen);
+}
+
+static void bench_GS_verify_v2(int i)
+{
+  GS_verify(verifier, msg, sizeof(msg), bsn, sizeof(bsn), signatureV2, signatureV2Len);
+}
+
+static void bench_GS_verify_r(int i)
+{
+  GS_verify_r(preparedKey, NULL, &verifierRng, msg, sizeof(msg), bsn, sizeof(bsn), signature, signatureLen);
+}
+
+static void bench_GS_verifyBatch(int i)
+{
+  GS_verifyBatch(verifier, BATCH, batchMsgs, batchMsgLens, batchBsns, batchBsnLens, batchSigs, batchSigLens, batchResults);
+}
+
+static void bench_GS_getSignatureTag(int i)
+{
+  int len = BUFSIZE;
+  GS_getSignatureTag(signature, signatureLen, out, &len);
+}
+
+struct Benchmark {
+  const char* name;
+  void (*prepare)(int i); // optional, not timed
+  void (*run)(int i);
+};
+
+static const struct Benchmark benchmarks[] = {
+  {"PAIR_G1mul", newScalar, bench_PAIR_G1mul},
+  {"PAIR_G2mul", newScalar, bench_PAIR_G2mul},
+  {"combG1mul", newScalar, bench_combG1mul},
+  {"combG2mul", newScalar, bench_combG2mul},
+  {"G1mul2", newScalar, bench_G1mul2},
+  {"vtMulN/2", newScalar, bench_vtMulN_2},
+  {"randomModOrder", NULL, bench_randomModOrder},
+  {"drbgScalars", NULL, bench_drbgScalars},
+  {"PAIR_normalized_triple_ate", NULL, bench_triple_ate},
+  {"PAIR_prepared_triple_ate", NULL, bench_prepared_triple_ate},
+  {"mapit", newHash, bench_mapit},
+  {"myhash/32", NULL, bench_myhash_32},
+  {"myhash/1024", NULL, bench_myhash_1024},
+  {"serialize_ECP/v1", NULL, bench_serialize_ECP_v1},
+  {"serialize_ECP/v2", NULL, bench_serialize_ECP_v2},
+  {"deserialize_ECP/v1", NULL, bench_deserialize_ECP_v1},
+  {"deserialize_ECP/v2", NULL, bench_deserialize_ECP_v2},
+  {"serialize_ECP2/v1", NULL, bench_serialize_ECP2_v1},
+  {"serialize_ECP2/v2", NULL, bench_serialize_ECP2_v2},
+  {"deserialize_ECP2/v1", NULL, bench_deserialize_ECP2_v1},
+  {"deserialize_ECP2/v2", NULL, bench_deserialize_ECP2_v2},
+  {"deserialize_signature", NULL, bench_deserialize_signature},
+  {"GS_seed", NULL, bench_GS_seed},
+  {"GS_setupGroup", newScratchState, bench_GS_setupGroup},
+  {"GS_loadGroupPrivKey", newScratchState, bench_GS_loadGroupPrivKey},
+  {"GS_loadGroupPubKey", newScratchState, bench_GS_loadGroupPubKey},
+  {"GS_loadPreparedGroupPubKey", newScratchState, bench_GS_loadPreparedGroupPubKey},
+  {"GS_prepareGroupPubKey", NULL, bench_GS_prepareGroupPubKey},
+  {"GS_exportGroupPubKey", NULL, bench_GS_exportGroupPubKey},
+  {"GS_exportGroupPrivKey", NULL, bench_GS_exportGroupPrivKey},
+  {"GS_exportUserCredentials", NULL, bench_GS_exportUserCredentials},
+  {"GS_startJoin", newScratchState, bench_GS_startJoin},
+  {"GS_processJoin", NULL, bench_GS_processJoin},
+  {"GS_processJoinBatch/16", NULL, bench_GS_processJoinBatch},
+  {"GS_preissue", emptyPreissuePool, bench_GS_preissue},
+  {"GS_finishJoin", NULL, bench_GS_finishJoin},
+  {"GS_loadUserCredentials", newScratchState, bench_GS_loadUserCredentials},
+  {"GS_sign", NULL, bench_GS_sign},
+  {"GS_presign", emptyPresignPool, bench_GS_presign},
+  {"GS_onlineSign", fillPresignPool, bench_GS_onlineSign},
+  {"GS_verify", NULL, bench_GS_verify},
+  {"GS_verify/v2", NULL, bench_GS_verify_v2},
+  {"GS_verify/uncached", emptyBasenameCache, bench_GS_verify},
+  {"GS_verify_r", NULL, bench_GS_verify_r},
+  {"GS_verifyBatch/16", NULL, bench_GS_verifyBatch},
+  {"GS_getSignatureTag", NULL, bench_GS_getSignatureTag},
+};
+
+struct Summary {
+  uint64_t min, p50, p90, p99, max;
+  double mean;
+};
+
+static int compareU64(const void* a, const void* b)
+{
+  uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+  return (x > y) - (x < y);
+}
+
+// Nearest-rank percentiles of n > 0 samples (sorted in place)
+static void summarize(uint64_t* samples, int n, struct Summary* s)
+{
+  qsort(samples, n, sizeof(uint64_t), compareU64);
+  double sum = 0;
+  for (int i = 0; i < n; ++i) {
+    sum += (double)samples[i];
+  }
+  s->min = samples[0];
+  s->p50 = samples[(50 * (n - 1) + 50) / 100];
+  s->p90 = samples[(90 * (n - 1) + 50) / 100];
+  s->p99 = samples[(99 * (n - 1) + 50) / 100];
+  s->max = samples[n - 1];
+  s->mean = sum / n;
+}
+
+static void printSummary(FILE* f, const char* name, struct Summary* s)
+{
+  fprintf(f, "\"%s\": {\"min\": %llu, \"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"max\": %llu, \"mean\": %.1f}",
+          name,
+          (unsigned long long)s->min, (unsigned long long)s->p50, (unsigned long long)s->p90,
+          (unsigned long long)s->p99, (unsigned long long)s->max, s->mean);
+}
+
+static void usage()
+{
+  fprintf(stderr, "usage: bench [-n samples] [-w warmup] [-f filter] [-o output.json]\n");
+  exit(2);
+}
+
+int main(int argc, char** argv)
+{
+  int samples = 200;
+  int warmup = 20;
+  const char* filter = NULL;
+  const char* output = NULL;
+  for (int i = 1; i < argc; ++i) {
+    if (i + 1 >= argc) {
+      usage();
+    }
+    if (!strcmp(argv[i], "-n")) {
+      samples = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "-w")) {
+      warmup = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "-f")) {
+      filter = argv[++i];
+    } else if (!strcmp(argv[i], "-o")) {
+      output = argv[++i];
+    } else {
+      usage();
+    }
+  }
+  if (samples <= 0 || warmup < 0) {
+    usage();
+  }
+
+  FILE* f = stdout;
+  if (output && !(f = fopen(output, "w"))) {
+    perror(output);
+    return 1;
+  }
+
+  uint64_t* cycleSamples = (uint64_t*)malloc(samples * sizeof(uint64_t));
+  uint64_t* nsSamples = (uint64_t*)malloc(samples * sizeof(uint64_t));
+  if (!cycleSamples || !nsSamples) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  setupFixtures();
+
+  fprintf(f, "{\n  \"version\": \"%s\",\n  \"curve\": \"%s\",\n  \"combWidth\": %d,\n  \"counter\": \"%s\",\n  \"samples\": %d,\n  \"warmup\": %d,\n  \"results\": {",
+          GS_version(), GS_curve(), GS_COMB_WIDTH, COUNTER_NAME, samples, warmup);
+  fprintf(stderr, "%-28s %12s %12s %12s %12s\n", "", "p50 cycles", "p90 cycles", "p99 cycles", "p50 us");
+
+  int first = 1;
+  for (size_t b = 0; b < sizeof(benchmarks) / sizeof(benchmarks[0]); ++b) {
+    const struct Benchmark* bench = &benchmarks[b];
+    if (filter && !strstr(bench->name, filter)) {
+      continue;
+    }
+    for (int i = 0; i < warmup + samples; ++i) {
+      if (bench->prepare) {
+        bench->prepare(i);
+      }
+      uint64_t t0 = nanoseconds();
+      uint64_t c0 = cycles();
+      bench->run(i);
+      uint64_t c1 = cycles();
+      uint64_t t1 = nanoseconds();
+      if (i >= warmup) {
+        cycleSamples[i - warmup] = c1 - c0;
+        nsSamples[i - warmup] = t1 - t0;
+      }
+    }
+
+    struct Summary sc, sn;
+    summarize(cycleSamples, samples, &sc);
+    summarize(nsSamples, samples, &sn);
+    fprintf(stderr, "%-28s %12llu %12llu %12llu %12.1f\n", bench->name,
+            (unsigned long long)sc.p50, (unsigned long long)sc.p90, (unsigned long long)sc.p99, sn.p50 / 1000.0);
+
+    fprintf(f, "%s\n    \"%s\": {", first ? "" : ",", bench->name);
+    printSummary(f, "cycles", &sc);
+    fprintf(f, ", ");
+    printSummary(f, "ns", &sn);
+    fprintf(f, "}");
+    first = 0;
+  }
+  fprintf(f, "\n  }\n}\n");
+
+  free(cycleSamples);
+  free(nsSamples);
+  if (f != stdout) {
+    fclose(f);
+  }
+  return 0;
+}
@@ -0,0 +1,50 @@
+'use strict';
+// Compares the output of the native benchmarks (bench/bench.c) with a
+// baseline, by median cycles:
+//
+//   node bench/compare.js baseline.json current.json [threshold]
+//
+// Exits with status 1 if any benchmark is slower than the baseline by more
+// than threshold (a fraction, 0.05 by default).
+const fs = require('fs');
+
+const [baselineFile, currentFile, thresholdArg] = process.argv.slice(2);
+if (!baselineFile || !currentFile) {
+  console.error('usage: node bench/compare.js baseline.json current.json [threshold]');
+  process.exit(2);
+}
+const threshold = thresholdArg === undefined ? 0.05 : Number(thresholdArg);
+const baseline = JSON.parse(fs.readFileSync(baselineFile, 'utf8'));
+const current = JSON.parse(fs.readFileSync(currentFile, 'utf8'));
+
+['curve', 'combWidth', 'counter'].forEach((key) => {
+  if (baseline[key] !== current[key]) {
+    console.warn(`warning: ${key} differs (${baseline[key]} vs ${current[key]})`);
+  }
+});
+
+let regressions = 0;
+console.log(`${'benchmark'.padEnd(28)} ${'baseline'.padStart(12)} ${'current'.padStart(12)} ${'change'.padStart(8)}`);
+Object.keys(current.results).forEach((name) => {
+  const now = current.results[name].cycles.p50;
+  if (!baseline.results[name]) {
+    console.log(`${name.padEnd(28)} ${'-'.padStart(12)} ${String(now).padStart(12)} ${'new'.padStart(8)}`);
+    return;
+  }
+  const before = baseline.results[name].cycles.p50;
+  const change = (now - before) / before;
+  let mark = '';
+  if (change > threshold) {
+    mark = ' slower';
+    regressions += 1;
+  } else if (change < -threshold) {
+    mark = ' faster';
+  }
+  const percent = `${change >= 0 ? '+' : ''}${(100 * change).toFixed(1)}%`;
+  console.log(`${name.padEnd(28)} ${String(before).padStart(12)} ${String(now).padStart(12)} ${percent.padStart(8)}${mark}`);
+});
+
+if (regressions > 0) {
+  console.log(`${regressions} benchmark(s) slower than the baseline by more than ${(100 * threshold).toFixed(1)}%`);
+  process.exit(1);
+}
@@ -3,6 +3,7 @@
         {
             "target_name": "groupsign",
             "sources": [ "groupsign_napi.c" ],
+            "defines": [ "NAPI_VERSION=6" ],
             'link_settings': {
                 'libraries': [
                     '<(module_root_dir)/_build/nativebuild/group-sign.o',
@@ -0,0 +1,26 @@
+#!/bin/bash
+
+set -e
+set -x
+
+# Builds the native microbenchmarks (bench/bench.c) into _build/benchbuild/bench
+
+SCRIPTPATH="$( cd "$(dirname "$0")" ; pwd -P )"
+BUILDFOLDER="$SCRIPTPATH/_build/benchbuild"
+
+if [ -z "$BUILD_TYPE" ]
+then
+  . ./config.default
+fi
+
+# Native compiler:
+AR=${AR:-llvm-ar}
+CC=${CC:-clang}
+CXX=${CXX:-clang++}
+
+. ./build-common.sh
+
+$CC $CFLAGS -D AMCL_CURVE_${CURVE} -D GS_COMB_WIDTH=${GS_COMB_WIDTH:-5} -D GS_STATS=${GS_STATS:-0} -D GS_DRBG=${GS_DRBG:-1} bench/bench.c \
+-I$BUILDFOLDER \
+$BUILDFOLDER/core.a \
+-o $BUILDFOLDER/bench
@@ -24,6 +24,6 @@ set -x
     # Each choice needs to be separated by endline, and last one should be 0.
     echo -e "25\n27\n0" | python3 config64.py)
 
-$CC $CFLAGS -D AMCL_CURVE_${CURVE} -c core/group-sign.c \
+$CC $CFLAGS -D AMCL_CURVE_${CURVE} -D GS_COMB_WIDTH=${GS_COMB_WIDTH:-5} -D GS_THREADS=${GS_THREADS:-0} -D GS_STATS=${GS_STATS:-0} -D GS_DRBG=${GS_DRBG:-1} -D GS_DRBG_RESEED=${GS_DRBG_RESEED:-0} -c core/group-sign.c \
 -I$BUILDFOLDER \
 -o $BUILDFOLDER/group-sign.o
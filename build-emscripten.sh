@@ -32,7 +32,7 @@ CXX=em++
 . ./build-common.sh
 
 name_0="wasm"
-flags_0="-s TOTAL_MEMORY=128KB -s TOTAL_STACK=64KB -s WASM=1 -s EXPORT_NAME='ModuleWasm'"
+flags_0="-s TOTAL_MEMORY=128KB -s TOTAL_STACK=64KB -s ALLOW_MEMORY_GROWTH=1 -s WASM=1 -s EXPORT_NAME='ModuleWasm'"
 name_1="asmjs"
 flags_1="-s WASM=0 -s EXPORT_NAME='ModuleAsmjs'"
 
@@ -68,17 +68,56 @@ EMFLAGS=${!EMFLAGS}
        '_GS_exportGroupPrivKey', \
        '_GS_exportGroupPubKey', \
        '_GS_exportUserCredentials', \
+       '_GS_exportPreparedGroupPubKey', \
+       '_GS_loadPreparedGroupPubKey', \
+       '_GS_setWireFormat', \
        '_GS_processJoin', \
+       '_GS_processJoinBatch', \
+       '_GS_preissue', \
+       '_GS_getPreissueCount', \
+       '_GS_getPreissuePoolSize', \
        '_GS_sign', \
+       '_GS_presign', \
+       '_GS_onlineSign', \
+       '_GS_getPresignCount', \
+       '_GS_getPresignPoolSize', \
        '_GS_verify', \
+       '_GS_verifyBatch', \
+       '_GS_verifyWithReason', \
+       '_GS_getRejectReasonName', \
        '_GS_getSignatureTag', \
+       '_GS_getTagStoreSize', \
+       '_GS_initTagStore', \
+       '_GS_insertTag', \
+       '_GS_expireTags', \
+       '_GS_getTagCount', \
+       '_GS_getTagStoreCapacity', \
+       '_GS_getPreparedKeySize', \
+       '_GS_prepareGroupPubKey', \
+       '_GS_getRNGSize', \
+       '_GS_seedRNG', \
+       '_GS_verify_r', \
+       '_GS_createRevocationList', \
+       '_GS_freeRevocationList', \
+       '_GS_getRevocationListCount', \
+       '_GS_setRevocationList', \
+       '_GS_getRevocationList', \
+       '_GS_setBasenameCacheCapacity', \
+       '_GS_getBasenameCacheStats', \
+       '_GS_getStatsCount', \
+       '_GS_getStatName', \
+       '_GS_getStatsClock', \
+       '_GS_getStats', \
+       '_GS_resetStats', \
        '_GS_initState', \
        '_GS_startJoin', \
        '_GS_finishJoin', \
+       '_GS_selfTest', \
        '_GS_version', \
        '_GS_curve', \
        '_GS_success', \
        '_GS_failure', \
        '_GS_error', \
-       '_GS_getStateSize']")
+       '_GS_getStateSize', \
+       '_GS_getMaxSize']")
 done
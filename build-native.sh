@@ -16,4 +16,10 @@ AR=${AR:-llvm-ar}
 CC=${CC:-clang}
 CXX=${CXX:-clang++}
 
+# The addon runs operations on the libuv threadpool (see signAsync)
+GS_THREADS=1
+
+# Nonce generators also mix in entropy from getrandom (see GS_DRBG_RESEED)
+GS_DRBG_RESEED=${GS_DRBG_RESEED:-64}
+
 . ./build-common.sh
\ No newline at end of file
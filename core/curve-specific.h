@@ -3,16 +3,21 @@
 #include "pair_BN254.h"
 #define HASH_TYPE HASH_TYPE_BN254
 #define MODBYTES MODBYTES_256_56
+#define CURVE_ID 254 // of raw exported memory (see SharedGroupPublicKey)
 
 #if CURVETYPE_BN254!=WEIERSTRASS
 #error "CURVETYPE_BN254 must be WEIERSTRASS"
 #endif
+#define PAIRING_FRIENDLY PAIRING_FRIENDLY_BN254
 
 typedef BIG_256_56 BIG;
+typedef DBIG_256_56 DBIG;
 typedef ECP2_BN254 ECP2;
 typedef ECP_BN254 ECP;
 typedef FP12_BN254 FP12;
+typedef FP_BN254 FP;
 typedef FP2_BN254 FP2;
+typedef FP4_BN254 FP4;
 
 #define BIG_toBytes BIG_256_56_toBytes
 #define BIG_fromBytes BIG_256_56_fromBytes
@@ -64,11 +69,48 @@ typedef FP2_BN254 FP2;
 #define BIG_modmul BIG_256_56_modmul
 #define BIG_modneg BIG_256_56_modneg
 #define ATE_BITS ATE_BITS_BN254
+#define G2_TABLE G2_TABLE_BN254
 #define GS_CURVE "BN254"
 #define PAIR_initmp PAIR_BN254_initmp
 #define PAIR_another PAIR_BN254_another
 #define PAIR_miller PAIR_BN254_miller
 #define OCT_output OCT_BN254_output
+#define ECP_neg ECP_BN254_neg
+#define BIG_mod2m BIG_256_56_mod2m
+#define BIG_iszilch BIG_256_56_iszilch
+#define ECP_inf ECP_BN254_inf
+#define PAIR_precomp PAIR_BN254_precomp
+#define PAIR_another_pc PAIR_BN254_another_pc
+#define ECP2_inf ECP2_BN254_inf
+#define ECP_dbl ECP_BN254_dbl
+#define ECP2_dbl ECP2_BN254_dbl
+#define FP_cmove FP_BN254_cmove
+#define FP2_cmove FP2_BN254_cmove
+#define BIG_copy BIG_256_56_copy
+#define BIG_bit BIG_256_56_bit
+#define CRu CRu_BN254
+#define CURVE_W CURVE_W_BN254
+#define CURVE_SB CURVE_SB_BN254
+#define CURVE_Bnx CURVE_Bnx_BN254
+#define BIG_mul BIG_256_56_mul
+#define BIG_ddiv BIG_256_56_ddiv
+#define BIG_sub BIG_256_56_sub
+#define BIG_zero BIG_256_56_zero
+#define BIG_smul BIG_256_56_smul
+#define BIG_sdiv BIG_256_56_sdiv
+#define BIG_nbits BIG_256_56_nbits
+#define FP_mul FP_BN254_mul
+#define FP_one FP_BN254_one
+#define FP_copy FP_BN254_copy
+#define FP_inv FP_BN254_inv
+#define FP_reduce FP_BN254_reduce
+#define ECP_affine ECP_BN254_affine
+#define BIG_fshr BIG_256_56_fshr
+#define BIG_lastbits BIG_256_56_lastbits
+#define BIG_dec BIG_256_56_dec
+#define BIG_parity BIG_256_56_parity
+#define ECP_sub ECP_BN254_sub
+#define ECP_equals ECP_BN254_equals
 
 #endif
 
@@ -77,16 +119,21 @@ typedef FP2_BN254 FP2;
 #include "pair_BLS383.h"
 #define HASH_TYPE HASH_TYPE_BLS383
 #define MODBYTES MODBYTES_384_58
+#define CURVE_ID 383 // of raw exported memory (see SharedGroupPublicKey)
 
 #if CURVETYPE_BLS383!=WEIERSTRASS
 #error "CURVETYPE_BLS383 must be WEIERSTRASS"
 #endif
+#define PAIRING_FRIENDLY PAIRING_FRIENDLY_BLS383
 
 typedef BIG_384_58 BIG;
+typedef DBIG_384_58 DBIG;
 typedef ECP2_BLS383 ECP2;
 typedef ECP_BLS383 ECP;
 typedef FP12_BLS383 FP12;
+typedef FP_BLS383 FP;
 typedef FP2_BLS383 FP2;
+typedef FP4_BLS383 FP4;
 
 #define BIG_toBytes BIG_384_58_toBytes
 #define BIG_fromBytes BIG_384_58_fromBytes
@@ -129,8 +176,45 @@ typedef FP2_BLS383 FP2;
 #define BIG_modmul BIG_384_58_modmul
 #define BIG_modneg BIG_384_58_modneg
 #define ATE_BITS ATE_BITS_BLS383
+#define G2_TABLE G2_TABLE_BLS383
 #define GS_CURVE "BLS383"
 #define PAIR_initmp PAIR_BLS383_initmp
 #define PAIR_another PAIR_BLS383_another
 #define PAIR_miller PAIR_BLS383_miller
+#define ECP_neg ECP_BLS383_neg
+#define BIG_mod2m BIG_384_58_mod2m
+#define BIG_iszilch BIG_384_58_iszilch
+#define ECP_inf ECP_BLS383_inf
+#define PAIR_precomp PAIR_BLS383_precomp
+#define PAIR_another_pc PAIR_BLS383_another_pc
+#define ECP2_inf ECP2_BLS383_inf
+#define ECP_dbl ECP_BLS383_dbl
+#define ECP2_dbl ECP2_BLS383_dbl
+#define FP_cmove FP_BLS383_cmove
+#define FP2_cmove FP2_BLS383_cmove
+#define BIG_copy BIG_384_58_copy
+#define BIG_bit BIG_384_58_bit
+#define CRu CRu_BLS383
+#define CURVE_W CURVE_W_BLS383
+#define CURVE_SB CURVE_SB_BLS383
+#define CURVE_Bnx CURVE_Bnx_BLS383
+#define BIG_mul BIG_384_58_mul
+#define BIG_ddiv BIG_384_58_ddiv
+#define BIG_sub BIG_384_58_sub
+#define BIG_zero BIG_384_58_zero
+#define BIG_smul BIG_384_58_smul
+#define BIG_sdiv BIG_384_58_sdiv
+#define BIG_nbits BIG_384_58_nbits
+#define FP_mul FP_BLS383_mul
+#define FP_one FP_BLS383_one
+#define FP_copy FP_BLS383_copy
+#define FP_inv FP_BLS383_inv
+#define FP_reduce FP_BLS383_reduce
+#define ECP_affine ECP_BLS383_affine
+#define BIG_fshr BIG_384_58_fshr
+#define BIG_lastbits BIG_384_58_lastbits
+#define BIG_dec BIG_384_58_dec
+#define BIG_parity BIG_384_58_parity
+#define ECP_sub ECP_BLS383_sub
+#define ECP_equals ECP_BLS383_equals
 #endif
@@ -1,4 +1,6 @@
 #include "group-sign.h"
+#include <stdlib.h>
+#include <string.h>
 #ifdef __cplusplus // workaround to allow using the library from C++
 #define C99
 #endif
@@ -14,6 +16,107 @@
 #include <stdio.h>
 #endif
 
+// Process-wide data (the comb tables of the generators and the basename
+// and public key caches) is shared by all states. Builds that use states
+// from several threads at once, such as the native addon, define
+// GS_THREADS to guard it; states themselves are never shared by threads.
+#ifndef GS_THREADS
+#define GS_THREADS 0
+#endif
+
+#if GS_THREADS
+#include <pthread.h>
+static pthread_mutex_t cacheLock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK_CACHES() pthread_mutex_lock(&cacheLock)
+#define UNLOCK_CACHES() pthread_mutex_unlock(&cacheLock)
+#else
+#define LOCK_CACHES()
+#define UNLOCK_CACHES()
+#endif
+
+// Hot-path statistics (see GS_getStats). Without GS_STATS, STAT_BEGIN and
+// STAT_END compile to nothing.
+#ifndef GS_STATS
+#define GS_STATS 0
+#endif
+
+#if GS_STATS
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define STATS_CLOCK "rdtsc"
+static unsigned long long statTicks()
+{
+  return __rdtsc();
+}
+#elif defined(__aarch64__)
+#define STATS_CLOCK "cntvct"
+static unsigned long long statTicks()
+{
+  unsigned long long v;
+  __asm__ volatile("isb; mrs %0, cntvct_el0" : "=r"(v));
+  return v;
+}
+#else
+#include <time.h>
+#define STATS_CLOCK "ns"
+static unsigned long long statTicks()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ull + (unsigned long long)ts.tv_nsec;
+}
+#endif
+
+// Updated with relaxed atomics, since stages run on several threads in
+// the native addon
+static struct {
+  unsigned long long calls;
+  unsigned long long ticks;
+  unsigned long long histogram[GS_STATS_BUCKETS];
+} stats[GS_STAT_COUNT];
+
+static void statRecord(int stat, unsigned long long ticks)
+{
+  int bucket = ticks ? 63 - __builtin_clzll(ticks) : 0;
+  if (bucket >= GS_STATS_BUCKETS) {
+    bucket = GS_STATS_BUCKETS - 1;
+  }
+  __atomic_fetch_add(&stats[stat].calls, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&stats[stat].ticks, ticks, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&stats[stat].histogram[bucket], 1, __ATOMIC_RELAXED);
+}
+
+#define STAT_BEGIN(t) unsigned long long t = statTicks()
+#define STAT_END(stat, t) statRecord(stat, statTicks() - (t))
+#else
+#define STATS_CLOCK ""
+#define STAT_BEGIN(t)
+#define STAT_END(stat, t)
+#endif
+
+// Nonces of signatures and random exponents of verification are drawn
+// from a ChaCha20 generator (see drbgRefill), in whole blocks, instead of
+// one byte at a time from MIRACL's csprng; GS_DRBG=0 uses a csprng for
+// them instead. Group and user keys, and issued credentials, are always
+// drawn from csprng, so that a seed gives the same keys in all builds.
+#ifndef GS_DRBG
+#define GS_DRBG 1
+#endif
+
+// With GS_DRBG_RESEED=n, ChaCha20 generators mix 32 bytes from getrandom
+// (Linux) into their key every n refills, so nonces stay unpredictable
+// even if a seed is reused. Only the native addon sets it.
+#ifndef GS_DRBG_RESEED
+#define GS_DRBG_RESEED 0
+#endif
+
+#if GS_DRBG
+#include <stdint.h>
+#endif
+#if GS_DRBG && GS_DRBG_RESEED
+#include <sys/random.h>
+#endif
+
 #ifndef HASH_TYPE
 #error "HASH_TYPE is not defined. Make sure used curve is supported."
 #endif
@@ -40,16 +143,242 @@
 #define ECP2SIZE (4*MODBYTES)
 #define BIGSIZE MODBYTES
 
+// Width of the fixed-base comb tables (see combPrecompute)
+#ifndef GS_COMB_WIDTH
+#define GS_COMB_WIDTH 5
+#endif
+#define COMB_SIZE (1 << GS_COMB_WIDTH)
+#define COMB_BITS (8 * MODBYTES)
+#define COMB_COLUMNS ((COMB_BITS + GS_COMB_WIDTH - 1) / GS_COMB_WIDTH)
+
 // Output must be at least MODBYTES
 void myhash(char *data, int len, char *output) {
   // HASH_TYPE is also number of output bytes
   //   SHA256 32 /**< SHA-256 hashing */
   //   SHA384 48 /**< SHA-384 hashing */
   //   SHA512 64 /**< SHA-512 hashing */
+  STAT_BEGIN(t);
   octet msg = {len, len, data};
   octet out = {0, MODBYTES, output};
   GPhash(MC_SHA2, HASH_TYPE, &out, HASH_TYPE, &msg, -1, NULL);
+  STAT_END(GS_STAT_HASH, t);
+}
+
+// Random number generators for nonces (see GS_DRBG). They are plain
+// memory, seeded by drbgSeed, so that they can be copied and forked.
+#define DRBG_KEY_SIZE 32
+
+// The seed is hashed into the first key, separated from the csprng that
+// RAND_seed makes from the same seed for keys
+static void drbgSeedKey(char k[DRBG_KEY_SIZE], int len, char* seed)
+{
+  octet S = {len, len, seed};
+  octet L = {7, 7, "GS_DRBG"};
+  octet K = {0, DRBG_KEY_SIZE, k};
+  GPhash(MC_SHA2, HASH_TYPE, &K, DRBG_KEY_SIZE, &S, -1, &L);
+}
+
+#if GS_DRBG
+#define DRBG_BLOCKS 4
+
+// ChaCha20 (RFC 8439) with fast key erasure: each refill computes
+// DRBG_BLOCKS blocks with the current key, the first DRBG_KEY_SIZE bytes
+// become the next key and the rest are handed out (and wiped once used),
+// so the state never reveals earlier output.
+typedef struct {
+  uint32_t key[8];
+  unsigned char buf[64 * DRBG_BLOCKS];
+  int pos; // next unused byte of buf
+#if GS_DRBG_RESEED
+  int refills; // since the last reseed
+#endif
+} drbg;
+
+#define ROTL32(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+#define QUARTERROUND(a, b, c, d) \
+  a += b; d ^= a; d = ROTL32(d, 16); \
+  c += d; b ^= c; b = ROTL32(b, 12); \
+  a += b; d ^= a; d = ROTL32(d, 8); \
+  c += d; b ^= c; b = ROTL32(b, 7)
+
+static uint32_t load32(const unsigned char* p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Block counter of a zero nonce; every key is used for one refill only
+static void chachaBlock(const uint32_t key[8], uint32_t counter, unsigned char out[64])
+{
+  uint32_t in[16] = {
+    0x61707865, 0x3320646e, 0x79622d32, 0x6b206574,
+    key[0], key[1], key[2], key[3], key[4], key[5], key[6], key[7],
+    counter, 0, 0, 0
+  };
+  uint32_t x[16];
+  memcpy(x, in, sizeof(x));
+  for (int i = 0; i < 10; ++i) {
+    QUARTERROUND(x[0], x[4], x[8], x[12]);
+    QUARTERROUND(x[1], x[5], x[9], x[13]);
+    QUARTERROUND(x[2], x[6], x[10], x[14]);
+    QUARTERROUND(x[3], x[7], x[11], x[15]);
+    QUARTERROUND(x[0], x[5], x[10], x[15]);
+    QUARTERROUND(x[1], x[6], x[11], x[12]);
+    QUARTERROUND(x[2], x[7], x[8], x[13]);
+    QUARTERROUND(x[3], x[4], x[9], x[14]);
+  }
+  for (int i = 0; i < 16; ++i) {
+    uint32_t v = x[i] + in[i];
+    out[4 * i] = (unsigned char)v;
+    out[4 * i + 1] = (unsigned char)(v >> 8);
+    out[4 * i + 2] = (unsigned char)(v >> 16);
+    out[4 * i + 3] = (unsigned char)(v >> 24);
+  }
+  memset(x, 0, sizeof(x));
+  memset(in, 0, sizeof(in));
+}
+
+static void drbgRefill(drbg* R)
+{
+  for (int i = 0; i < DRBG_BLOCKS; ++i) {
+    chachaBlock(R->key, (uint32_t)i, &R->buf[64 * i]);
+  }
+  for (int i = 0; i < 8; ++i) {
+    R->key[i] = load32(&R->buf[4 * i]);
+  }
+  memset(R->buf, 0, DRBG_KEY_SIZE);
+  R->pos = DRBG_KEY_SIZE;
+
+#if GS_DRBG_RESEED
+  if (++R->refills >= GS_DRBG_RESEED) {
+    unsigned char e[DRBG_KEY_SIZE];
+    // Without entropy yet, try again on the next refill
+    if (getrandom(e, sizeof(e), GRND_NONBLOCK) == (ssize_t)sizeof(e)) {
+      for (int i = 0; i < 8; ++i) {
+        R->key[i] ^= load32(&e[4 * i]);
+      }
+      R->refills = 0;
+    }
+    memset(e, 0, sizeof(e));
+  }
+#endif
+}
+
+static void drbgSeed(drbg* R, int len, char* seed)
+{
+  char k[DRBG_KEY_SIZE];
+  drbgSeedKey(k, len, seed);
+  for (int i = 0; i < 8; ++i) {
+    R->key[i] = load32((unsigned char*)&k[4 * i]);
+  }
+  memset(k, 0, sizeof(k));
+  memset(R->buf, 0, sizeof(R->buf));
+  R->pos = sizeof(R->buf);
+#if GS_DRBG_RESEED
+  R->refills = 0;
+#endif
+}
+
+static void drbgBytes(drbg* R, char* out, int len)
+{
+  while (len > 0) {
+    if (R->pos == (int)sizeof(R->buf)) {
+      drbgRefill(R);
+    }
+    int n = (int)sizeof(R->buf) - R->pos;
+    if (n > len) {
+      n = len;
+    }
+    memcpy(out, &R->buf[R->pos], n);
+    memset(&R->buf[R->pos], 0, n);
+    R->pos += n;
+    out += n;
+    len -= n;
+  }
+}
+
+// n uniform scalars below the group order, or of the given number of bits
+// if it is less than those of the order. Full-size candidates at or above
+// the order are rejected and drawn again.
+static void drbgScalars(drbg* R, BIG x[], int n, int bits)
+{
+  BIG order;
+  char b[MODBYTES];
+  BIG_rcopy(order, CURVE_Order);
+  if (bits == 0 || bits > BIG_nbits(order)) {
+    bits = BIG_nbits(order);
+  }
+  int bytes = (bits + 7) / 8;
+  memset(b, 0, sizeof(b));
+  for (int i = 0; i < n; ++i) {
+    do {
+      drbgBytes(R, &b[MODBYTES - bytes], bytes);
+      b[MODBYTES - bytes] &= 0xff >> (8 * bytes - bits);
+      BIG_fromBytes(x[i], b);
+    } while (BIG_comp(x[i], order) >= 0);
+  }
+  memset(b, 0, sizeof(b));
+}
+
+// RFC 8439, A.1 test vectors #1 and #2: zero key and nonce, block counters
+// 0 and 1
+static int drbgSelfTest()
+{
+  static const unsigned char expected[2][64] = {
+    {0x76, 0xb8, 0xe0, 0xad, 0xa0, 0xf1, 0x3d, 0x90, 0x40, 0x5d, 0x6a, 0xe5, 0x53, 0x86, 0xbd, 0x28,
+     0xbd, 0xd2, 0x19, 0xb8, 0xa0, 0x8d, 0xed, 0x1a, 0xa8, 0x36, 0xef, 0xcc, 0x8b, 0x77, 0x0d, 0xc7,
+     0xda, 0x41, 0x59, 0x7c, 0x51, 0x57, 0x48, 0x8d, 0x77, 0x24, 0xe0, 0x3f, 0xb8, 0xd8, 0x4a, 0x37,
+     0x6a, 0x43, 0xb8, 0xf4, 0x15, 0x18, 0xa1, 0x1c, 0xc3, 0x87, 0xb6, 0x69, 0xb2, 0xee, 0x65, 0x86},
+    {0x9f, 0x07, 0xe7, 0xbe, 0x55, 0x51, 0x38, 0x7a, 0x98, 0xba, 0x97, 0x7c, 0x73, 0x2d, 0x08, 0x0d,
+     0xcb, 0x0f, 0x29, 0xa0, 0x48, 0xe3, 0x65, 0x69, 0x12, 0xc6, 0x53, 0x3e, 0x32, 0xee, 0x7a, 0xed,
+     0x29, 0xb7, 0x21, 0x76, 0x9c, 0xe6, 0x4e, 0x43, 0xd5, 0x71, 0x33, 0xb0, 0x74, 0xd8, 0x39, 0xd5,
+     0x31, 0xed, 0x1f, 0x28, 0x51, 0x0a, 0xfb, 0x45, 0xac, 0xe1, 0x0a, 0x1f, 0x4b, 0x79, 0x4d, 0x6f},
+  };
+  uint32_t key[8] = {0};
+  unsigned char block[64];
+  for (int i = 0; i < 2; ++i) {
+    chachaBlock(key, (uint32_t)i, block);
+    if (memcmp(block, expected[i], sizeof(block))) {
+      return 0;
+    }
+  }
+  return 1;
+}
+#else
+typedef csprng drbg;
+
+static void drbgSeed(drbg* R, int len, char* seed)
+{
+  char k[DRBG_KEY_SIZE];
+  drbgSeedKey(k, len, seed);
+  RAND_seed(R, sizeof(k), k);
+  memset(k, 0, sizeof(k));
+}
+
+static void drbgBytes(drbg* R, char* out, int len)
+{
+  for (int i = 0; i < len; ++i) {
+    out[i] = RAND_byte(R);
+  }
+}
+
+static void drbgScalars(drbg* R, BIG x[], int n, int bits)
+{
+  BIG order;
+  BIG_rcopy(order, CURVE_Order);
+  for (int i = 0; i < n; ++i) {
+    BIG_randomnum(x[i], order, R);
+    if (bits != 0 && bits < BIG_nbits(order)) {
+      BIG_mod2m(x[i], bits);
+    }
+  }
+}
+
+// The MIRACL generator has no test vectors of its own
+static int drbgSelfTest()
+{
+  return 1;
 }
+#endif
 
 struct GroupPublicKey {
     ECP2 X; // G2 ** x
@@ -104,8 +433,52 @@ struct Signature {
     BIG s;
 };
 
+// Comb tables of the credentials A, B, C and D (see precomputeUserCredentials)
+struct UserCredentialTables {
+    ECP cred[4][COMB_SIZE];
+};
+
+// Everything in a signature but the message: the randomized credentials,
+// NYM and the commitments of the proof of equality, already serialized,
+// and the nonce of the proof (secret).
+struct Presignature {
+    char bsn[MODBYTES]; // H(bsn)
+    char sig[1 + 5 * ECPSIZE]; // A, B, C, D and NYM, in the wire format of the state
+    int sig_len;
+    char proof[6 * ECPSIZE]; // D, NYM, B, BSN, BR and BSNR, as hashed by ECPchallengeEquals
+    BIG rr;
+};
+
+// The part of a join response that does not depend on the join message
+// (see preissue)
+struct IssuanceTuple {
+    ECP A; // G·r
+    ECP B; // A·y
+    ECP xA; // A·x
+    ECP GR; // G·rr
+    BIG ry; // r·y
+    BIG rr; // nonce of the response proof
+};
+
+// Precomputed line functions (see prepareGroupPublicKey)
+struct PreparedGroupPublicKey {
+    FP4 Y[G2_TABLE];
+    FP4 G2[G2_TABLE];
+    FP4 X[G2_TABLE];
+};
+
 // "bindings" -> these are the external interface
 
+// Number of presignatures a state can hold (see GS_presign)
+#ifndef GS_PRESIGN_POOL_SIZE
+#define GS_PRESIGN_POOL_SIZE 16
+#endif
+
+// Number of issuance tuples a state can hold (see GS_preissue)
+#ifndef GS_PREISSUE_POOL_SIZE
+#define GS_PREISSUE_POOL_SIZE 16
+#endif
+
 enum StateFlags {
   GS_SEEDED,
   GS_GROUP_PRIVKEY,
@@ -114,9 +487,18 @@ enum StateFlags {
 };
 
 typedef struct {
-  csprng _rng;
+  csprng _rng; // for keys and credentials
+  drbg _drbg; // for nonces
   struct GroupPrivateKey _priv;
+  struct PreparedGroupPublicKey _prepared; // valid if GS_GROUP_PUBKEY is set
   struct UserPrivateKey _userPriv;
+  struct UserCredentialTables _userTables; // valid if GS_USERCREDS is set
+  struct Presignature _presign[GS_PRESIGN_POOL_SIZE]; // for the current user credentials
+  int _presignCount;
+  struct IssuanceTuple _preissue[GS_PREISSUE_POOL_SIZE]; // for the current group private key
+  int _preissueCount;
+  int _wireFormat; // of exported keys, join messages and responses, and signatures
+  struct RevocationList* _revoked; // owned, NULL if none (see GS_setRevocationList)
   int state;
 } GS_State;
 
@@ -165,6 +547,7 @@ static void log_state(int state)
 
 static void PAIR_normalized_triple_ate(FP12 *r, ECP2 *P, ECP *Q, ECP2 *R, ECP *S, ECP2 *T, ECP *U)
 {
+  STAT_BEGIN(t);
   // Use new multi-pairing mechanism
   FP12 rr[ATE_BITS];
   PAIR_initmp(rr);
@@ -173,6 +556,21 @@ static void PAIR_normalized_triple_ate(FP12 *r, ECP2 *P, ECP *Q, ECP2 *R, ECP *S
   PAIR_another(rr, T, U);
   PAIR_miller(r, rr);
   PAIR_fexp(r);
+  STAT_END(GS_STAT_PAIRING, t);
+}
+
+// Same as PAIR_normalized_triple_ate(r, Y, Q, G2, S, X, U)
+static void PAIR_prepared_triple_ate(FP12 *r, struct PreparedGroupPublicKey *prep, ECP *Q, ECP *S, ECP *U)
+{
+  STAT_BEGIN(t);
+  FP12 rr[ATE_BITS];
+  PAIR_initmp(rr);
+  PAIR_another_pc(rr, prep->Y, Q); // This also normalizes Q with ECP_affine
+  PAIR_another_pc(rr, prep->G2, S);
+  PAIR_another_pc(rr, prep->X, U);
+  PAIR_miller(r, rr);
+  PAIR_fexp(r);
+  STAT_END(GS_STAT_PAIRING, t);
 }
 
 static int serialize_BIG(BIG* in, octet* out)
@@ -290,6 +688,108 @@ static int deserialize_ECP(octet* in, ECP* out)
   return 0;
 }
 
+// Wire formats (see GS_setWireFormat). v1 blobs are the concatenation of
+// uncompressed points and big numbers. v2 blobs start with WIRE_V2_BYTE
+// and use compressed points (the x coordinate and the sign of y). No v1
+// blob can start with that byte: v1 blobs start either with 0x04 (an
+// uncompressed G1 point) or with a coordinate of a G2 point, which is
+// below the field modulus.
+//
+// Only blobs carry a version; points hashed in proofs are always
+// serialized uncompressed with serialize_ECP and serialize_ECP2.
+#define WIRE_V1 1
+#define WIRE_V2 2
+#define WIRE_V2_BYTE 0xC2
+#define ECPSIZE_V2 (MODBYTES + 1)
+#define ECP2SIZE_V2 (2 * MODBYTES + 1)
+
+static int peek_wire_format(octet* in)
+{
+  if (in->len < in->max && (unsigned char)in->val[in->len] == WIRE_V2_BYTE) {
+    return WIRE_V2;
+  }
+  return WIRE_V1;
+}
+
+static int read_wire_format(octet* in)
+{
+  int wire = peek_wire_format(in);
+  if (wire == WIRE_V2) {
+    in->len++;
+  }
+  return wire;
+}
+
+static int write_wire_format(octet* out, int wire)
+{
+  if (wire == WIRE_V1) {
+    return 1;
+  }
+  if (out->len >= out->max) {
+    return 0;
+  }
+  out->val[out->len++] = (char)WIRE_V2_BYTE;
+  return 1;
+}
+
+static int serialize_ECP_wire(ECP* in, octet* out, int wire)
+{
+  if (wire == WIRE_V1) {
+    return serialize_ECP(in, out);
+  }
+  int len = out->len;
+  out->len += ECPSIZE_V2;
+  if (out->len <= out->max) {
+    octet tmp = {0, out->max - len, &out->val[len]};
+    ECP_toOctet(&tmp, in, true);
+    return 1;
+  }
+  return 0;
+}
+
+static int deserialize_ECP_wire(octet* in, ECP* out, int wire)
+{
+  if (wire == WIRE_V1) {
+    return deserialize_ECP(in, out);
+  }
+  int len = in->len;
+  in->len += ECPSIZE_V2;
+  if (in->len <= in->max && (in->val[len] == 0x02 || in->val[len] == 0x03)) {
+    octet tmp = {ECPSIZE_V2, ECPSIZE_V2, &in->val[len]};
+    return ECP_fromOctet(out, &tmp) && 1;
+  }
+  return 0;
+}
+
+static int serialize_ECP2_wire(ECP2* in, octet* out, int wire)
+{
+  if (wire == WIRE_V1) {
+    return serialize_ECP2(in, out);
+  }
+  int len = out->len;
+  out->len += ECP2SIZE_V2;
+  if (out->len <= out->max) {
+    octet tmp = {0, out->max - len, &out->val[len]};
+    ECP2_toOctet(&tmp, in, true);
+    return 1;
+  }
+  return 0;
+}
+
+static int deserialize_ECP2_wire(octet* in, ECP2* out, int wire)
+{
+  if (wire == WIRE_V1) {
+    return deserialize_ECP2(in, out);
+  }
+  int len = in->len;
+  in->len += ECP2SIZE_V2;
+  if (in->len <= in->max && (in->val[len] == 0x02 || in->val[len] == 0x03)) {
+    octet tmp = {ECP2SIZE_V2, ECP2SIZE_V2, &in->val[len]};
+    return ECP2_fromOctet(out, &tmp) && 1;
+  }
+  return 0;
+}
+
 /**
  * ECP_ZZZ_mapit changed. For backward compatibility reasons,
  * we have to use the old implementation. Otherwise, old
@@ -321,111 +821,507 @@ void ECP_mapit_compatibility(ECP *P,octet *W)
 
 static void mapit(char *h, ECP *P)
 {
+    STAT_BEGIN(t);
     octet o = {MODBYTES, MODBYTES, h};
     ECP_mapit_compatibility(P, &o);
+    STAT_END(GS_STAT_MAPIT, t);
 }
 
-static void setG1(ECP* X)
+// Fixed-base comb (Lim-Lee) tables.
+//
+// A scalar e is split into GS_COMB_WIDTH rows of COMB_COLUMNS bits each,
+// and T[i] = Σ_j i_j·2^(j·COMB_COLUMNS)·P for all GS_COMB_WIDTH-bit i.
+// Then e·P costs COMB_COLUMNS doublings and additions, instead of the
+// full scalar multiplication. Each table holds 2^GS_COMB_WIDTH points,
+// so the width trades memory for speed (set in config.common).
+//
+// Note that T[1] is P itself.
+static void combPrecompute(ECP table[COMB_SIZE], ECP* P)
+{
+    ECP Q;
+    ECP_copy(&Q, P);
+    ECP_inf(&table[0]);
+    for (int j = 0; j < GS_COMB_WIDTH; ++j) {
+        // Q = 2^(j·COMB_COLUMNS)·P
+        for (int i = 0; i < (1 << j); ++i) {
+            ECP_copy(&table[(1 << j) + i], &table[i]);
+            ECP_add(&table[(1 << j) + i], &Q);
+        }
+        for (int k = 0; k < COMB_COLUMNS; ++k) {
+            ECP_dbl(&Q);
+        }
+    }
+}
+
+static void combPrecompute2(ECP2 table[COMB_SIZE], ECP2* P)
 {
+    ECP2 Q;
+    ECP2_copy(&Q, P);
+    ECP2_inf(&table[0]);
+    for (int j = 0; j < GS_COMB_WIDTH; ++j) {
+        // Q = 2^(j·COMB_COLUMNS)·P
+        for (int i = 0; i < (1 << j); ++i) {
+            ECP2_copy(&table[(1 << j) + i], &table[i]);
+            ECP2_add(&table[(1 << j) + i], &Q);
+        }
+        for (int k = 0; k < COMB_COLUMNS; ++k) {
+            ECP2_dbl(&Q);
+        }
+    }
+}
+
+// Comb tables for the generators of G1 and G2, built on first use
+static ECP combG1[COMB_SIZE];
+static ECP2 combG2[COMB_SIZE];
+static int combReady = 0;
+
+static void buildCombTables()
+{
+    ECP P;
     BIG x, y;
     BIG_rcopy(x, CURVE_Gx);
     BIG_rcopy(y, CURVE_Gy);
-    ECP_set(X, x, y);
-}
+    ECP_set(&P, x, y);
 
-static void setG2(ECP2* X)
-{
+    ECP2 Q;
     FP2 wx,wy;
     FP_rcopy(&(wx.a),CURVE_Pxa);
     FP_rcopy(&(wx.b),CURVE_Pxb);
     FP_rcopy(&(wy.a),CURVE_Pya);
     FP_rcopy(&(wy.b),CURVE_Pyb);
-    ECP2_set(X,&wx,&wy);
+    ECP2_set(&Q,&wx,&wy);
+
+    combPrecompute(combG1, &P);
+    combPrecompute2(combG2, &Q);
+    combReady = 1;
 }
 
-static void randomModOrder(BIG x, csprng *RNG)
+static void initCombTables()
 {
-    BIG order;
-    BIG_rcopy(order, CURVE_Order);
-    BIG_randomnum(x, order, RNG);
+#if GS_THREADS
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, buildCombTables);
+#else
+    if (!combReady) {
+        buildCombTables();
+    }
+#endif
 }
 
-static void ECP2challenge(ECP2* Y, ECP2* G, ECP2* GR, BIG c)
+// Constant time b == c
+static int teq(int b, int c)
 {
-    char hh[MODBYTES];
-    char tmp[3 * ECP2SIZE];
-    octet TMP = {0, sizeof(tmp), tmp};
+    int x = b ^ c;
+    x -= 1;
+    return (x >> 31) & 1;
+}
 
-    serialize_ECP2(Y, &TMP);
-    serialize_ECP2(G, &TMP);
-    serialize_ECP2(GR, &TMP);
-    myhash(tmp, TMP.len, hh);
+// T = table[idx]. Scalars are secret on the signer and issuer side,
+// so table lookups scan all entries.
+static void selectECP(ECP* T, ECP* table, int size, int idx)
+{
+    ECP_copy(T, &table[0]);
+    for (int i = 1; i < size; ++i) {
+        int d = teq(i, idx);
+        FP_cmove(&T->x, &table[i].x, d);
+        FP_cmove(&T->y, &table[i].y, d);
+        FP_cmove(&T->z, &table[i].z, d);
+    }
+}
 
-    BIG_fromBytes(c, hh);
-    BIG order;
-    BIG_rcopy(order, CURVE_Order);
-    BIG_mod(c, order);
+static void selectECP2(ECP2* T, ECP2* table, int size, int idx)
+{
+    ECP2_copy(T, &table[0]);
+    for (int i = 1; i < size; ++i) {
+        int d = teq(i, idx);
+        FP2_cmove(&T->x, &table[i].x, d);
+        FP2_cmove(&T->y, &table[i].y, d);
+        FP2_cmove(&T->z, &table[i].z, d);
+    }
 }
 
-// message is either NULL or has length MODBYTES
-// If !message c = H(Y|G|GR)
-// If message c = H(m|Y|G|GR)
-static void ECPchallenge(char* message, ECP* Y, ECP* G, ECP* GR, BIG c)
+// Index into the comb tables for column k
+static int combIndex(BIG e, int k)
 {
-    char hh[MODBYTES];
-    char tmp[MODBYTES + 3 * ECPSIZE];
-    octet TMP = {0, sizeof(tmp), tmp};
-    if (message) {
-        for (int i = 0; i < MODBYTES; ++i) {
-            tmp[i] = message[i];
+    int idx = 0;
+    for (int j = 0; j < GS_COMB_WIDTH; ++j) {
+        int bit = j * COMB_COLUMNS + k;
+        if (bit < COMB_BITS) {
+            idx |= BIG_bit(e, bit) << j;
         }
-        TMP.len = MODBYTES;
     }
-    serialize_ECP(Y, &TMP);
-    serialize_ECP(G, &TMP);
-    serialize_ECP(GR, &TMP);
-    myhash(tmp, TMP.len, hh);
+    return idx;
+}
 
-    BIG_fromBytes(c, hh);
-    BIG order;
+// out[i] = e·P_i, where tables[i] is the comb table of P_i. The scalar
+// is reduced and recoded once for all points.
+static void combMulN(ECP* out[], ECP tables[][COMB_SIZE], int n, BIG e)
+{
+    BIG ee, order;
+    ECP T;
     BIG_rcopy(order, CURVE_Order);
-    BIG_mod(c, order);
+    BIG_copy(ee, e);
+    BIG_mod(ee, order);
+
+    for (int i = 0; i < n; ++i) {
+        ECP_inf(out[i]);
+    }
+    for (int k = COMB_COLUMNS - 1; k >= 0; --k) {
+        int idx = combIndex(ee, k);
+        for (int i = 0; i < n; ++i) {
+            selectECP(&T, tables[i], COMB_SIZE, idx);
+            ECP_dbl(out[i]);
+            ECP_add(out[i], &T);
+        }
+    }
 }
 
-// make POK of X such that Y = G ** X
-// v is a random integer mod group order
-// output is T, r
-static void makeECPProof(csprng* RNG, ECP* G, ECP* Y, BIG x, char *message, BIG c, BIG s)
+// P = e·G1
+static void combG1mul(ECP* P, BIG e)
 {
-    BIG r, order;
+    initCombTables();
+    combMulN(&P, &combG1, 1, e);
+}
+
+// P = e·G2
+static void combG2mul(ECP2* P, BIG e)
+{
+    BIG ee, order;
+    ECP2 T;
     BIG_rcopy(order, CURVE_Order);
-    randomModOrder(r, RNG);
-    ECP GR;
-    ECP_copy(&GR, G);
-    PAIR_G1mul(&GR, r);
-    ECPchallenge(message, Y, G, &GR, c);
-    BIG_modmul(s, c, x, order);
-    BIG_add(s, s, r);
-    BIG_mod(s, order);
+    BIG_copy(ee, e);
+    BIG_mod(ee, order);
+    initCombTables();
+
+    ECP2_inf(P);
+    for (int k = COMB_COLUMNS - 1; k >= 0; --k) {
+        selectECP2(&T, combG2, COMB_SIZE, combIndex(ee, k));
+        ECP2_dbl(P);
+        ECP2_add(P, &T);
+    }
 }
 
-static void ECPchallengeEquals(char* message, ECP* Y, ECP* Z, ECP* A, ECP* B, ECP* AR, ECP* BR, BIG c)
+// GLV decomposition e = u[0] + u[1]·λ mod order, where λ·P = (β·x, y)
+// (same as the one used by PAIR_G1mul)
+static void glv(BIG u[2], BIG e)
 {
-    char hh[MODBYTES];
-    char tmp[MODBYTES + 6 * ECPSIZE];
-    octet TMP = {0, sizeof(tmp), tmp};
-    if (message) {
-        for (int i = 0; i < MODBYTES; ++i) {
-            tmp[i] = message[i];
+#if PAIRING_FRIENDLY==BN_CURVE
+    BIG v[2], t, q;
+    DBIG d;
+    BIG_rcopy(q, CURVE_Order);
+    for (int i = 0; i < 2; i++) {
+        BIG_rcopy(t, CURVE_W[i]);
+        BIG_mul(d, t, e);
+        BIG_ddiv(v[i], d, q);
+        BIG_zero(u[i]);
+    }
+    BIG_copy(u[0], e);
+    for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < 2; j++) {
+            BIG_rcopy(t, CURVE_SB[j][i]);
+            BIG_modmul(t, v[j], t, q);
+            BIG_add(u[i], u[i], q);
+            BIG_sub(u[i], u[i], t);
+            BIG_mod(u[i], q);
         }
-        TMP.len = MODBYTES;
     }
-    serialize_ECP(Y, &TMP);
-    serialize_ECP(Z, &TMP);
-    serialize_ECP(A, &TMP);
-    serialize_ECP(B, &TMP);
-    serialize_ECP(AR, &TMP);
-    serialize_ECP(BR, &TMP);
+#else
+    // -(x^2)·P = (β·x, y)
+    BIG x, x2, q;
+    BIG_rcopy(x, CURVE_Bnx);
+    BIG_smul(x2, x, x);
+    BIG_copy(u[0], e);
+    BIG_mod(u[0], x2);
+    BIG_copy(u[1], e);
+    BIG_sdiv(u[1], x2);
+    BIG_rcopy(q, CURVE_Order);
+    BIG_sub(u[1], q, u[1]);
+#endif
+}
+
+// P = a·P + b·Q
+//
+// Interleaved (Straus-Shamir) double-scalar multiplication: with the GLV
+// decomposition, a·P + b·Q = a0·P + a1·λP + b0·Q + b1·λQ, with scalars of
+// half the bits. The four scalars share a single chain of doublings, adding
+// one of the 16 precomputed sums of P, λP, Q and λQ at each bit.
+//
+// Not constant time: the number of doublings depends on the lengths of the
+// scalars, and the sign of each half on its value. Only for public scalars,
+// such as the c and s of the join messages that join_server checks.
+static void G1mul2(ECP* P, BIG a, ECP* Q, BIG b)
+{
+    BIG u[4], t, order;
+    ECP R[4], T[16], S;
+    FP cru;
+    int nb = 0;
+
+    BIG_rcopy(order, CURVE_Order);
+    BIG_copy(t, a);
+    BIG_mod(t, order);
+    glv(u, t);
+    BIG_copy(t, b);
+    BIG_mod(t, order);
+    glv(u + 2, t);
+
+    // R = P, λP, Q, λQ
+    FP_rcopy(&cru, CRu);
+    ECP_copy(&R[0], P);
+    ECP_copy(&R[2], Q);
+    for (int i = 0; i < 4; i += 2) {
+        ECP_copy(&R[i + 1], &R[i]);
+        FP_mul(&(R[i + 1].x), &(R[i + 1].x), &cru);
+    }
+
+    // -u·R = u·(-R): use whichever of u and -u is shorter
+    for (int i = 0; i < 4; i++) {
+        int np = BIG_nbits(u[i]);
+        BIG_modneg(t, u[i], order);
+        int nn = BIG_nbits(t);
+        if (nn < np) {
+            BIG_copy(u[i], t);
+            ECP_neg(&R[i]);
+            np = nn;
+        }
+        BIG_norm(u[i]);
+        if (np > nb) {
+            nb = np;
+        }
+    }
+
+    // T[k] = sum of R[i] for each bit i set in k
+    ECP_inf(&T[0]);
+    for (int i = 0; i < 4; i++) {
+        for (int k = 0; k < (1 << i); k++) {
+            ECP_copy(&T[(1 << i) + k], &T[k]);
+            ECP_add(&T[(1 << i) + k], &R[i]);
+        }
+    }
+
+    ECP_inf(P);
+    for (int j = nb - 1; j >= 0; j--) {
+        int idx = BIG_bit(u[0], j)
+                | (BIG_bit(u[1], j) << 1)
+                | (BIG_bit(u[2], j) << 2)
+                | (BIG_bit(u[3], j) << 3);
+        selectECP(&S, T, 16, idx);
+        ECP_dbl(P);
+        ECP_add(P, &S);
+    }
+}
+
+// Converts the points to affine coordinates with a single field inversion
+// (Montgomery's trick), so that serializing them afterwards is cheap.
+// Points already in affine coordinates only cost a few multiplications.
+static void normalizeECPs(ECP* P[], int n)
+{
+    FP local[8];
+    FP* prod = n <= 8 ? local : (FP*)malloc(n * sizeof(FP));
+    if (!prod) {
+        for (int i = 0; i < n; ++i) {
+            ECP_affine(P[i]);
+        }
+        return;
+    }
+
+    // prod[i] = z_0·...·z_{i-1}, skipping points at infinity
+    FP acc, inv, t;
+    FP_one(&acc);
+    for (int i = 0; i < n; ++i) {
+        FP_copy(&prod[i], &acc);
+        if (!ECP_isinf(P[i])) {
+            FP_mul(&acc, &acc, &P[i]->z);
+        }
+    }
+    FP_inv(&inv, &acc, NULL);
+    for (int i = n - 1; i >= 0; --i) {
+        if (ECP_isinf(P[i])) {
+            continue;
+        }
+        // t = 1/z_i, inv = 1/(z_0·...·z_{i-1})
+        FP_mul(&t, &inv, &prod[i]);
+        FP_mul(&inv, &inv, &P[i]->z);
+        FP_mul(&P[i]->x, &P[i]->x, &t);
+        FP_mul(&P[i]->y, &P[i]->y, &t);
+        FP_reduce(&P[i]->x);
+        FP_reduce(&P[i]->y);
+        FP_one(&P[i]->z);
+    }
+    if (prod != local) {
+        free(prod);
+    }
+}
+
+// Variable-time arithmetic, for verification only
+//
+// Verifiers only multiply public points (signatures and public keys) by
+// public scalars (the c and s of proofs) or by scalars they draw to
+// randomize their checks, which are of no use to anyone once the check is
+// done. Their running time may therefore depend on the scalars, unlike
+// that of signers and issuers, whose scalars are keys and nonces. Nothing
+// but the verify* functions may call vtMulN: secret scalars go through
+// combMulN or PAIR_G1mul, which are constant time. G1mul2 is not (see
+// there) and only takes public scalars too.
+//
+// vtMulN computes a sum of multiples with width-VT_WNAF_WIDTH NAFs of the
+// scalars (split with the GLV decomposition if they are longer than half
+// the group order), which share a single chain of doublings. Only nonzero
+// digits, one in VT_WNAF_WIDTH + 1 on average, cost an addition, and the
+// odd multiples they add are precomputed for each point.
+#define VT_WNAF_WIDTH 5
+#define VT_TABLE_SIZE (1 << (VT_WNAF_WIDTH - 2)) // P, 3·P, ..., 15·P
+#define VT_MAX_TERMS 4
+#define VT_MAX_DIGITS (8 * MODBYTES + 2)
+
+// Width-VT_WNAF_WIDTH NAF of e, which is destroyed: digits are 0 or odd,
+// below 2^(VT_WNAF_WIDTH - 1) in absolute value, and at most one in any
+// VT_WNAF_WIDTH consecutive digits is nonzero. Returns the number of digits.
+static int vtWnaf(signed char naf[VT_MAX_DIGITS], BIG e)
+{
+    int n = 0;
+    BIG_norm(e);
+    while (!BIG_iszilch(e)) {
+        int d = 0;
+        if (BIG_parity(e)) {
+            d = BIG_lastbits(e, VT_WNAF_WIDTH);
+            if (d >= 1 << (VT_WNAF_WIDTH - 1)) {
+                d -= 1 << VT_WNAF_WIDTH;
+                BIG_inc(e, -d);
+            } else {
+                BIG_dec(e, d);
+            }
+            BIG_norm(e);
+        }
+        naf[n++] = (signed char)d;
+        BIG_fshr(e, 1);
+    }
+    return n;
+}
+
+// out = e[0]·P[0] + ... + e[n-1]·P[n-1], with n <= VT_MAX_TERMS
+static void vtMulN(ECP* out, ECP* P[], BIG e[], int n)
+{
+    BIG u[2], t, order;
+    ECP T[2 * VT_MAX_TERMS][VT_TABLE_SIZE], D;
+    signed char naf[2 * VT_MAX_TERMS][VT_MAX_DIGITS];
+    int len[2 * VT_MAX_TERMS];
+    int m = 0, nb = 0;
+    FP cru;
+
+    FP_rcopy(&cru, CRu);
+    BIG_rcopy(order, CURVE_Order);
+    int half = (BIG_nbits(order) + 1) / 2;
+    for (int i = 0; i < n; ++i) {
+        BIG_copy(t, e[i]);
+        BIG_mod(t, order);
+        if (BIG_nbits(t) > half) {
+            glv(u, t);
+        } else {
+            BIG_copy(u[0], t);
+            BIG_zero(u[1]);
+        }
+
+        // Streams R = P[i] and λ·P[i], negated if -u is shorter than u
+        for (int j = 0; j < 2; ++j) {
+            ECP* R = &T[m][0];
+            ECP_copy(R, P[i]);
+            if (j == 1) {
+                FP_mul(&(R->x), &(R->x), &cru);
+            }
+            BIG_modneg(t, u[j], order);
+            if (BIG_nbits(t) < BIG_nbits(u[j])) {
+                BIG_copy(u[j], t);
+                ECP_neg(R);
+            }
+            len[m] = vtWnaf(naf[m], u[j]);
+            if (len[m] == 0) {
+                continue;
+            }
+            if (len[m] > nb) {
+                nb = len[m];
+            }
+            ECP_copy(&D, R);
+            ECP_dbl(&D);
+            for (int k = 1; k < VT_TABLE_SIZE; ++k) {
+                ECP_copy(&T[m][k], &T[m][k - 1]);
+                ECP_add(&T[m][k], &D);
+            }
+            m++;
+        }
+    }
+
+    ECP_inf(out);
+    for (int b = nb - 1; b >= 0; --b) {
+        if (b < nb - 1) {
+            ECP_dbl(out);
+        }
+        for (int k = 0; k < m; ++k) {
+            int d = b < len[k] ? naf[k][b] : 0;
+            if (d > 0) {
+                ECP_add(out, &T[k][d >> 1]);
+            } else if (d < 0) {
+                ECP_sub(out, &T[k][(-d) >> 1]);
+            }
+        }
+    }
+}
+
+static void setG1(ECP* X)
+{
+    initCombTables();
+    ECP_copy(X, &combG1[1]);
+}
+
+static void setG2(ECP2* X)
+{
+    initCombTables();
+    ECP2_copy(X, &combG2[1]);
+}
+
+// For keys and credentials; nonces use drbgScalars
+static void randomModOrder(BIG x, csprng *RNG)
+{
+    BIG order;
+    BIG_rcopy(order, CURVE_Order);
+    BIG_randomnum(x, order, RNG);
+}
+
+static void ECP2challenge(ECP2* Y, ECP2* G, ECP2* GR, BIG c)
+{
+    char hh[MODBYTES];
+    char tmp[3 * ECP2SIZE];
+    octet TMP = {0, sizeof(tmp), tmp};
+
+    serialize_ECP2(Y, &TMP);
+    serialize_ECP2(G, &TMP);
+    serialize_ECP2(GR, &TMP);
+    myhash(tmp, TMP.len, hh);
+
+    BIG_fromBytes(c, hh);
+    BIG order;
+    BIG_rcopy(order, CURVE_Order);
+    BIG_mod(c, order);
+}
+
+// message is either NULL or has length MODBYTES
+// If !message c = H(Y|G|GR)
+// If message c = H(m|Y|G|GR)
+static void ECPchallenge(char* message, ECP* Y, ECP* G, ECP* GR, BIG c)
+{
+    char hh[MODBYTES];
+    char tmp[MODBYTES + 3 * ECPSIZE];
+    octet TMP = {0, sizeof(tmp), tmp};
+    if (message) {
+        for (int i = 0; i < MODBYTES; ++i) {
+            tmp[i] = message[i];
+        }
+        TMP.len = MODBYTES;
+    }
+    ECP* P[3] = {Y, G, GR};
+    normalizeECPs(P, 3);
+    serialize_ECP(Y, &TMP);
+    serialize_ECP(G, &TMP);
+    serialize_ECP(GR, &TMP);
     myhash(tmp, TMP.len, hh);
 
     BIG_fromBytes(c, hh);
@@ -434,93 +1330,104 @@ static void ECPchallengeEquals(char* message, ECP* Y, ECP* Z, ECP* A, ECP* B, EC
     BIG_mod(c, order);
 }
 
-static void makeECPProofEquals(csprng* RNG, ECP* A, ECP* B, ECP* Y, ECP* Z, BIG x, char* message, BIG c, BIG s)
+// make POK of X such that Y = G ** X, G the generator of G1
+// v is a random integer mod group order
+// output is T, r
+static void makeECPProof(csprng* RNG, ECP* Y, BIG x, char *message, BIG c, BIG s)
 {
     BIG r, order;
     BIG_rcopy(order, CURVE_Order);
     randomModOrder(r, RNG);
-    ECP AR, BR;
-    ECP_copy(&AR, A);
-    ECP_copy(&BR, B);
-    PAIR_G1mul(&AR, r);
-    PAIR_G1mul(&BR, r);
-    ECPchallengeEquals(message, Y, Z, A, B, &AR, &BR, c);
+    ECP G, GR;
+    setG1(&G);
+    combG1mul(&GR, r);
+    ECPchallenge(message, Y, &G, &GR, c);
     BIG_modmul(s, c, x, order);
     BIG_add(s, s, r);
     BIG_mod(s, order);
 }
 
-// POK of X such that Y = G ** X
-// verify that T = (G ** R) * (Y ** C), C = H(G, Y, T)
-static int verifyECPProof(ECP* G, ECP* Y, char* message, BIG c, BIG s)
+static void ECPchallengeEquals(char* message, ECP* Y, ECP* Z, ECP* A, ECP* B, ECP* AR, ECP* BR, BIG c)
 {
-    BIG cn, order;
+    char hh[MODBYTES];
+    char tmp[MODBYTES + 6 * ECPSIZE];
+    octet TMP = {0, sizeof(tmp), tmp};
+    if (message) {
+        for (int i = 0; i < MODBYTES; ++i) {
+            tmp[i] = message[i];
+        }
+        TMP.len = MODBYTES;
+    }
+    // Serializing converts each point to affine coordinates, one inversion
+    // per point; the commitments AR and BR are always projective
+    ECP* P[6] = {Y, Z, A, B, AR, BR};
+    normalizeECPs(P, 6);
+    serialize_ECP(Y, &TMP);
+    serialize_ECP(Z, &TMP);
+    serialize_ECP(A, &TMP);
+    serialize_ECP(B, &TMP);
+    serialize_ECP(AR, &TMP);
+    serialize_ECP(BR, &TMP);
+    myhash(tmp, TMP.len, hh);
+
+    BIG_fromBytes(c, hh);
+    BIG order;
     BIG_rcopy(order, CURVE_Order);
-    BIG_modneg(cn, c, order);
-    ECP GS, YC;
-    ECP_copy(&GS, G);
-    ECP_copy(&YC, Y);
-    PAIR_G1mul(&GS, s);
-    PAIR_G1mul(&YC, cn);
-    ECP_add(&GS, &YC);
-    BIG cc;
-    ECPchallenge(message, Y, G, &GS, cc);
-    return BIG_comp(c, cc) == 0;
+    BIG_mod(c, order);
 }
 
 static int verifyECPProofEquals(ECP* A, ECP* B, ECP* Y, ECP* Z, char* message, BIG c, BIG s)
 {
     BIG cn, order;
+    STAT_BEGIN(t);
     BIG_rcopy(order, CURVE_Order);
     BIG_modneg(cn, c, order);
-    ECP AS, YC, BS, ZC;
-    ECP_copy(&AS, A);
-    ECP_copy(&YC, Y);
-    ECP_copy(&BS, B);
-    ECP_copy(&ZC, Z);
-    PAIR_G1mul(&AS, s);
-    PAIR_G1mul(&YC, cn);
-    PAIR_G1mul(&BS, s);
-    PAIR_G1mul(&ZC, cn);
-    ECP_add(&AS, &YC);
-    ECP_add(&BS, &ZC);
+    ECP AS, BS;
+    ECP* PA[2] = {A, Y};
+    ECP* PB[2] = {B, Z};
+    BIG E[2];
+    BIG_copy(E[0], s);
+    BIG_copy(E[1], cn);
+    vtMulN(&AS, PA, E, 2);
+    vtMulN(&BS, PB, E, 2);
     BIG cc;
     ECPchallengeEquals(message, Y, Z, A, B, &AS, &BS, cc);
+    STAT_END(GS_STAT_PROOF, t);
     return BIG_comp(c, cc) == 0;
 }
 
-// make POK of X such that Y = G ** X
+// make POK of X such that Y = G ** X, G the generator of G2
 // output is c, s
-static void makeECP2Proof(csprng* RNG, ECP2* G, ECP2* Y, BIG x, BIG c, BIG s)
+static void makeECP2Proof(csprng* RNG, ECP2* Y, BIG x, BIG c, BIG s)
 {
     BIG r, order;
     BIG_rcopy(order, CURVE_Order);
     randomModOrder(r, RNG);
-    ECP2 GR;
-    ECP2_copy(&GR, G);
-    PAIR_G2mul(&GR, r);
-    ECP2challenge(Y, G, &GR, c);
+    ECP2 G, GR;
+    setG2(&G);
+    combG2mul(&GR, r);
+    ECP2challenge(Y, &G, &GR, c);
     BIG_modmul(s, c, x, order);
     BIG_add(s, s, r);
     BIG_mod(s, order);
 }
 
 
-// POK of X such that Y = G ** X
+// POK of X such that Y = G ** X, G the generator of G2
 // verify that T = (G ** R) * (Y ** C), C = H(G, Y, T)
-static int verifyECP2Proof(ECP2* G, ECP2* Y, BIG c, BIG s)
+static int verifyECP2Proof(ECP2* Y, BIG c, BIG s)
 {
     BIG cn, order;
     BIG_rcopy(order, CURVE_Order);
     BIG_modneg(cn, c, order);
-    ECP2 GS, YC;
-    ECP2_copy(&GS, G);
+    ECP2 G, GS, YC;
+    setG2(&G);
+    combG2mul(&GS, s);
     ECP2_copy(&YC, Y);
-    PAIR_G2mul(&GS, s);
     PAIR_G2mul(&YC, cn);
     ECP2_add(&GS, &YC);
     BIG cc;
-    ECP2challenge(Y, G, &GS, cc);
+    ECP2challenge(Y, &G, &GS, cc);
     return BIG_comp(c, cc) == 0;
 }
 
@@ -550,47 +1457,55 @@ static int verifyECP2Proof(ECP2* G, ECP2* Y, BIG c, BIG s)
 // e((-e1·B) + (-e2·C), G2)·
 // e(e2·(A + D), X) == 1?
 //
-static int verifyAuxFast(ECP* A, ECP* B, ECP* C, ECP* D, ECP2* X, ECP2 *Y, csprng *RNG) {
-  ECP AA, BB, CC;
-  ECP2 G2;
-  BIG e1, e2, ne1, ne2, order;
-  FP12 w, y;
+// The G1 arguments of the pairings are computed by verifyAuxPoints, the
+// pairings by either verifyAuxFast (arbitrary public key) or verifyAuxPrepared
+// (precomputed line functions of the public key, see prepareGroupPublicKey).
+static int verifyAuxPoints(ECP* A, ECP* B, ECP* C, ECP* D, ECP* AA, ECP* BB, ECP* CC, drbg *RNG) {
+  BIG E[2], order;
+  ECP AD;
 
   // A != 1
   if (ECP_isinf(A)) {
       return 0;
   }
 
+  STAT_BEGIN(t);
   BIG_rcopy(order, CURVE_Order);
-  setG2(&G2);
 
   // These factors can be half the bits of the group order, but this is
   // because of efficiency. Not sure if this makes a difference with milagro-crypto-c, would
   // need to test.
-  randomModOrder(e1, RNG);
-  randomModOrder(e2, RNG);
-  BIG_modneg(ne1, e1, order);
-  BIG_modneg(ne2, e2, order);
+  drbgScalars(RNG, E, 2, 0);
 
   // AA = e1·A
-  ECP_copy(&AA, A);
-  PAIR_G1mul(&AA, e1);
-
-  // BB = -e1·B
-  ECP_copy(&BB, B);
-  PAIR_G1mul(&BB, ne1);
+  vtMulN(AA, &A, E, 1);
 
-  // CC = -e2·C
-  ECP_copy(&CC, C);
-  PAIR_G1mul(&CC, ne2);
+  // CC = e2·(A + D)
+  ECP* pAD = &AD;
+  ECP_copy(&AD, A);
+  ECP_add(&AD, D);
+  vtMulN(CC, &pAD, &E[1], 1);
 
   // BB = (-e1·B) + (-e2·C)
-  ECP_add(&BB, &CC);
+  ECP* P[2] = {B, C};
+  BIG_modneg(E[0], E[0], order);
+  BIG_modneg(E[1], E[1], order);
+  vtMulN(BB, P, E, 2);
 
-  // CC = e2·(A + D)
-  ECP_copy(&CC, A);
-  ECP_add(&CC, D);
-  PAIR_G1mul(&CC, e2);
+  STAT_END(GS_STAT_AUX, t);
+  return 1;
+}
+
+static int verifyAuxFast(ECP* A, ECP* B, ECP* C, ECP* D, ECP2* X, ECP2 *Y, drbg *RNG) {
+  ECP AA, BB, CC;
+  ECP2 G2;
+  FP12 w, y;
+
+  if (!verifyAuxPoints(A, B, C, D, &AA, &BB, &CC, RNG)) {
+      return 0;
+  }
+
+  setG2(&G2);
 
   // w = e(e1·A, Y)·e((-e1·B) + (-e2·C), G2)·e(e2·(A + D), X)
   PAIR_normalized_triple_ate(&w, Y, &AA, &G2, &BB, X, &CC);
@@ -604,11 +1519,44 @@ static int verifyAuxFast(ECP* A, ECP* B, ECP* C, ECP* D, ECP2* X, ECP2 *Y, csprn
   return 1;
 }
 
-static int serialize_group_public_key(struct GroupPublicKey* in, octet* out)
+// The G2 arguments of the pairings above are always Y, G2 and X. Their
+// line functions in the Miller loop only depend on them, so they are
+// computed once when the group public key is set.
+static void prepareGroupPublicKey(struct GroupPublicKey *pub, struct PreparedGroupPublicKey *prep)
+{
+    ECP2 G2;
+    setG2(&G2);
+
+    PAIR_precomp(prep->Y, &pub->Y);
+    PAIR_precomp(prep->G2, &G2);
+    PAIR_precomp(prep->X, &pub->X);
+}
+
+static int verifyAuxPrepared(ECP* A, ECP* B, ECP* C, ECP* D, struct PreparedGroupPublicKey *prep, drbg *RNG) {
+  ECP AA, BB, CC;
+  FP12 w, y;
+
+  if (!verifyAuxPoints(A, B, C, D, &AA, &BB, &CC, RNG)) {
+      return 0;
+  }
+
+  // w = e(e1·A, Y)·e((-e1·B) + (-e2·C), G2)·e(e2·(A + D), X)
+  PAIR_prepared_triple_ate(&w, prep, &AA, &BB, &CC);
+
+  FP12_one(&y);
+
+  if (!FP12_equals(&w, &y)) {
+      return 0;
+  }
+
+  return 1;
+}
+
+static int serialize_group_public_key_fields(struct GroupPublicKey* in, octet* out, int wire)
 {
   return
-  serialize_ECP2(&in->X, out) &&
-  serialize_ECP2(&in->Y, out) &&
+  serialize_ECP2_wire(&in->X, out, wire) &&
+  serialize_ECP2_wire(&in->Y, out, wire) &&
   serialize_BIG(&in->cx, out) &&
   serialize_BIG(&in->sx, out) &&
   serialize_BIG(&in->cy, out) &&
@@ -617,28 +1565,92 @@ static int serialize_group_public_key(struct GroupPublicKey* in, octet* out)
 
 static int verifyGroupPublicKey(struct GroupPublicKey *pub)
 {
-    ECP2 W;
-    setG2(&W);
+    return verifyECP2Proof(&pub->X, pub->cx, pub->sx)
+        && verifyECP2Proof(&pub->Y, pub->cy, pub->sy);
+}
+
+// Process-wide cache of the hashes of serialized group public keys that
+// passed verifyGroupPublicKey, so that the proofs (four G2 scalar
+// multiplications) are checked once per distinct key. Replacement is
+// round-robin; only valid keys are remembered.
+#ifndef GS_PUBKEY_CACHE_SIZE
+#define GS_PUBKEY_CACHE_SIZE 16
+#endif
+
+static struct {
+    char h[GS_PUBKEY_CACHE_SIZE][MODBYTES];
+    int size;
+    int next;
+} pubKeyCache;
+
+static int isValidatedPublicKey(char* h)
+{
+    for (int i = 0; i < pubKeyCache.size; ++i) {
+        if (!memcmp(pubKeyCache.h[i], h, MODBYTES)) {
+            return 1;
+        }
+    }
+    return 0;
+}
 
-    return verifyECP2Proof(&W, &pub->X, pub->cx, pub->sx)
-        && verifyECP2Proof(&W, &pub->Y, pub->cy, pub->sy);
+static void rememberValidatedPublicKey(char* h)
+{
+    memcpy(pubKeyCache.h[pubKeyCache.next], h, MODBYTES);
+    pubKeyCache.next = (pubKeyCache.next + 1) % GS_PUBKEY_CACHE_SIZE;
+    if (pubKeyCache.size < GS_PUBKEY_CACHE_SIZE) {
+        pubKeyCache.size++;
+    }
 }
 
-static int deserialize_group_public_key(octet* in, struct GroupPublicKey* out)
+static int deserialize_group_public_key_fields(octet* in, struct GroupPublicKey* out, int wire)
+{
+  int start = in->len;
+  if (!(
+    deserialize_ECP2_wire(in, &out->X, wire) &&
+    deserialize_ECP2_wire(in, &out->Y, wire) &&
+    deserialize_BIG(in, &out->cx) &&
+    deserialize_BIG(in, &out->sx) &&
+    deserialize_BIG(in, &out->cy) &&
+    deserialize_BIG(in, &out->sy))) {
+    return 0;
+  }
+
+  // TODO: should this be done here?
+  char h[MODBYTES];
+  myhash(&in->val[start], in->len - start, h);
+  LOCK_CACHES();
+  int validated = isValidatedPublicKey(h);
+  UNLOCK_CACHES();
+  if (validated) {
+    return 1;
+  }
+  if (!verifyGroupPublicKey(out)) {
+    return 0;
+  }
+  LOCK_CACHES();
+  rememberValidatedPublicKey(h);
+  UNLOCK_CACHES();
+  return 1;
+}
+
+static int serialize_group_public_key(struct GroupPublicKey* in, octet* out, int wire)
 {
   return
-  deserialize_ECP2(in, &out->X) &&
-  deserialize_ECP2(in, &out->Y) &&
-  deserialize_BIG(in, &out->cx) &&
-  deserialize_BIG(in, &out->sx) &&
-  deserialize_BIG(in, &out->cy) &&
-  deserialize_BIG(in, &out->sy) &&
-  verifyGroupPublicKey(out); // TODO: should this be done here?
+  write_wire_format(out, wire) &&
+  serialize_group_public_key_fields(in, out, wire);
+}
+
+static int deserialize_group_public_key(octet* in, struct GroupPublicKey* out)
+{
+  int wire = read_wire_format(in);
+  return deserialize_group_public_key_fields(in, out, wire);
 }
 
-static int serialize_group_private_key(struct GroupPrivateKey* in, octet* out)
+static int serialize_group_private_key(struct GroupPrivateKey* in, octet* out, int wire)
 {
-  return serialize_group_public_key(&in->pub, out) &&
+  return
+  write_wire_format(out, wire) &&
+  serialize_group_public_key_fields(&in->pub, out, wire) &&
   serialize_BIG(&in->x, out) &&
   serialize_BIG(&in->y, out);
 }
@@ -646,203 +1658,290 @@ static int serialize_group_private_key(struct GroupPrivateKey* in, octet* out)
 static int _checkPrivateKey(struct GroupPrivateKey* key)
 {
   ECP2 X, Y;
-  setG2(&X);
-  setG2(&Y);
-  PAIR_G2mul(&X, key->x);
-  PAIR_G2mul(&Y, key->y);
+  combG2mul(&X, key->x);
+  combG2mul(&Y, key->y);
   return ECP2_equals(&X, &key->pub.X) && ECP2_equals(&Y, &key->pub.Y);
 }
 
 static int deserialize_group_private_key(octet* in, struct GroupPrivateKey* out)
 {
-  return deserialize_group_public_key(in, &out->pub) &&
+  int wire = read_wire_format(in);
+  return deserialize_group_public_key_fields(in, &out->pub, wire) &&
   deserialize_BIG(in, &out->x) &&
   deserialize_BIG(in, &out->y) &&
   _checkPrivateKey(out); // TODO: should this be done here?
 }
 
-static int serialize_join_message(struct JoinMessage* in, octet* out)
+static int serialize_join_message(struct JoinMessage* in, octet* out, int wire)
 {
   return
-  serialize_ECP(&in->Q, out) &&
+  write_wire_format(out, wire) &&
+  serialize_ECP_wire(&in->Q, out, wire) &&
   serialize_BIG(&in->c, out) &&
   serialize_BIG(&in->s, out);
 }
 
 static int deserialize_join_message(octet* in, struct JoinMessage* out)
 {
+  int wire = read_wire_format(in);
   return
-  deserialize_ECP(in, &out->Q) &&
+  deserialize_ECP_wire(in, &out->Q, wire) &&
   deserialize_BIG(in, &out->c) &&
   deserialize_BIG(in, &out->s);
 }
 
-static int serialize_user_credentials(struct UserCredentials* in, octet* out)
+static int serialize_user_credentials(struct UserCredentials* in, octet* out, int wire)
 {
   return
-  serialize_ECP(&in->A, out) &&
-  serialize_ECP(&in->B, out) &&
-  serialize_ECP(&in->C, out) &&
-  serialize_ECP(&in->D, out);
+  serialize_ECP_wire(&in->A, out, wire) &&
+  serialize_ECP_wire(&in->B, out, wire) &&
+  serialize_ECP_wire(&in->C, out, wire) &&
+  serialize_ECP_wire(&in->D, out, wire);
 }
 
-static int deserialize_user_credentials(octet* in, struct UserCredentials* out)
+static int deserialize_user_credentials(octet* in, struct UserCredentials* out, int wire)
 {
   return
-  deserialize_ECP(in, &out->A) &&
-  deserialize_ECP(in, &out->B) &&
-  deserialize_ECP(in, &out->C) &&
-  deserialize_ECP(in, &out->D);
+  deserialize_ECP_wire(in, &out->A, wire) &&
+  deserialize_ECP_wire(in, &out->B, wire) &&
+  deserialize_ECP_wire(in, &out->C, wire) &&
+  deserialize_ECP_wire(in, &out->D, wire);
 }
 
-static int serialize_join_response(struct JoinResponse* in, octet* out)
+static int serialize_join_response(struct JoinResponse* in, octet* out, int wire)
 {
   return
-  serialize_user_credentials(&in->cred, out) &&
+  write_wire_format(out, wire) &&
+  serialize_user_credentials(&in->cred, out, wire) &&
   serialize_BIG(&in->c, out) &&
   serialize_BIG(&in->s, out);
 }
 
 static int deserialize_join_response(octet* in, struct JoinResponse* out)
 {
+  int wire = read_wire_format(in);
   return
-  deserialize_user_credentials(in, &out->cred) &&
+  deserialize_user_credentials(in, &out->cred, wire) &&
   deserialize_BIG(in, &out->c) &&
   deserialize_BIG(in, &out->s);
 }
 
-static int serialize_user_private_key(struct UserPrivateKey* in, octet* out)
+static int serialize_user_private_key(struct UserPrivateKey* in, octet* out, int wire)
 {
   return
-  serialize_user_credentials(&in->cred, out) &&
+  write_wire_format(out, wire) &&
+  serialize_user_credentials(&in->cred, out, wire) &&
   serialize_BIG(&in->gsk, out);
 }
 
 static int deserialize_user_private_key(octet* in, struct UserPrivateKey* out)
 {
+  int wire = read_wire_format(in);
   return
-  deserialize_user_credentials(in, &out->cred) &&
+  deserialize_user_credentials(in, &out->cred, wire) &&
   deserialize_BIG(in, &out->gsk);
 }
 
-static int serialize_signature(struct Signature* in, octet* out)
+// Signatures are decoded in two steps, so that verification can reject
+// them before decoding (and checking that they are on the curve) the
+// points that only the pairings need. deserialize_signature_proof decodes
+// what the proof of equality needs: B, D, NYM, c and s.
+// deserialize_signature_credentials then decodes A and C, given the
+// format and the offset of the points that the first step returns.
+static int deserialize_signature_proof(octet* in, struct Signature* out, int* wire, int* points)
 {
-  return
-  serialize_ECP(&in->A, out) &&
-  serialize_ECP(&in->B, out) &&
-  serialize_ECP(&in->C, out) &&
-  serialize_ECP(&in->D, out) &&
-  serialize_ECP(&in->NYM, out) &&
-  serialize_BIG(&in->c, out) &&
-  serialize_BIG(&in->s, out);
+  STAT_BEGIN(t);
+  *wire = read_wire_format(in);
+  *points = in->len;
+  int size = *wire == WIRE_V1 ? ECPSIZE : ECPSIZE_V2;
+  in->len = *points + size; // skip A
+  int ok = deserialize_ECP_wire(in, &out->B, *wire);
+  in->len += size; // skip C
+  ok = ok &&
+  deserialize_ECP_wire(in, &out->D, *wire) &&
+  deserialize_ECP_wire(in, &out->NYM, *wire) &&
+  deserialize_BIG(in, &out->c) &&
+  deserialize_BIG(in, &out->s);
+  STAT_END(GS_STAT_DESERIALIZE, t);
+  return ok;
 }
 
-static int deserialize_signature(octet* in, struct Signature* out)
+static int deserialize_signature_credentials(octet* in, struct Signature* out, int wire, int points)
 {
-  return
-  deserialize_ECP(in, &out->A) &&
-  deserialize_ECP(in, &out->B) &&
-  deserialize_ECP(in, &out->C) &&
-  deserialize_ECP(in, &out->D) &&
-  deserialize_ECP(in, &out->NYM) &&
-  deserialize_BIG(in, &out->c) &&
-  deserialize_BIG(in, &out->s);
+  STAT_BEGIN(t);
+  int size = wire == WIRE_V1 ? ECPSIZE : ECPSIZE_V2;
+  octet o = {points, in->max, in->val};
+  int ok = deserialize_ECP_wire(&o, &out->A, wire);
+  o.len += size; // skip B
+  ok = ok && deserialize_ECP_wire(&o, &out->C, wire);
+  STAT_END(GS_STAT_DESERIALIZE, t);
+  return ok;
+}
+
+// Decodes only NYM, from its offset in the signature
+static int deserialize_signature_tag(octet* in, ECP* NYM)
+{
+  int wire = read_wire_format(in);
+  int size = wire == WIRE_V1 ? ECPSIZE : ECPSIZE_V2;
+  if (in->len + 5 * size + 2 * BIGSIZE > in->max) {
+    return 0;
+  }
+  in->len += 4 * size;
+  return deserialize_ECP_wire(in, NYM, wire);
 }
 
-static int serialize_signature_tag(struct Signature* in, octet* out)
+// Tags are always in the v1 format, so that they do not depend on the
+// format of the signature
+static int serialize_signature_tag(ECP* NYM, octet* out)
 {
   return
-  serialize_ECP(&in->NYM, out);
+  serialize_ECP(NYM, out);
 }
 
 static void join_client(csprng *RNG, char* challenge, int challenge_len, struct JoinMessage *j, struct UserPrivateKey *priv)
     // BIG gsk, ECP* Q, ECP* T, BIG rr) // output
 {
   message("join_client");
-    ECP G;
-    setG1(&G);
-
-    ECP_copy(&j->Q, &G);
     randomModOrder(priv->gsk, RNG);
-    PAIR_G1mul(&j->Q, priv->gsk);
+    combG1mul(&j->Q, priv->gsk);
 
     char h[MODBYTES];
     myhash(challenge, challenge_len, h);
-    makeECPProof(RNG, &G, &j->Q, priv->gsk, h, j->c, j->s);
+    makeECPProof(RNG, &j->Q, priv->gsk, h, j->c, j->s);
 
   message("join_client: done");
 }
 
-static int join_server(csprng *RNG, struct GroupPrivateKey *priv, struct JoinMessage *j, char* challenge, int challenge_len, struct JoinResponse *resp)
+// Join processing, for one or many join messages at once.
+//
+// The join proofs are (c, s) pairs, so the commitment s·G - c·Q of each
+// one has to be recomputed to check its challenge and they cannot be
+// folded into a single multi-scalar check. What is shared is the work
+// around it: the proofs are checked and the credentials issued in passes
+// over all entries, and the points each pass hashes or serializes are
+// normalized together (see normalizeECPs). The multiplications by the
+// generator use its comb table.
+struct JoinEntry {
+    struct JoinMessage join;
+    char h[MODBYTES]; // H(challenge)
+    int ok;
+    struct JoinResponse resp;
+    struct IssuanceTuple tuple;
+    ECP T; // s·G - c·Q for the join proof, then Q·rr for the response proof
+};
+
+static void preissue(csprng *RNG, struct GroupPrivateKey *priv, struct IssuanceTuple *tuple)
 {
-    BIG order;
+    BIG order, r, t;
     BIG_rcopy(order, CURVE_Order);
 
-    ECP G;
-    setG1(&G);
-
-    char h[MODBYTES];
-    myhash(challenge, challenge_len, h);
+    randomModOrder(r, RNG);
+    combG1mul(&tuple->A, r);
+    BIG_modmul(tuple->ry, r, priv->y, order);
+    combG1mul(&tuple->B, tuple->ry);
+    BIG_modmul(t, r, priv->x, order);
+    combG1mul(&tuple->xA, t);
 
-    int ok = verifyECPProof(&G, &j->Q, h, j->c, j->s);
-    if (ok) {
-        ECP *A = &resp->cred.A;
-        ECP *B = &resp->cred.B;
-        ECP *C = &resp->cred.C;
-        ECP *D = &resp->cred.D;
-        ECP *Q = &j->Q;
+    randomModOrder(tuple->rr, RNG);
+    combG1mul(&tuple->GR, tuple->rr);
+}
 
-        BIG r;
-        randomModOrder(r, RNG);
-        ECP_copy(A, &G);
-        PAIR_G1mul(A, r);
+// P is scratch space for 6 * n points. Issuance tuples are taken from
+// the end of pool while there are any left, and generated otherwise.
+static void join_server(csprng *RNG, struct GroupPrivateKey *priv, struct JoinEntry *entries, int n, struct IssuanceTuple *pool, int *pool_count, ECP* P[])
+{
+    BIG order, cn, cc;
+    BIG_rcopy(order, CURVE_Order);
 
-        ECP_copy(B, A);
-        PAIR_G1mul(B, priv->y);
+    ECP G;
+    setG1(&G);
 
-        ECP_copy(D, Q);
-        BIG tmp;
-        BIG_modmul(tmp, r, priv->y, order);
-        PAIR_G1mul(D, tmp);
+    // Check c == H(H(challenge) | Q | G | s·G - c·Q)
+    for (int i = 0; i < n; ++i) {
+        struct JoinEntry* e = &entries[i];
+        BIG_modneg(cn, e->join.c, order);
+        ECP_copy(&e->T, &G);
+        G1mul2(&e->T, e->join.s, &e->join.Q, cn);
+        P[i] = &e->T;
+    }
+    normalizeECPs(P, n);
+    for (int i = 0; i < n; ++i) {
+        struct JoinEntry* e = &entries[i];
+        ECPchallenge(e->h, &e->join.Q, &G, &e->T, cc);
+        e->ok = BIG_comp(e->join.c, cc) == 0;
+    }
 
-        ECP_copy(C, A);
-        ECP_add(C, D);
-        PAIR_G1mul(C, priv->x);
+    // A = G·r, B = A·y, D = Q·r·y and C = (A + D)·x, with a proof of
+    // equality of log_G(B) and log_Q(D)
+    int m = 0;
+    for (int i = 0; i < n; ++i) {
+        struct JoinEntry* e = &entries[i];
+        if (!e->ok) {
+            continue;
+        }
+        struct IssuanceTuple* tuple = &e->tuple;
+        if (*pool_count > 0) {
+            struct IssuanceTuple* last = &pool[--*pool_count];
+            memcpy(tuple, last, sizeof(struct IssuanceTuple));
+            memset(last, 0, sizeof(struct IssuanceTuple));
+        } else {
+            preissue(RNG, priv, tuple);
+        }
 
-        makeECPProofEquals(RNG, &G, Q, B, D, tmp, 0, resp->c, resp->s);
+        struct UserCredentials* cred = &e->resp.cred;
+        ECP_copy(&cred->A, &tuple->A);
+        ECP_copy(&cred->B, &tuple->B);
+        ECP_copy(&cred->D, &e->join.Q);
+        PAIR_G1mul(&cred->D, tuple->ry);
+        ECP_copy(&cred->C, &cred->D);
+        PAIR_G1mul(&cred->C, priv->x);
+        ECP_add(&cred->C, &tuple->xA);
+
+        ECP_copy(&e->T, &e->join.Q);
+        PAIR_G1mul(&e->T, tuple->rr);
+
+        P[m++] = &cred->A;
+        P[m++] = &cred->B;
+        P[m++] = &cred->C;
+        P[m++] = &cred->D;
+        P[m++] = &tuple->GR;
+        P[m++] = &e->T;
+    }
+    normalizeECPs(P, m);
+    for (int i = 0; i < n; ++i) {
+        struct JoinEntry* e = &entries[i];
+        if (!e->ok) {
+            continue;
+        }
+        // Proof that log_G(B) = log_Q(D), checked by verifyECPProofEquals(&G, Q, B, D, 0, c, s)
+        ECPchallengeEquals(0, &e->resp.cred.B, &e->resp.cred.D, &G, &e->join.Q, &e->tuple.GR, &e->T, e->resp.c);
+        BIG_modmul(e->resp.s, e->resp.c, e->tuple.ry, order);
+        BIG_add(e->resp.s, e->resp.s, e->tuple.rr);
+        BIG_mod(e->resp.s, order);
     }
-    return ok;
 }
 
 static int setup(csprng *RNG, struct GroupPrivateKey *priv)
 {
-    ECP2 W;
-    setG2(&W);
-
-    ECP2_copy(&priv->pub.X,&W);
-    ECP2_copy(&priv->pub.Y,&W);
-
     // Choose random x,y less than the group order
     randomModOrder(priv->x, RNG);
     randomModOrder(priv->y, RNG);
 
     // Compute public keys
-    PAIR_G2mul(&priv->pub.X, priv->x);
-    PAIR_G2mul(&priv->pub.Y, priv->y);
+    combG2mul(&priv->pub.X, priv->x);
+    combG2mul(&priv->pub.Y, priv->y);
 
-    makeECP2Proof(RNG, &W, &priv->pub.X, priv->x, priv->pub.cx, priv->pub.sx);
-    makeECP2Proof(RNG, &W, &priv->pub.Y, priv->y, priv->pub.cy, priv->pub.sy);
+    makeECP2Proof(RNG, &priv->pub.X, priv->x, priv->pub.cx, priv->pub.sx);
+    makeECP2Proof(RNG, &priv->pub.Y, priv->y, priv->pub.cy, priv->pub.sy);
 
     return 0;
 }
 
-static int join_finish_client(struct GroupPublicKey *pub, struct UserPrivateKey *priv, struct JoinResponse *resp, csprng *RNG)
+static int join_finish_client(struct GroupPublicKey *pub, struct UserPrivateKey *priv, struct JoinResponse *resp, drbg *RNG)
 {
     ECP G, Q;
     setG1(&G);
-
-    ECP_copy(&Q, &G);
-    PAIR_G1mul(&Q, priv->gsk);
+    combG1mul(&Q, priv->gsk);
 
     if (!verifyECPProofEquals(&G, &Q, &resp->cred.B, &resp->cred.D, 0, resp->c, resp->s)) {
         return 0;
@@ -860,65 +1959,688 @@ static int join_finish_client(struct GroupPublicKey *pub, struct UserPrivateKey
     return 1;
 }
 
-static void sign(csprng *RNG, struct UserPrivateKey *priv, char* msg, int msg_len, char* bsn, int bsn_len, struct Signature *sig)
-{
-    char hh[2 * MODBYTES];
-    char h[MODBYTES];
-
-    ECP_copy(&sig->A, &priv->cred.A);
-    ECP_copy(&sig->B, &priv->cred.B);
-    ECP_copy(&sig->C, &priv->cred.C);
-    ECP_copy(&sig->D, &priv->cred.D);
-
-    // Randomize credentials for signature
-    BIG r;
-    randomModOrder(r, RNG);
-    PAIR_G1mul(&sig->A, r);
-    PAIR_G1mul(&sig->B, r);
-    PAIR_G1mul(&sig->C, r);
-    PAIR_G1mul(&sig->D, r);
+// Basename cache.
+//
+// Verifiers see the same few basenames over and over, and mapping a
+// basename to a point (a try-and-increment loop with a square root per
+// attempt) costs about as much as a scalar multiplication. Mapped points
+// are kept in a process-wide LRU cache keyed by H(bsn), together with the
+// comb table of the point, which is only built when the signer needs it.
+//
+// The cache holds bsnCache.capacity entries (GS_BSN_CACHE_SIZE unless
+// changed with GS_setBasenameCacheCapacity); a capacity of 0 disables it.
+#ifndef GS_BSN_CACHE_SIZE
+#define GS_BSN_CACHE_SIZE 64
+#endif
 
-    // Map basename to point in G1
-    ECP BSN;
-    myhash(bsn, bsn_len, h);
-    mapit(h, &BSN);
-    ECP_copy(&sig->NYM, &BSN);
-    PAIR_G1mul(&sig->NYM, priv->gsk);
+struct BasenameEntry {
+    char h[MODBYTES]; // H(bsn)
+    ECP P; // mapit(H(bsn))
+    int hasTable;
+    ECP table[COMB_SIZE]; // comb table of P, valid if hasTable
+    int prev, next; // LRU list, most recently used first
+};
 
-    // Compute H(H(msg) || H(bsn)) to be used in proof of equality
-    myhash(msg, msg_len, &hh[0]);
-    myhash(bsn, bsn_len, &hh[MODBYTES]);
-    myhash(hh, sizeof(hh), h);
-    makeECPProofEquals(RNG, &sig->B, &BSN, &sig->D, &sig->NYM, priv->gsk, h, sig->c, sig->s);
-}
+static struct {
+    int capacity;
+    int size;
+    struct BasenameEntry* entries; // capacity entries, allocated on first use
+    int* slots; // open addressing index of 2 * capacity slots, -1 if empty
+    int head, tail;
+    unsigned long long hits, misses;
+} bsnCache = {GS_BSN_CACHE_SIZE, 0, NULL, NULL, -1, -1, 0, 0};
 
-static int verify(char *msg, int msg_len, char *bsn, int bsn_len, struct Signature *sig, struct GroupPublicKey *pub, csprng *RNG)
+static int bsnCacheInit()
+{
+    if (bsnCache.entries) {
+        return 1;
+    }
+    if (bsnCache.capacity <= 0) {
+        return 0;
+    }
+    bsnCache.entries = (struct BasenameEntry*)malloc(bsnCache.capacity * sizeof(struct BasenameEntry));
+    bsnCache.slots = (int*)malloc(2 * bsnCache.capacity * sizeof(int));
+    if (!bsnCache.entries || !bsnCache.slots) {
+        free(bsnCache.entries);
+        free(bsnCache.slots);
+        bsnCache.entries = NULL;
+        bsnCache.slots = NULL;
+        bsnCache.capacity = 0;
+        return 0;
+    }
+    for (int i = 0; i < 2 * bsnCache.capacity; ++i) {
+        bsnCache.slots[i] = -1;
+    }
+    bsnCache.size = 0;
+    bsnCache.head = bsnCache.tail = -1;
+    return 1;
+}
+
+static int bsnHomeSlot(char* h)
+{
+    // h is a hash output, so any of its bytes will do
+    unsigned int x = ((unsigned char)h[0] << 24) | ((unsigned char)h[1] << 16)
+                   | ((unsigned char)h[2] << 8) | (unsigned char)h[3];
+    return x % (2 * bsnCache.capacity);
+}
+
+// Slot that holds h, or the empty slot where it would go
+static int bsnFindSlot(char* h)
+{
+    int nslots = 2 * bsnCache.capacity;
+    int s = bsnHomeSlot(h);
+    while (bsnCache.slots[s] != -1 && memcmp(bsnCache.entries[bsnCache.slots[s]].h, h, MODBYTES)) {
+        s = (s + 1) % nslots;
+    }
+    return s;
+}
+
+// Linear probing deletion: move later entries of the probe sequence back
+// so that lookups never stop at the hole
+static void bsnRemoveSlot(int s)
+{
+    int nslots = 2 * bsnCache.capacity;
+    int hole = s;
+    bsnCache.slots[hole] = -1;
+    for (s = (s + 1) % nslots; bsnCache.slots[s] != -1; s = (s + 1) % nslots) {
+        int home = bsnHomeSlot(bsnCache.entries[bsnCache.slots[s]].h);
+        // Move unless home lies cyclically in (hole, s]
+        int stays = hole <= s ? (hole < home && home <= s) : (hole < home || home <= s);
+        if (!stays) {
+            bsnCache.slots[hole] = bsnCache.slots[s];
+            bsnCache.slots[s] = -1;
+            hole = s;
+        }
+    }
+}
+
+static void bsnUnlink(int i)
+{
+    struct BasenameEntry* e = &bsnCache.entries[i];
+    if (e->prev != -1) {
+        bsnCache.entries[e->prev].next = e->next;
+    } else {
+        bsnCache.head = e->next;
+    }
+    if (e->next != -1) {
+        bsnCache.entries[e->next].prev = e->prev;
+    } else {
+        bsnCache.tail = e->prev;
+    }
+}
+
+static void bsnPushFront(int i)
+{
+    struct BasenameEntry* e = &bsnCache.entries[i];
+    e->prev = -1;
+    e->next = bsnCache.head;
+    if (bsnCache.head != -1) {
+        bsnCache.entries[bsnCache.head].prev = i;
+    }
+    bsnCache.head = i;
+    if (bsnCache.tail == -1) {
+        bsnCache.tail = i;
+    }
+}
+
+// Copies the cached point of out->h (and its comb table, if withTable and
+// cached) to out. Returns 0 if h is not cached, 1 if only the point is,
+// and 2 if the comb table is too.
+static int bsnCacheGet(struct BasenameEntry* out, int withTable)
+{
+    if (!bsnCacheInit()) {
+        bsnCache.misses++;
+        return 0;
+    }
+    int i = bsnCache.slots[bsnFindSlot(out->h)];
+    if (i == -1) {
+        bsnCache.misses++;
+        return 0;
+    }
+    bsnCache.hits++;
+    bsnUnlink(i);
+    bsnPushFront(i);
+    struct BasenameEntry* e = &bsnCache.entries[i];
+    ECP_copy(&out->P, &e->P);
+    if (withTable && e->hasTable) {
+        memcpy(out->table, e->table, sizeof(e->table));
+        return 2;
+    }
+    return 1;
+}
+
+// Stores the point (and comb table, if in->hasTable) of in->h
+static void bsnCachePut(struct BasenameEntry* in)
+{
+    if (!bsnCacheInit()) {
+        return;
+    }
+    int s = bsnFindSlot(in->h);
+    int i = bsnCache.slots[s];
+    if (i == -1) {
+        if (bsnCache.size < bsnCache.capacity) {
+            i = bsnCache.size++;
+        } else {
+            // Evict the least recently used entry
+            i = bsnCache.tail;
+            bsnUnlink(i);
+            bsnRemoveSlot(bsnFindSlot(bsnCache.entries[i].h));
+            s = bsnFindSlot(in->h);
+        }
+        bsnCache.slots[s] = i;
+        bsnCache.entries[i].hasTable = 0;
+    } else {
+        bsnUnlink(i);
+    }
+    bsnPushFront(i);
+    struct BasenameEntry* e = &bsnCache.entries[i];
+    memcpy(e->h, in->h, MODBYTES);
+    ECP_copy(&e->P, &in->P);
+    if (in->hasTable && !e->hasTable) {
+        memcpy(e->table, in->table, sizeof(e->table));
+        e->hasTable = 1;
+    }
+}
+
+// Sets out to the entry of bsn, with the comb table if withTable. The
+// cache is only locked while copying, so that other threads can use it
+// while points and tables are computed.
+static void lookupBasename(char* bsn, int bsn_len, struct BasenameEntry* out, int withTable)
+{
+    STAT_BEGIN(t);
+    myhash(bsn, bsn_len, out->h);
+
+    LOCK_CACHES();
+    int found = bsnCacheGet(out, withTable);
+    UNLOCK_CACHES();
+
+    if (found == 0) {
+        mapit(out->h, &out->P);
+    }
+    out->hasTable = withTable;
+    if (withTable && found < 2) {
+        combPrecompute(out->table, &out->P);
+    }
+    if (found < 1 + withTable) {
+        LOCK_CACHES();
+        bsnCachePut(out);
+        UNLOCK_CACHES();
+    }
+    STAT_END(GS_STAT_BASENAME, t);
+}
+
+// Same as lookupBasename without the table, but without the cache either,
+// so that it takes no lock (see GS_verify_r)
+static void mapBasename(char* bsn, int bsn_len, struct BasenameEntry* out)
+{
+    STAT_BEGIN(t);
+    myhash(bsn, bsn_len, out->h);
+    mapit(out->h, &out->P);
+    out->hasTable = 0;
+    STAT_END(GS_STAT_BASENAME, t);
+}
+
+static void precomputeUserCredentials(struct UserCredentials *cred, struct UserCredentialTables *tables)
+{
+    combPrecompute(tables->cred[0], &cred->A);
+    combPrecompute(tables->cred[1], &cred->B);
+    combPrecompute(tables->cred[2], &cred->C);
+    combPrecompute(tables->cred[3], &cred->D);
+}
+
+static void presign(drbg *RNG, struct UserPrivateKey *priv, struct UserCredentialTables *tables, char* bsn, int bsn_len, int wire, struct Presignature *pre)
+{
+    struct Signature sig;
+    BIG order;
+    BIG_rcopy(order, CURVE_Order);
+
+    // Randomize credentials for signature
+    BIG r;
+    ECP* R[4] = {&sig.A, &sig.B, &sig.C, &sig.D};
+    drbgScalars(RNG, &r, 1, 0);
+    combMulN(R, tables->cred, 4, r);
+
+    // Map basename to point in G1
+    struct BasenameEntry bsnEntry;
+    struct BasenameEntry* BSN = &bsnEntry;
+    lookupBasename(bsn, bsn_len, BSN, 1);
+    ECP* pNYM = &sig.NYM;
+    combMulN(&pNYM, &BSN->table, 1, priv->gsk);
+    memcpy(pre->bsn, BSN->h, MODBYTES);
+
+    // Commitments of the proof that log_B(D) = log_BSN(NYM), as checked by verifyECPProofEquals,
+    // with BR = (r·rr)·cred.B and BSNR = rr·BSN taken from comb tables
+    BIG rrr;
+    ECP BR, BSNR;
+    ECP* pBR = &BR;
+    ECP* pBSNR = &BSNR;
+    drbgScalars(RNG, &pre->rr, 1, 0);
+    BIG_modmul(rrr, r, pre->rr, order);
+    combMulN(&pBR, &tables->cred[1], 1, rrr);
+    combMulN(&pBSNR, &BSN->table, 1, pre->rr);
+
+    // One inversion for all the points serialized below
+    ECP* P[8] = {&sig.A, &sig.B, &sig.C, &sig.D, &sig.NYM, &BSN->P, &BR, &BSNR};
+    normalizeECPs(P, 8);
+
+    octet o = {0, sizeof(pre->sig), pre->sig};
+    write_wire_format(&o, wire);
+    serialize_ECP_wire(&sig.A, &o, wire);
+    serialize_ECP_wire(&sig.B, &o, wire);
+    serialize_ECP_wire(&sig.C, &o, wire);
+    serialize_ECP_wire(&sig.D, &o, wire);
+    serialize_ECP_wire(&sig.NYM, &o, wire);
+    pre->sig_len = o.len;
+
+    octet p = {0, sizeof(pre->proof), pre->proof};
+    serialize_ECP(&sig.D, &p);
+    serialize_ECP(&sig.NYM, &p);
+    serialize_ECP(&sig.B, &p);
+    serialize_ECP(&BSN->P, &p);
+    serialize_ECP(&BR, &p);
+    serialize_ECP(&BSNR, &p);
+}
+
+// Completes a presignature for msg, writing the serialized signature to out.
+// The presignature must not be used again.
+static int finishPresignature(struct Presignature *pre, BIG gsk, char* msg, int msg_len, octet* out)
+{
+    char hh[2 * MODBYTES];
+    char h[MODBYTES];
+    char tmp[MODBYTES + sizeof(pre->proof)];
+    BIG c, s, order;
+    BIG_rcopy(order, CURVE_Order);
+
+    // Compute H(H(msg) || H(bsn)) to be used in proof of equality
+    myhash(msg, msg_len, &hh[0]);
+    memcpy(&hh[MODBYTES], pre->bsn, MODBYTES);
+    myhash(hh, sizeof(hh), h);
+
+    // Same challenge as ECPchallengeEquals
+    memcpy(tmp, h, MODBYTES);
+    memcpy(&tmp[MODBYTES], pre->proof, sizeof(pre->proof));
+    myhash(tmp, sizeof(tmp), h);
+    BIG_fromBytes(c, h);
+    BIG_mod(c, order);
+
+    BIG_modmul(s, c, gsk, order);
+    BIG_add(s, s, pre->rr);
+    BIG_mod(s, order);
+
+    int len = out->len;
+    out->len += pre->sig_len;
+    if (out->len > out->max) {
+        return 0;
+    }
+    memcpy(&out->val[len], pre->sig, pre->sig_len);
+    return serialize_BIG(&c, out) && serialize_BIG(&s, out);
+}
+
+// Checks the proof of equality of the signature (everything but the pairings)
+// (BSN is set to the basename, for isRevoked). The basename is looked up in
+// the cache if cached, or else mapped again.
+static int verifyProofEquals(char *msg, int msg_len, char *bsn, int bsn_len, struct Signature *sig, struct BasenameEntry* BSN, int cached)
 {
     char hh[2 * MODBYTES];
     char h[MODBYTES];
 
     // Map basename to point in G1
-    ECP BSN;
-    myhash(bsn, bsn_len, h);
-    mapit(h, &BSN);
+    if (cached) {
+        lookupBasename(bsn, bsn_len, BSN, 0);
+    } else {
+        mapBasename(bsn, bsn_len, BSN);
+    }
 
     // Compute H(H(msg) || H(bsn)) to be used in proof of equality
     myhash(msg, msg_len, &hh[0]);
-    myhash(bsn, bsn_len, &hh[MODBYTES]);
+    memcpy(&hh[MODBYTES], BSN->h, MODBYTES);
     myhash(hh, sizeof(hh), h);
 
-    return verifyECPProofEquals(&sig->B, &BSN, &sig->D, &sig->NYM, h, sig->c, sig->s)
-     && !ECP_isinf(&sig->A) && !ECP_isinf(&sig->B)
-     && verifyAuxFast(&sig->A, &sig->B, &sig->C, &sig->D, &pub->X, &pub->Y, RNG);
+    return verifyECPProofEquals(&sig->B, &BSN->P, &sig->D, &sig->NYM, h, sig->c, sig->s)
+     && !ECP_isinf(&sig->B);
+}
+
+// Verifier-local revocation (see GS_createRevocationList). The signatures of
+// a revoked user private key gsk_i have NYM = gsk_i·BSN, and the proof of
+// equality binds NYM to the key that signed. So for each basename, the
+// tags of all the revoked keys are computed once and their hashes (as in
+// the tag store, with serialize_signature_tag) kept in an open addressing
+// table; checking a signature is then a lookup of the hash of its NYM.
+//
+// Each list keeps the tables of its last GS_REVOCATION_CACHE_SIZE
+// basenames, which are only accessed with the cache lock held; the keys
+// themselves never change. Without a list, verification does not take the
+// lock at all. A missing table is built outside the lock (threads that
+// miss the same basename at once may each build it, but only one of them
+// is kept).
+#ifndef GS_REVOCATION_CACHE_SIZE
+#define GS_REVOCATION_CACHE_SIZE 16
+#endif
+
+struct RevocationTable {
+    char h[MODBYTES]; // H(bsn)
+    int slots; // a power of 2, 0 if the table is unused
+    char* keys; // slots hashes of revoked tags, all zero bytes if empty
+    unsigned long long lastUse;
+};
+
+struct RevocationList {
+    int count;
+    struct RevocationTable tables[GS_REVOCATION_CACHE_SIZE];
+    unsigned long long clock;
+    BIG gsks[];
+};
+
+static void revokedTagKey(ECP* NYM, char* key)
+{
+    char buf[ECPSIZE];
+    octet o = {0, sizeof(buf), buf};
+    serialize_signature_tag(NYM, &o);
+    myhash(buf, o.len, key);
+}
+
+static int revokedFindSlot(struct RevocationTable* table, char* key)
+{
+    static const char empty[MODBYTES];
+    // key is a hash output, so any of its bytes will do
+    unsigned int x = ((unsigned char)key[0] << 24) | ((unsigned char)key[1] << 16)
+                   | ((unsigned char)key[2] << 8) | (unsigned char)key[3];
+    int s = x & (table->slots - 1);
+    while (memcmp(&table->keys[s * MODBYTES], empty, MODBYTES)
+           && memcmp(&table->keys[s * MODBYTES], key, MODBYTES)) {
+        s = (s + 1) & (table->slots - 1);
+    }
+    return s;
+}
+
+// Fills table with the tags of the keys of list for BSN, without the
+// cache lock. Returns 0 if out of memory.
+#define REVOCATION_CHUNK 64
+static int buildRevocationTable(struct RevocationTable* table, struct BasenameEntry* BSN, struct RevocationList* list)
+{
+    int slots = 1;
+    while (slots < 2 * list->count) {
+        slots <<= 1;
+    }
+    table->keys = (char*)calloc(slots, MODBYTES);
+    if (!table->keys) {
+        return 0;
+    }
+    table->slots = slots;
+    memcpy(table->h, BSN->h, MODBYTES);
+
+    if (!BSN->hasTable) {
+        combPrecompute(BSN->table, &BSN->P);
+        BSN->hasTable = 1;
+    }
+    ECP tags[REVOCATION_CHUNK];
+    ECP* T[REVOCATION_CHUNK];
+    char key[MODBYTES];
+    for (int i = 0; i < list->count; i += REVOCATION_CHUNK) {
+        int n = list->count - i < REVOCATION_CHUNK ? list->count - i : REVOCATION_CHUNK;
+        for (int j = 0; j < n; ++j) {
+            T[j] = &tags[j];
+            combMulN(&T[j], &BSN->table, 1, list->gsks[i + j]);
+        }
+        normalizeECPs(T, n);
+        for (int j = 0; j < n; ++j) {
+            revokedTagKey(&tags[j], key);
+            memcpy(&table->keys[revokedFindSlot(table, key) * MODBYTES], key, MODBYTES);
+        }
+    }
+    return 1;
+}
+
+// The cached table of list for BSN, if any, with the cache lock held
+static struct RevocationTable* findRevocationTable(struct RevocationList* list, struct BasenameEntry* BSN)
+{
+    for (int i = 0; i < GS_REVOCATION_CACHE_SIZE; ++i) {
+        struct RevocationTable* t = &list->tables[i];
+        if (t->slots && !memcmp(t->h, BSN->h, MODBYTES)) {
+            return t;
+        }
+    }
+    return NULL;
+}
+
+static int revokedLookup(struct RevocationTable* table, char* key)
+{
+    int s = revokedFindSlot(table, key);
+    return !memcmp(&table->keys[s * MODBYTES], key, MODBYTES);
+}
+
+// Whether NYM is the tag of a key of list (NULL if none) for the basename BSN
+static int isRevoked(struct RevocationList* list, struct BasenameEntry* BSN, ECP* NYM)
+{
+    if (!list) {
+        return 0;
+    }
+
+    char key[MODBYTES];
+    int revoked = 0;
+    revokedTagKey(NYM, key);
+    LOCK_CACHES();
+    struct RevocationTable* table = findRevocationTable(list, BSN);
+    if (table) {
+        table->lastUse = ++list->clock;
+        revoked = revokedLookup(table, key);
+        UNLOCK_CACHES();
+        return revoked;
+    }
+    UNLOCK_CACHES();
+
+    struct RevocationTable fresh = {{0}, 0, NULL, 0};
+    if (buildRevocationTable(&fresh, BSN, list)) {
+        revoked = revokedLookup(&fresh, key);
+    } else {
+        // Out of memory: compare with each revoked tag
+        ECP T;
+        for (int i = 0; i < list->count && !revoked; ++i) {
+            ECP_copy(&T, &BSN->P);
+            PAIR_G1mul(&T, list->gsks[i]);
+            revoked = ECP_equals(&T, NYM);
+        }
+    }
+
+    LOCK_CACHES();
+    if (fresh.keys && !findRevocationTable(list, BSN)) {
+        // An unused table, or else the least recently used one
+        struct RevocationTable* oldest = &list->tables[0];
+        for (int i = 0; i < GS_REVOCATION_CACHE_SIZE && oldest->slots; ++i) {
+            struct RevocationTable* t = &list->tables[i];
+            if (!t->slots || t->lastUse < oldest->lastUse) {
+                oldest = t;
+            }
+        }
+        free(oldest->keys);
+        *oldest = fresh;
+        oldest->lastUse = ++list->clock;
+        fresh.keys = NULL;
+    }
+    UNLOCK_CACHES();
+    free(fresh.keys);
+    return revoked;
+}
+
+// Verification in stages of increasing cost, stopping at the first one
+// that rejects the signature: decoding what the proof of equality needs,
+// the proof, decoding A and C, and the pairings (which also reject A = 1).
+// Returns one of enum RejectReasons. cached selects the basename cache,
+// as in verifyProofEquals.
+static int verify(char *msg, int msg_len, char *bsn, int bsn_len, octet *in, struct PreparedGroupPublicKey *prep, struct RevocationList *revoked, drbg *RNG, int cached)
+{
+    struct Signature sig;
+    struct BasenameEntry BSN;
+    int wire, points;
+    if (!deserialize_signature_proof(in, &sig, &wire, &points)) {
+        return GS_REJECT_ENCODING;
+    }
+    if (!verifyProofEquals(msg, msg_len, bsn, bsn_len, &sig, &BSN, cached)) {
+        return GS_REJECT_PROOF;
+    }
+    if (isRevoked(revoked, &BSN, &sig.NYM)) {
+        return GS_REJECT_REVOKED;
+    }
+    if (!deserialize_signature_credentials(in, &sig, wire, points)) {
+        return GS_REJECT_ENCODING;
+    }
+    if (!verifyAuxPrepared(&sig.A, &sig.B, &sig.C, &sig.D, prep, RNG)) {
+        return GS_REJECT_PAIRING;
+    }
+    return GS_REJECT_NONE;
+}
+
+// Batch verification of signatures under the same group public key.
+//
+// All pairing checks share the same G2 arguments (Y, G2 and X), so the
+// checks of n signatures can be combined with random exponents e1_i, e2_i
+// into a single product of three pairings, with one final exponentiation:
+//
+// e(Σ e1_i·A_i, Y)·
+// e(Σ (-e1_i·B_i) + (-e2_i·C_i), G2)·
+// e(Σ e2_i·(A_i + D_i), X) == 1?
+//
+// Following the small exponents test (Bellare, Garay and Rabin), the
+// exponents only need BATCH_EXPONENT_BITS bits for an invalid signature
+// to pass with probability at most 2^-BATCH_EXPONENT_BITS.
+//
+// If the combined check fails, the batch is bisected to find the invalid
+// signatures; a single signature falls back to verifyAuxPrepared.
+#define BATCH_EXPONENT_BITS 128
+
+struct BatchEntry {
+    struct Signature sig;
+    ECP AD; // A + D
+    int index; // position in the input arrays
+};
+
+static void randomBatchExponents(BIG x[], int n, drbg *RNG)
+{
+    drbgScalars(RNG, x, n, BATCH_EXPONENT_BITS);
+    for (int i = 0; i < n; ++i) {
+        if (BIG_iszilch(x[i])) {
+            BIG_inc(x[i], 1);
+        }
+    }
+}
+
+static int verifyBatchAux(struct BatchEntry* entries, int n, struct PreparedGroupPublicKey *prep, drbg *RNG)
+{
+    ECP AA, BB, CC, T;
+    FP12 w, y;
+
+    ECP_inf(&AA);
+    ECP_inf(&BB);
+    ECP_inf(&CC);
+
+    // VT_MAX_TERMS / 2 entries at a time, so that BB takes VT_MAX_TERMS terms
+    for (int i = 0; i < n; i += VT_MAX_TERMS / 2) {
+        ECP *PA[VT_MAX_TERMS], *PB[VT_MAX_TERMS], *PC[VT_MAX_TERMS];
+        BIG EA[VT_MAX_TERMS], EB[VT_MAX_TERMS], EC[VT_MAX_TERMS];
+        int k = 0;
+        int m = n - i < VT_MAX_TERMS / 2 ? n - i : VT_MAX_TERMS / 2;
+        randomBatchExponents(EA, m, RNG); // e1
+        randomBatchExponents(EC, m, RNG); // e2
+        for (int j = i; j < i + m; ++j, ++k) {
+            PA[k] = &entries[j].sig.A;
+            PC[k] = &entries[j].AD;
+            PB[2 * k] = &entries[j].sig.B;
+            BIG_copy(EB[2 * k], EA[k]);
+            PB[2 * k + 1] = &entries[j].sig.C;
+            BIG_copy(EB[2 * k + 1], EC[k]);
+        }
+
+        // AA += e1·A
+        vtMulN(&T, PA, EA, k);
+        ECP_add(&AA, &T);
+
+        // BB += e1·B + e2·C (negated after the loop)
+        vtMulN(&T, PB, EB, 2 * k);
+        ECP_add(&BB, &T);
+
+        // CC += e2·(A + D)
+        vtMulN(&T, PC, EC, k);
+        ECP_add(&CC, &T);
+    }
+    ECP_neg(&BB);
+
+    PAIR_prepared_triple_ate(&w, prep, &AA, &BB, &CC);
+
+    FP12_one(&y);
+    return FP12_equals(&w, &y);
+}
+
+// Marks entries that fail the pairing check in results (indexed by entry->index)
+static void verifyBatchBisect(struct BatchEntry* entries, int n, struct PreparedGroupPublicKey *prep, drbg *RNG, int* results)
+{
+    if (n == 0) {
+        return;
+    }
+
+    if (n == 1) {
+        struct Signature* sig = &entries[0].sig;
+        if (!verifyAuxPrepared(&sig->A, &sig->B, &sig->C, &sig->D, prep, RNG)) {
+            results[entries[0].index] = GS_RETURN_FAILURE;
+        }
+        return;
+    }
+
+    if (verifyBatchAux(entries, n, prep, RNG)) {
+        return;
+    }
+
+    int half = n / 2;
+    verifyBatchBisect(entries, half, prep, RNG, results);
+    verifyBatchBisect(entries + half, n - half, prep, RNG, results);
 }
 
 // External interface:
 
 
 // Start - Operations that modify internal state
+// Presignature pool. Each presignature is used at most once: it is wiped
+// as soon as its signature has been produced, since two signatures with
+// the same nonce would reveal gsk.
+static void removePresignature(GS_State* state, int i)
+{
+  int last = --state->_presignCount;
+  if (i != last) {
+    memcpy(&state->_presign[i], &state->_presign[last], sizeof(struct Presignature));
+  }
+  memset(&state->_presign[last], 0, sizeof(struct Presignature));
+}
+
+static void clearPresignatures(GS_State* state)
+{
+  memset(state->_presign, 0, sizeof(state->_presign));
+  state->_presignCount = 0;
+}
+
+static int findPresignature(GS_State* state, char* bsn, int bsn_len)
+{
+  char h[MODBYTES];
+  myhash(bsn, bsn_len, h);
+  for (int i = 0; i < state->_presignCount; ++i) {
+    if (!memcmp(state->_presign[i].bsn, h, MODBYTES)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static void clearIssuanceTuples(GS_State* state)
+{
+  memset(state->_preissue, 0, sizeof(state->_preissue));
+  state->_preissueCount = 0;
+}
+
 void GS_initState(void* rawstate) {
   GS_State* state = (GS_State*)rawstate;
   state->state = 0;
+  state->_presignCount = 0;
+  state->_preissueCount = 0;
+  state->_wireFormat = WIRE_V1;
+  state->_revoked = NULL;
   log_state(state->state);
 }
 
@@ -928,6 +2650,7 @@ int GS_seed(void* rawstate, char* seed, int seed_length) {
     return GS_SEED_TOO_SMALL;
   }
   RAND_seed(&state->_rng, seed_length, seed);
+  drbgSeed(&state->_drbg, seed_length, seed);
   state->state |= 1 << GS_SEEDED;
   log_state(state->state);
   return GS_RETURN_SUCCESS;
@@ -939,7 +2662,9 @@ int GS_setupGroup(void* rawstate) {
     return GS_NOT_SEEDED;
   }
   state->state &= (1 << GS_SEEDED);
+  clearIssuanceTuples(state);
   setup(&state->_rng, &state->_priv);
+  prepareGroupPublicKey(&state->_priv.pub, &state->_prepared);
   state->state |= 1 << GS_GROUP_PRIVKEY;
   state->state |= 1 << GS_GROUP_PUBKEY;
   log_state(state->state);
@@ -949,10 +2674,12 @@ int GS_setupGroup(void* rawstate) {
 int GS_loadGroupPrivKey(void* rawstate, char* data, int len) {
   GS_State* state = (GS_State*)rawstate;
   state->state &= (1 << GS_SEEDED);
+  clearIssuanceTuples(state);
   octet o = {0, len, data};
   if (!deserialize_group_private_key(&o, &state->_priv)) {
     return GS_INVALID_GROUP_PRIVATE_KEY;
   }
+  prepareGroupPublicKey(&state->_priv.pub, &state->_prepared);
   state->state |= 1 << GS_GROUP_PRIVKEY;
   state->state |= 1 << GS_GROUP_PUBKEY;
   log_state(state->state);
@@ -962,10 +2689,59 @@ int GS_loadGroupPrivKey(void* rawstate, char* data, int len) {
 int GS_loadGroupPubKey(void* rawstate, char* data, int len) {
   GS_State* state = (GS_State*)rawstate;
   state->state &= (1 << GS_SEEDED);
+  clearIssuanceTuples(state);
   octet o = {0, len, data};
   if (!deserialize_group_public_key(&o, &state->_priv.pub)) {
     return GS_INVALID_GROUP_PUBLIC_KEY;
   }
+  prepareGroupPublicKey(&state->_priv.pub, &state->_prepared);
+  state->state |= 1 << GS_GROUP_PUBKEY;
+  log_state(state->state);
+  return GS_RETURN_SUCCESS;
+}
+
+// Raw copy of a validated group public key and its prepared form, for
+// GS_exportPreparedGroupPubKey and GS_loadPreparedGroupPubKey. The header
+// rejects copies from builds with another curve or layout, and corrupted
+// ones; it does not make untrusted copies safe to load.
+#define SHARED_KEY_MAGIC 0x47535052 // "GSPR"
+
+struct SharedGroupPublicKey {
+    unsigned int magic;
+    unsigned int curve; // CURVE_ID
+    unsigned int size; // sizeof(struct SharedGroupPublicKey)
+    unsigned int checksum; // of pub and prep, see sharedKeyChecksum
+    struct GroupPublicKey pub;
+    struct PreparedGroupPublicKey prep;
+};
+
+// 32-bit FNV-1a
+static unsigned int sharedKeyChecksum(struct SharedGroupPublicKey* key)
+{
+    const unsigned char* p = (const unsigned char*)&key->pub;
+    const unsigned char* end = (const unsigned char*)(key + 1);
+    unsigned int h = 2166136261u;
+    while (p < end) {
+        h = (h ^ *p++) * 16777619u;
+    }
+    return h;
+}
+
+int GS_loadPreparedGroupPubKey(void* rawstate, char* data, int len) {
+  GS_State* state = (GS_State*)rawstate;
+  state->state &= (1 << GS_SEEDED);
+  clearIssuanceTuples(state);
+  if (len != sizeof(struct SharedGroupPublicKey)) {
+    return GS_INVALID_GROUP_PUBLIC_KEY;
+  }
+  struct SharedGroupPublicKey* in = (struct SharedGroupPublicKey*)data;
+  if (in->magic != SHARED_KEY_MAGIC || in->curve != CURVE_ID
+      || in->size != sizeof(struct SharedGroupPublicKey)
+      || in->checksum != sharedKeyChecksum(in)) {
+    return GS_INVALID_GROUP_PUBLIC_KEY;
+  }
+  memcpy(&state->_priv.pub, &in->pub, sizeof(in->pub));
+  memcpy(&state->_prepared, &in->prep, sizeof(in->prep));
   state->state |= 1 << GS_GROUP_PUBKEY;
   log_state(state->state);
   return GS_RETURN_SUCCESS;
@@ -990,7 +2766,7 @@ int GS_startJoin(
   struct UserPrivateKey userPriv;
   join_client(&state->_rng, challenge, challenge_len, &j, &userPriv);
   octet o = {0, *len, joinmsg};
-  if (!serialize_join_message(&j, &o)) {
+  if (!serialize_join_message(&j, &o, state->_wireFormat)) {
     message("GS_startJoin: GS_OUTPUT_BUFFER_TOO_SMALL");
     return GS_OUTPUT_BUFFER_TOO_SMALL;
   }
@@ -1027,17 +2803,19 @@ int GS_finishJoin(
   }
 
   // Temporal random number generator for fast verification, seeded with user secret.
-  csprng rng;
-  RAND_seed(&rng, len_gsk, gsk);
+  drbg rng;
+  drbgSeed(&rng, len_gsk, gsk);
 
+  // Credentials are returned in the format of the join response
   octet o = {0, len, joinresponse};
+  int wire = peek_wire_format(&o);
   struct JoinResponse resp;
   if (!deserialize_join_response(&o, &resp) || !join_finish_client(&pub, &priv, &resp, &rng)) {
     return GS_INVALID_JOIN_RESPONSE;
   }
 
   octet oc = {0, *len_credentials, credentials};
-  if (!serialize_user_private_key(&priv, &oc)) {
+  if (!serialize_user_private_key(&priv, &oc, wire)) {
     return GS_OUTPUT_BUFFER_TOO_SMALL;
   }
   *len_credentials = oc.len;
@@ -1054,11 +2832,26 @@ int GS_loadUserCredentials(void* rawstate, char* in, int in_len) {
   if (!deserialize_user_private_key(&o, &state->_userPriv)) {
     return GS_INVALID_USER_CREDENTIALS;
   }
+  precomputeUserCredentials(&state->_userPriv.cred, &state->_userTables);
+  clearPresignatures(state);
 
   state->state |= (1 << GS_USERCREDS);
   log_state(state->state);
   return GS_RETURN_SUCCESS;
 }
+
+int GS_setWireFormat(void* rawstate, int version) {
+  GS_State* state = (GS_State*)rawstate;
+  if (version != WIRE_V1 && version != WIRE_V2) {
+    return GS_INVALID_WIRE_FORMAT;
+  }
+  if (version != state->_wireFormat) {
+    // Presignatures are serialized in the previous format
+    clearPresignatures(state);
+    state->_wireFormat = version;
+  }
+  return GS_RETURN_SUCCESS;
+}
 // End - Operations that modify internal state
 
 int GS_exportGroupPrivKey(void* rawstate, char* out, int* out_len) {
@@ -1067,7 +2860,7 @@ int GS_exportGroupPrivKey(void* rawstate, char* out, int* out_len) {
     return GS_NOT_SET_GROUP_PRIVATE_KEY;
   }
   octet o = {0, *out_len, out};
-  if (!serialize_group_private_key(&state->_priv, &o)) {
+  if (!serialize_group_private_key(&state->_priv, &o, state->_wireFormat)) {
     return GS_OUTPUT_BUFFER_TOO_SMALL;
   }
   *out_len = o.len;
@@ -1080,20 +2873,39 @@ int GS_exportGroupPubKey(void* rawstate, char* out, int* out_len) {
     return GS_NOT_SET_GROUP_PUBLIC_KEY;
   }
   octet o = {0, *out_len, out};
-  if (!serialize_group_public_key(&state->_priv.pub, &o)) {
+  if (!serialize_group_public_key(&state->_priv.pub, &o, state->_wireFormat)) {
     return GS_OUTPUT_BUFFER_TOO_SMALL;
   }
   *out_len = o.len;
   return GS_RETURN_SUCCESS;
 }
 
+int GS_exportPreparedGroupPubKey(void* rawstate, char* out, int* out_len) {
+  GS_State* state = (GS_State*)rawstate;
+  if (!((1 << GS_GROUP_PUBKEY)&(state->state))) {
+    return GS_NOT_SET_GROUP_PUBLIC_KEY;
+  }
+  if (*out_len < (int)sizeof(struct SharedGroupPublicKey)) {
+    return GS_OUTPUT_BUFFER_TOO_SMALL;
+  }
+  struct SharedGroupPublicKey* o = (struct SharedGroupPublicKey*)out;
+  memcpy(&o->pub, &state->_priv.pub, sizeof(o->pub));
+  memcpy(&o->prep, &state->_prepared, sizeof(o->prep));
+  o->magic = SHARED_KEY_MAGIC;
+  o->curve = CURVE_ID;
+  o->size = sizeof(struct SharedGroupPublicKey);
+  o->checksum = sharedKeyChecksum(o);
+  *out_len = sizeof(struct SharedGroupPublicKey);
+  return GS_RETURN_SUCCESS;
+}
+
 int GS_exportUserCredentials(void* rawstate, char* out, int* out_len) {
   GS_State* state = (GS_State*)rawstate;
   if (!((1 << GS_USERCREDS)&state->state)) {
     return GS_NOT_SET_USER_CREDENTIALS;
   }
   octet o = {0, *out_len, out};
-  if (!serialize_user_private_key(&state->_userPriv, &o)) {
+  if (!serialize_user_private_key(&state->_userPriv, &o, state->_wireFormat)) {
     return GS_OUTPUT_BUFFER_TOO_SMALL;
   }
   *out_len = o.len;
@@ -1101,6 +2913,12 @@ int GS_exportUserCredentials(void* rawstate, char* out, int* out_len) {
 }
 
 int GS_processJoin(void* rawstate, char* joinmsg, int joinmsg_len, char* challenge, int challenge_len, char* out, int* out_len) {
+  int result;
+  int ret = GS_processJoinBatch(rawstate, 1, &joinmsg, &joinmsg_len, &challenge, &challenge_len, &out, out_len, &result);
+  return ret == GS_RETURN_FAILURE ? result : ret;
+}
+
+int GS_preissue(void* rawstate, int count) {
   GS_State* state = (GS_State*)rawstate;
   if (!((1 << GS_SEEDED)&state->state)) {
     message("GS_SEEDED not set");
@@ -1110,25 +2928,92 @@ int GS_processJoin(void* rawstate, char* joinmsg, int joinmsg_len, char* challen
     message("GS_GROUP_PRIVKEY not set");
     return GS_NOT_SET_GROUP_PRIVATE_KEY;
   }
+  if (count < 0 || count > GS_PREISSUE_POOL_SIZE - state->_preissueCount) {
+    return GS_PREISSUE_POOL_FULL;
+  }
+  for (int i = 0; i < count; ++i) {
+    preissue(&state->_rng, &state->_priv, &state->_preissue[state->_preissueCount++]);
+  }
+  return GS_RETURN_SUCCESS;
+}
 
-  struct JoinMessage join;
-  struct JoinResponse resp;
-  octet o = {0, joinmsg_len, joinmsg};
-  octet oo = {0, *out_len, out};
-  if (
-    !deserialize_join_message(&o, &join) ||
-    !join_server(&state->_rng, &state->_priv, &join, challenge, challenge_len, &resp)
-  ) {
-    return GS_INVALID_JOIN_MESSAGE;
+int GS_getPreissueCount(void* rawstate) {
+  GS_State* state = (GS_State*)rawstate;
+  return state->_preissueCount;
+}
+
+int GS_getPreissuePoolSize() {
+  return GS_PREISSUE_POOL_SIZE;
+}
+
+int GS_processJoinBatch(
+  void* rawstate,
+  int count,
+  char** joinmsgs, int* joinmsg_lens,
+  char** challenges, int* challenge_lens,
+  char** outs, int* out_lens,
+  int* results
+) {
+  GS_State* state = (GS_State*)rawstate;
+  if (!((1 << GS_SEEDED)&state->state)) {
+    message("GS_SEEDED not set");
+    return GS_NOT_SEEDED;
+  }
+  if (!((1 << GS_GROUP_PRIVKEY)&state->state)) {
+    message("GS_GROUP_PRIVKEY not set");
+    return GS_NOT_SET_GROUP_PRIVATE_KEY;
+  }
+  if (count <= 0) {
+    return GS_RETURN_SUCCESS;
   }
 
-  if (!serialize_join_response(&resp, &oo)) {
-    return GS_OUTPUT_BUFFER_TOO_SMALL;
+  struct JoinEntry* entries = (struct JoinEntry*)malloc(count * sizeof(struct JoinEntry));
+  ECP** points = (ECP**)malloc(6 * count * sizeof(ECP*));
+  int* indices = (int*)malloc(count * sizeof(int));
+  if (!entries || !points || !indices) {
+    free(entries);
+    free(points);
+    free(indices);
+    return GS_OUT_OF_MEMORY;
   }
 
-  *out_len = oo.len;
+  int n = 0;
+  for (int i = 0; i < count; ++i) {
+    octet o = {0, joinmsg_lens[i], joinmsgs[i]};
+    if (!deserialize_join_message(&o, &entries[n].join)) {
+      results[i] = GS_INVALID_JOIN_MESSAGE;
+      continue;
+    }
+    myhash(challenges[i], challenge_lens[i], entries[n].h);
+    indices[n++] = i;
+  }
 
-  return GS_RETURN_SUCCESS;
+  join_server(&state->_rng, &state->_priv, entries, n, state->_preissue, &state->_preissueCount, points);
+
+  int ret = GS_RETURN_SUCCESS;
+  for (int k = 0; k < n; ++k) {
+    int i = indices[k];
+    octet oo = {0, out_lens[i], outs[i]};
+    if (!entries[k].ok) {
+      results[i] = GS_INVALID_JOIN_MESSAGE;
+    } else if (!serialize_join_response(&entries[k].resp, &oo, state->_wireFormat)) {
+      results[i] = GS_OUTPUT_BUFFER_TOO_SMALL;
+    } else {
+      results[i] = GS_RETURN_SUCCESS;
+      out_lens[i] = oo.len;
+    }
+  }
+  for (int i = 0; i < count; ++i) {
+    if (results[i] != GS_RETURN_SUCCESS) {
+      ret = GS_RETURN_FAILURE;
+    }
+  }
+
+  memset(entries, 0, count * sizeof(struct JoinEntry));
+  free(entries);
+  free(points);
+  free(indices);
+  return ret;
 }
 
 int GS_sign(void* rawstate, char* msg, int msg_len, char* bsn, int bsn_len, char* signature, int* len) {
@@ -1140,50 +3025,604 @@ int GS_sign(void* rawstate, char* msg, int msg_len, char* bsn, int bsn_len, char
   if (!((1 << GS_USERCREDS)&state->state)) {
     return GS_NOT_SET_USER_CREDENTIALS;
   }
-  struct Signature sig;
-  sign(&state->_rng, &state->_userPriv, msg, msg_len, bsn, bsn_len, &sig);
+  STAT_BEGIN(t);
+  struct Presignature pre;
+  presign(&state->_drbg, &state->_userPriv, &state->_userTables, bsn, bsn_len, state->_wireFormat, &pre);
+  octet o = {0, *len, signature};
+  int ok = finishPresignature(&pre, state->_userPriv.gsk, msg, msg_len, &o);
+  memset(&pre, 0, sizeof(pre));
+  STAT_END(GS_STAT_SIGN, t);
+  if (!ok) {
+    return GS_OUTPUT_BUFFER_TOO_SMALL;
+  }
+  *len = o.len;
+  return GS_RETURN_SUCCESS;
+}
+
+int GS_presign(void* rawstate, char* bsn, int bsn_len, int count) {
+  GS_State* state = (GS_State*)rawstate;
+  if (!((1 << GS_SEEDED)&state->state)) {
+    message("GS_SEEDED not set");
+    return GS_NOT_SEEDED;
+  }
+  if (!((1 << GS_USERCREDS)&state->state)) {
+    return GS_NOT_SET_USER_CREDENTIALS;
+  }
+  if (count < 0 || count > GS_PRESIGN_POOL_SIZE - state->_presignCount) {
+    return GS_PRESIGN_POOL_FULL;
+  }
+  for (int i = 0; i < count; ++i) {
+    presign(&state->_drbg, &state->_userPriv, &state->_userTables, bsn, bsn_len, state->_wireFormat, &state->_presign[state->_presignCount++]);
+  }
+  return GS_RETURN_SUCCESS;
+}
+
+int GS_onlineSign(void* rawstate, char* msg, int msg_len, char* bsn, int bsn_len, char* signature, int* len) {
+  GS_State* state = (GS_State*)rawstate;
+  if (!((1 << GS_USERCREDS)&state->state)) {
+    return GS_NOT_SET_USER_CREDENTIALS;
+  }
+  int i = findPresignature(state, bsn, bsn_len);
+  if (i == -1) {
+    return GS_NO_PRESIGNATURE;
+  }
   octet o = {0, *len, signature};
-  if (!serialize_signature(&sig, &o)) {
+  if (!finishPresignature(&state->_presign[i], state->_userPriv.gsk, msg, msg_len, &o)) {
     return GS_OUTPUT_BUFFER_TOO_SMALL;
   }
+  removePresignature(state, i);
   *len = o.len;
   return GS_RETURN_SUCCESS;
 }
 
+int GS_getPresignCount(void* rawstate, char* bsn, int bsn_len) {
+  GS_State* state = (GS_State*)rawstate;
+  char h[MODBYTES];
+  int count = 0;
+  myhash(bsn, bsn_len, h);
+  for (int i = 0; i < state->_presignCount; ++i) {
+    count += !memcmp(state->_presign[i].bsn, h, MODBYTES);
+  }
+  return count;
+}
+
+int GS_getPresignPoolSize() {
+  return GS_PRESIGN_POOL_SIZE;
+}
+
+// The return code of GS_verify for a reject reason
+static int verifyReturnCode(int reason)
+{
+  if (reason == GS_REJECT_NONE) {
+    return GS_RETURN_SUCCESS;
+  }
+  return reason == GS_REJECT_ENCODING ? GS_INVALID_SIGNATURE : GS_RETURN_FAILURE;
+}
+
 int GS_verify(void* rawstate, char* msg, int msg_len, char* bsn, int bsn_len, char* signature, int len) {
+  int reason;
+  int retcode = GS_verifyWithReason(rawstate, msg, msg_len, bsn, bsn_len, signature, len, &reason);
+  return retcode == GS_RETURN_SUCCESS ? verifyReturnCode(reason) : retcode;
+}
+
+int GS_verify_r(const void* key, const void* revoked, void* rng, char* msg, int msg_len, char* bsn, int bsn_len, char* signature, int len) {
+  int reason;
+  GS_verifyWithReason_r(key, revoked, rng, msg, msg_len, bsn, bsn_len, signature, len, &reason);
+  return verifyReturnCode(reason);
+}
+
+int GS_verifyWithReason(void* rawstate, char* msg, int msg_len, char* bsn, int bsn_len, char* signature, int len, int* reason) {
   GS_State* state = (GS_State*)rawstate;
   if (!((1 << GS_GROUP_PUBKEY)&state->state)) {
     return GS_NOT_SET_GROUP_PUBLIC_KEY;
   }
-  struct Signature sig;
+  STAT_BEGIN(t);
   octet o = {0, len, signature};
-  if (!deserialize_signature(&o, &sig)) {
-    return GS_INVALID_SIGNATURE;
+  *reason = verify(msg, msg_len, bsn, bsn_len, &o, &state->_prepared, state->_revoked, &state->_drbg, 1);
+  STAT_END(GS_STAT_VERIFY, t);
+  return GS_RETURN_SUCCESS;
+}
+
+// The prepared key is only read (MIRACL takes non-const pointers), and so
+// is the revocation list but for its tables. The basename is not looked up
+// in the cache, which would take its lock.
+int GS_verifyWithReason_r(const void* key, const void* revoked, void* rng, char* msg, int msg_len, char* bsn, int bsn_len, char* signature, int len, int* reason) {
+  STAT_BEGIN(t);
+  octet o = {0, len, signature};
+  *reason = verify(msg, msg_len, bsn, bsn_len, &o, (struct PreparedGroupPublicKey*)key, (struct RevocationList*)revoked, (drbg*)rng, 0);
+  STAT_END(GS_STAT_VERIFY, t);
+  return GS_RETURN_SUCCESS;
+}
+
+const char* GS_getRejectReasonName(int reason) {
+  switch (reason) {
+    case GS_REJECT_NONE: return "none";
+    case GS_REJECT_ENCODING: return "encoding";
+    case GS_REJECT_PROOF: return "proof";
+    case GS_REJECT_PAIRING: return "pairing";
+    case GS_REJECT_REVOKED: return "revoked";
   }
-  if (!verify(msg, msg_len, bsn, bsn_len, &sig, &state->_priv.pub, &state->_rng)) {
-    return GS_RETURN_FAILURE;
+  return NULL;
+}
+
+int GS_verifyBatch(
+  void* rawstate,
+  int count,
+  char** msgs, int* msg_lens,
+  char** bsns, int* bsn_lens,
+  char** signatures, int* lens,
+  int* results
+) {
+  GS_State* state = (GS_State*)rawstate;
+  if (!((1 << GS_GROUP_PUBKEY)&state->state)) {
+    return GS_NOT_SET_GROUP_PUBLIC_KEY;
+  }
+  if (count <= 0) {
+    return GS_RETURN_SUCCESS;
+  }
+
+  struct BatchEntry* entries = (struct BatchEntry*)malloc(count * sizeof(struct BatchEntry));
+  if (!entries) {
+    return GS_OUT_OF_MEMORY;
+  }
+
+  // Signatures that cannot be decoded or whose proof of equality fails
+  // are rejected right away (in the stages of verify), the rest are
+  // checked together.
+  int n = 0;
+  for (int i = 0; i < count; ++i) {
+    struct BatchEntry* entry = &entries[n];
+    octet o = {0, lens[i], signatures[i]};
+    int wire, points;
+    struct BasenameEntry BSN;
+    if (!deserialize_signature_proof(&o, &entry->sig, &wire, &points)) {
+      results[i] = GS_INVALID_SIGNATURE;
+      continue;
+    }
+    if (!verifyProofEquals(msgs[i], msg_lens[i], bsns[i], bsn_lens[i], &entry->sig, &BSN, 1)
+        || isRevoked(state->_revoked, &BSN, &entry->sig.NYM)) {
+      results[i] = GS_RETURN_FAILURE;
+      continue;
+    }
+    if (!deserialize_signature_credentials(&o, &entry->sig, wire, points)) {
+      results[i] = GS_INVALID_SIGNATURE;
+      continue;
+    }
+    if (ECP_isinf(&entry->sig.A)) {
+      results[i] = GS_RETURN_FAILURE;
+      continue;
+    }
+    ECP_copy(&entry->AD, &entry->sig.A);
+    ECP_add(&entry->AD, &entry->sig.D);
+    entry->index = i;
+    results[i] = GS_RETURN_SUCCESS;
+    ++n;
+  }
+
+  verifyBatchBisect(entries, n, &state->_prepared, &state->_drbg, results);
+  free(entries);
+
+  for (int i = 0; i < count; ++i) {
+    if (results[i] != GS_RETURN_SUCCESS) {
+      return GS_RETURN_FAILURE;
+    }
   }
   return GS_RETURN_SUCCESS;
 }
 
 int GS_getSignatureTag(char* signature, int sig_len, char* tag, int* tag_len) {
-  struct Signature sig;
+  ECP NYM;
   octet o = {0, sig_len, signature};
   octet oo = {0, *tag_len, tag};
-  if (!deserialize_signature(&o, &sig)) {
+  if (!deserialize_signature_tag(&o, &NYM)) {
     return GS_INVALID_SIGNATURE;
   }
-  if (!serialize_signature_tag(&sig, &oo)) {
+  if (!serialize_signature_tag(&NYM, &oo)) {
     return GS_OUTPUT_BUFFER_TOO_SMALL;
   }
   *tag_len = oo.len;
   return GS_RETURN_SUCCESS;
 }
 
+// Tag store (see GS_insertTag): an open addressing (linear probing) hash
+// table of H(H(bsn) || tag) keys, in memory provided by the caller. It
+// holds no pointers, so it can live in a memory-mapped file and be
+// reopened later (GS_checkTagStore).
+#define TAG_STORE_MAGIC "GSTAGS1"
+
+struct TagStoreHeader {
+  char magic[8];
+  int keySize; // MODBYTES, so that stores of other curves are rejected
+  int capacity; // maximum number of tags
+  int slots; // 2 * capacity rounded up to a power of 2
+  int count;
+};
+
+struct TagEntry {
+  char key[MODBYTES];
+  unsigned int epoch;
+  int used;
+};
+
+#define TAG_STORE_MAX_CAPACITY (1 << 26)
+
+static int tagStoreSlots(int capacity)
+{
+  int slots = 1;
+  while (slots < 2 * capacity) {
+    slots <<= 1;
+  }
+  return slots;
+}
+
+static struct TagEntry* tagEntries(struct TagStoreHeader* store)
+{
+  return (struct TagEntry*)(store + 1);
+}
+
+static int tagHomeSlot(struct TagStoreHeader* store, char* key)
+{
+  // key is a hash output, so any of its bytes will do
+  unsigned int x = ((unsigned char)key[0] << 24) | ((unsigned char)key[1] << 16)
+                 | ((unsigned char)key[2] << 8) | (unsigned char)key[3];
+  return x & (store->slots - 1);
+}
+
+// Slot that holds key, or the empty slot where it would go. Returns -1 if
+// there is neither, which only happens if the memory was modified behind
+// our back (GS_checkTagStore makes sure that there are empty slots)
+static int tagFindSlot(struct TagStoreHeader* store, char* key)
+{
+  struct TagEntry* entries = tagEntries(store);
+  int s = tagHomeSlot(store, key);
+  for (int i = 0; i < store->slots; ++i) {
+    if (!entries[s].used || !memcmp(entries[s].key, key, MODBYTES)) {
+      return s;
+    }
+    s = (s + 1) & (store->slots - 1);
+  }
+  return -1;
+}
+
+// Same as bsnRemoveSlot
+static void tagRemoveSlot(struct TagStoreHeader* store, int s)
+{
+  struct TagEntry* entries = tagEntries(store);
+  int mask = store->slots - 1;
+  int hole = s;
+  entries[hole].used = 0;
+  // Bounded as tagFindSlot, in case no slot is empty
+  int i = 1;
+  for (s = (s + 1) & mask; entries[s].used && i < store->slots; s = (s + 1) & mask, ++i) {
+    int home = tagHomeSlot(store, entries[s].key);
+    // Move unless home lies cyclically in (hole, s]
+    int stays = hole <= s ? (hole < home && home <= s) : (hole < home || home <= s);
+    if (!stays) {
+      entries[hole] = entries[s];
+      entries[s].used = 0;
+      hole = s;
+    }
+  }
+  store->count--;
+}
+
+size_t GS_getTagStoreSize(int capacity) {
+  if (capacity <= 0 || capacity > TAG_STORE_MAX_CAPACITY) {
+    return 0;
+  }
+  return sizeof(struct TagStoreHeader) + tagStoreSlots(capacity) * sizeof(struct TagEntry);
+}
+
+int GS_initTagStore(void* rawstore, int capacity) {
+  size_t size = GS_getTagStoreSize(capacity);
+  if (size == 0) {
+    return GS_INVALID_TAG_STORE;
+  }
+  struct TagStoreHeader* store = (struct TagStoreHeader*)rawstore;
+  memset(store, 0, size);
+  memcpy(store->magic, TAG_STORE_MAGIC, sizeof(store->magic));
+  store->keySize = MODBYTES;
+  store->capacity = capacity;
+  store->slots = tagStoreSlots(capacity);
+  store->count = 0;
+  return GS_RETURN_SUCCESS;
+}
+
+int GS_checkTagStore(void* rawstore, size_t size) {
+  struct TagStoreHeader* store = (struct TagStoreHeader*)rawstore;
+  if (size < sizeof(struct TagStoreHeader)
+      || memcmp(store->magic, TAG_STORE_MAGIC, sizeof(store->magic))
+      || store->keySize != MODBYTES
+      || GS_getTagStoreSize(store->capacity) != size
+      || store->slots != tagStoreSlots(store->capacity)
+      || store->count < 0 || store->count > store->capacity) {
+    return GS_INVALID_TAG_STORE;
+  }
+  // A torn write could leave more used slots than count says, down to none
+  // empty, so count them: there are more slots than capacity
+  struct TagEntry* entries = tagEntries(store);
+  int used = 0;
+  for (int s = 0; s < store->slots; ++s) {
+    used += entries[s].used != 0;
+  }
+  if (used != store->count) {
+    return GS_INVALID_TAG_STORE;
+  }
+  return GS_RETURN_SUCCESS;
+}
+
+int GS_insertTag(void* rawstore, char* signature, int sig_len, char* bsn, int bsn_len, unsigned int epoch, int* duplicate) {
+  struct TagStoreHeader* store = (struct TagStoreHeader*)rawstore;
+  ECP NYM;
+  octet o = {0, sig_len, signature};
+  if (!deserialize_signature_tag(&o, &NYM)) {
+    return GS_INVALID_SIGNATURE;
+  }
+
+  // key = H(H(bsn) || tag)
+  char buf[MODBYTES + ECPSIZE];
+  char key[MODBYTES];
+  octet oo = {MODBYTES, sizeof(buf), buf};
+  myhash(bsn, bsn_len, buf);
+  serialize_signature_tag(&NYM, &oo);
+  myhash(buf, oo.len, key);
+
+  int s = tagFindSlot(store, key);
+  if (s < 0) {
+    return GS_INVALID_TAG_STORE;
+  }
+  struct TagEntry* entry = &tagEntries(store)[s];
+  if (entry->used) {
+    *duplicate = 1;
+    return GS_RETURN_SUCCESS;
+  }
+  if (store->count >= store->capacity) {
+    return GS_TAG_STORE_FULL;
+  }
+  memcpy(entry->key, key, MODBYTES);
+  entry->epoch = epoch;
+  entry->used = 1;
+  store->count++;
+  *duplicate = 0;
+  return GS_RETURN_SUCCESS;
+}
+
+int GS_expireTags(void* rawstore, unsigned int epoch) {
+  struct TagStoreHeader* store = (struct TagStoreHeader*)rawstore;
+  struct TagEntry* entries = tagEntries(store);
+  int removed = 0;
+  for (int s = 0; s < store->slots; ++s) {
+    // Removing moves a later entry into s, which must be checked too
+    while (entries[s].used && entries[s].epoch < epoch) {
+      tagRemoveSlot(store, s);
+      removed++;
+    }
+  }
+  return removed;
+}
+
+int GS_getTagCount(void* rawstore) {
+  return ((struct TagStoreHeader*)rawstore)->count;
+}
+
+int GS_getTagStoreCapacity(void* rawstore) {
+  return ((struct TagStoreHeader*)rawstore)->capacity;
+}
+
+int GS_createRevocationList(char* gsks, int len, void** out) {
+  if (len < 0 || len % BIGSIZE) {
+    return GS_INVALID_REVOCATION_LIST;
+  }
+  int count = len / BIGSIZE;
+  struct RevocationList* list = NULL;
+  if (count > 0) {
+    // calloc, so that all the tables are unused
+    list = (struct RevocationList*)calloc(1, sizeof(struct RevocationList) + count * sizeof(BIG));
+    if (!list) {
+      return GS_OUT_OF_MEMORY;
+    }
+    list->count = count;
+  }
+  BIG order;
+  BIG_rcopy(order, CURVE_Order);
+  octet o = {0, len, gsks};
+  for (int i = 0; i < count; ++i) {
+    deserialize_BIG(&o, &list->gsks[i]);
+    if (BIG_iszilch(list->gsks[i]) || BIG_comp(list->gsks[i], order) >= 0) {
+      memset(list->gsks, 0, count * sizeof(BIG));
+      free(list);
+      return GS_INVALID_REVOCATION_LIST;
+    }
+  }
+  *out = list;
+  return GS_RETURN_SUCCESS;
+}
+
+void GS_freeRevocationList(void* rawlist) {
+  struct RevocationList* list = (struct RevocationList*)rawlist;
+  if (!list) {
+    return;
+  }
+  for (int i = 0; i < GS_REVOCATION_CACHE_SIZE; ++i) {
+    free(list->tables[i].keys);
+  }
+  memset(list->gsks, 0, list->count * sizeof(BIG));
+  free(list);
+}
+
+int GS_getRevocationListCount(const void* list) {
+  return list ? ((const struct RevocationList*)list)->count : 0;
+}
+
+void GS_setRevocationList(void* rawstate, void* list) {
+  GS_State* state = (GS_State*)rawstate;
+  GS_freeRevocationList(state->_revoked);
+  state->_revoked = (struct RevocationList*)list;
+}
+
+const void* GS_getRevocationList(void* rawstate) {
+  return ((GS_State*)rawstate)->_revoked;
+}
+
+int GS_setBasenameCacheCapacity(int capacity) {
+  if (capacity < 0) {
+    return GS_RETURN_FAILURE;
+  }
+  int ret = GS_RETURN_SUCCESS;
+  LOCK_CACHES();
+  free(bsnCache.entries);
+  free(bsnCache.slots);
+  bsnCache.entries = NULL;
+  bsnCache.slots = NULL;
+  bsnCache.size = 0;
+  bsnCache.capacity = capacity;
+  if (capacity > 0 && !bsnCacheInit()) {
+    ret = GS_OUT_OF_MEMORY;
+  }
+  UNLOCK_CACHES();
+  return ret;
+}
+
+void GS_getBasenameCacheStats(int* capacity, int* size, unsigned long long* hits, unsigned long long* misses) {
+  LOCK_CACHES();
+  *capacity = bsnCache.capacity;
+  *size = bsnCache.size;
+  *hits = bsnCache.hits;
+  *misses = bsnCache.misses;
+  UNLOCK_CACHES();
+}
+
+static const char* statNames[GS_STAT_COUNT] = {
+  "sign",
+  "verify",
+  "deserialize",
+  "hash",
+  "basename",
+  "mapit",
+  "proof",
+  "aux",
+  "pairing",
+};
+
+int GS_getStatsCount() {
+  return GS_STATS ? GS_STAT_COUNT : 0;
+}
+
+const char* GS_getStatName(int stat) {
+  if (stat < 0 || stat >= GS_STAT_COUNT) {
+    return NULL;
+  }
+  return statNames[stat];
+}
+
+const char* GS_getStatsClock() {
+  return STATS_CLOCK;
+}
+
+int GS_getStats(int stat, unsigned long long* calls, unsigned long long* ticks, unsigned long long* histogram) {
+  if (stat < 0 || stat >= GS_getStatsCount()) {
+    return GS_RETURN_FAILURE;
+  }
+#if GS_STATS
+  *calls = __atomic_load_n(&stats[stat].calls, __ATOMIC_RELAXED);
+  *ticks = __atomic_load_n(&stats[stat].ticks, __ATOMIC_RELAXED);
+  for (int i = 0; i < GS_STATS_BUCKETS; ++i) {
+    histogram[i] = __atomic_load_n(&stats[stat].histogram[i], __ATOMIC_RELAXED);
+  }
+#else
+  (void)calls;
+  (void)ticks;
+  (void)histogram;
+#endif
+  return GS_RETURN_SUCCESS;
+}
+
+void GS_resetStats() {
+#if GS_STATS
+  for (int stat = 0; stat < GS_STAT_COUNT; ++stat) {
+    __atomic_store_n(&stats[stat].calls, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&stats[stat].ticks, 0, __ATOMIC_RELAXED);
+    for (int i = 0; i < GS_STATS_BUCKETS; ++i) {
+      __atomic_store_n(&stats[stat].histogram[i], 0, __ATOMIC_RELAXED);
+    }
+  }
+#endif
+}
+
 size_t GS_getStateSize() {
   return sizeof(GS_State);
 }
 
+size_t GS_getPreparedKeySize() {
+  return sizeof(struct PreparedGroupPublicKey);
+}
+
+size_t GS_getRNGSize() {
+  return sizeof(drbg);
+}
+
+int GS_prepareGroupPubKey(void* key, char* data, int len) {
+  struct GroupPublicKey pub;
+  octet o = {0, len, data};
+  if (!deserialize_group_public_key(&o, &pub)) {
+    return GS_INVALID_GROUP_PUBLIC_KEY;
+  }
+  prepareGroupPublicKey(&pub, (struct PreparedGroupPublicKey*)key);
+  return GS_RETURN_SUCCESS;
+}
+
+const void* GS_getPreparedGroupPubKey(void* rawstate) {
+  GS_State* state = (GS_State*)rawstate;
+  if (!((1 << GS_GROUP_PUBKEY)&state->state)) {
+    return NULL;
+  }
+  return &state->_prepared;
+}
+
+int GS_seedRNG(void* rng, char* seed, int seed_length) {
+  if (seed_length < 128) {
+    return GS_SEED_TOO_SMALL;
+  }
+  drbgSeed((drbg*)rng, seed_length, seed);
+  return GS_RETURN_SUCCESS;
+}
+
+int GS_forkRNG(void* rng, void* out) {
+  char seed[128];
+  drbgBytes((drbg*)rng, seed, sizeof(seed));
+  drbgSeed((drbg*)out, sizeof(seed), seed);
+  memset(seed, 0, sizeof(seed));
+  return GS_RETURN_SUCCESS;
+}
+
+int GS_forkStateRNG(void* rawstate, void* out) {
+  GS_State* state = (GS_State*)rawstate;
+  if (!((1 << GS_SEEDED)&state->state)) {
+    return GS_NOT_SEEDED;
+  }
+  return GS_forkRNG(&state->_drbg, out);
+}
+
+// v1 sizes, v2 blobs are always smaller. Prepared keys are raw memory.
+int GS_getMaxSize(int object) {
+  switch (object) {
+    case GS_SIZE_GROUP_PUBLIC_KEY: return 2 * ECP2SIZE + 4 * BIGSIZE;
+    case GS_SIZE_GROUP_PRIVATE_KEY: return 2 * ECP2SIZE + 6 * BIGSIZE;
+    case GS_SIZE_GSK: return BIGSIZE;
+    case GS_SIZE_USER_CREDENTIALS: return 4 * ECPSIZE + BIGSIZE;
+    case GS_SIZE_JOIN_MESSAGE: return ECPSIZE + 2 * BIGSIZE;
+    case GS_SIZE_JOIN_RESPONSE: return 4 * ECPSIZE + 2 * BIGSIZE;
+    case GS_SIZE_SIGNATURE: return 5 * ECPSIZE + 2 * BIGSIZE;
+    case GS_SIZE_SIGNATURE_TAG: return ECPSIZE;
+    case GS_SIZE_PREPARED_GROUP_PUBLIC_KEY: return sizeof(struct SharedGroupPublicKey);
+    default: return 0;
+  }
+}
+
+int GS_selfTest() {
+  return drbgSelfTest() ? GS_RETURN_SUCCESS : GS_RETURN_FAILURE;
+}
+
 const char* GS_version() {
   return "1.0";
 }
@@ -1217,6 +3656,14 @@ const char* GS_error(int error_code) {
     case GS_NOT_SET_USER_CREDENTIALS: return "user credentials not set";
     case GS_INVALID_JOIN_MESSAGE: return "invalid join message";
     case GS_INVALID_SIGNATURE: return "invalid signature";
+    case GS_OUT_OF_MEMORY: return "out of memory";
+    case GS_PRESIGN_POOL_FULL: return "presignature pool full";
+    case GS_NO_PRESIGNATURE: return "no presignature for basename";
+    case GS_PREISSUE_POOL_FULL: return "issuance pool full";
+    case GS_INVALID_WIRE_FORMAT: return "invalid wire format";
+    case GS_TAG_STORE_FULL: return "tag store full";
+    case GS_INVALID_TAG_STORE: return "invalid tag store";
+    case GS_INVALID_REVOCATION_LIST: return "invalid revocation list";
     default: return "unknown message";
   }
 }
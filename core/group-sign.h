@@ -20,10 +20,58 @@ enum ReturnCodes {
   GS_NOT_SET_GROUP_PUBLIC_KEY,
   GS_NOT_SET_USER_CREDENTIALS,
   GS_INVALID_JOIN_MESSAGE,
-  GS_INVALID_SIGNATURE
+  GS_INVALID_SIGNATURE,
+  GS_OUT_OF_MEMORY,
+  GS_PRESIGN_POOL_FULL,
+  GS_NO_PRESIGNATURE,
+  GS_PREISSUE_POOL_FULL,
+  GS_INVALID_WIRE_FORMAT,
+  GS_TAG_STORE_FULL,
+  GS_INVALID_TAG_STORE,
+  GS_INVALID_REVOCATION_LIST
+};
+
+// Stages at which verification rejects a signature, see GS_verifyWithReason
+enum RejectReasons {
+  GS_REJECT_NONE,
+  GS_REJECT_ENCODING,
+  GS_REJECT_PROOF,
+  GS_REJECT_PAIRING,
+  GS_REJECT_REVOKED
+};
+
+// Stages of GS_getStats
+enum Stats {
+  GS_STAT_SIGN,
+  GS_STAT_VERIFY,
+  GS_STAT_DESERIALIZE,
+  GS_STAT_HASH,
+  GS_STAT_BASENAME,
+  GS_STAT_MAPIT,
+  GS_STAT_PROOF,
+  GS_STAT_AUX,
+  GS_STAT_PAIRING,
+  GS_STAT_COUNT
+};
+
+#define GS_STATS_BUCKETS 32
+
+// Serialized objects, see GS_getMaxSize
+enum Sizes {
+  GS_SIZE_GROUP_PUBLIC_KEY,
+  GS_SIZE_GROUP_PRIVATE_KEY,
+  GS_SIZE_GSK,
+  GS_SIZE_USER_CREDENTIALS,
+  GS_SIZE_JOIN_MESSAGE,
+  GS_SIZE_JOIN_RESPONSE,
+  GS_SIZE_SIGNATURE,
+  GS_SIZE_SIGNATURE_TAG,
+  GS_SIZE_PREPARED_GROUP_PUBLIC_KEY
 };
 
 void GS_initState(void* state);
+// Seeds both the generator of keys and credentials, which is the same in
+// all builds, and the one of nonces (see GS_DRBG in group-sign.c).
 int GS_seed(void* state, char* seed, int seed_length);
 int GS_setupGroup(void* state);
 int GS_loadGroupPrivKey(void* state, char* data, int len);
@@ -45,11 +93,178 @@ int GS_loadUserCredentials(void* state, char* in, int in_len);
 int GS_exportGroupPrivKey(void* state, char* out, int* out_len);
 int GS_exportGroupPubKey(void* state, char* out, int* out_len);
 int GS_exportUserCredentials(void* state, char* out, int* out_len);
+// Copies the group public key of the state, already validated, together
+// with its prepared form (GS_getMaxSize(GS_SIZE_PREPARED_GROUP_PUBLIC_KEY)
+// bytes of raw memory). GS_loadPreparedGroupPubKey sets it in another
+// state of the same process without validating or preparing it again, so
+// the copy must not come from an untrusted source. A header (curve,
+// layout and checksum) only rejects copies from other builds and
+// corrupted ones, with GS_INVALID_GROUP_PUBLIC_KEY.
+int GS_exportPreparedGroupPubKey(void* state, char* out, int* out_len);
+int GS_loadPreparedGroupPubKey(void* state, char* data, int len);
+// Selects the format of exported keys and credentials, join messages and
+// responses, and signatures: 1 (uncompressed points, the default) or 2
+// (compressed points). Both formats are always accepted as input;
+// GS_finishJoin returns credentials in the format of the join response.
+// Signature tags do not depend on the format.
+int GS_setWireFormat(void* state, int version);
+// Offline/online issuance. GS_preissue precomputes count issuance tuples
+// (the part of a join response that does not depend on the join message)
+// and keeps them in the state, which holds up to GS_getPreissuePoolSize()
+// of them. GS_processJoin and GS_processJoinBatch use them while there are
+// any left. Loading or generating group keys discards the pool.
+int GS_preissue(void* state, int count);
+int GS_getPreissueCount(void* state);
+int GS_getPreissuePoolSize();
 int GS_processJoin(void* state, char* joinmsg, int joinmsg_len, char* challenge, int challenge_len, char* out, int* out_len);
+// Processes count join messages at once. outs[i] must hold out_lens[i]
+// bytes, and out_lens[i] is set to the length of the i-th join response.
+// results[i] is set to the value that GS_processJoin would return for the
+// i-th message. Returns GS_RETURN_SUCCESS only if all messages succeed.
+int GS_processJoinBatch(
+  void* state,
+  int count, // in
+  char** joinmsgs, int* joinmsg_lens, // in
+  char** challenges, int* challenge_lens, // in
+  char** outs, int* out_lens, // in/out
+  int* results // out
+);
 int GS_sign(void* state, char* msg, int msg_len, char* bsn, int bsn_len, char* signature, int* len);
+// Offline/online signing. GS_presign precomputes count signatures on bsn
+// (all but the message-dependent part) and keeps them in the state, which
+// holds up to GS_getPresignPoolSize() of them. GS_onlineSign completes one
+// of them for msg, and fails with GS_NO_PRESIGNATURE if there is none for
+// bsn. Loading new user credentials discards the pool.
+int GS_presign(void* state, char* bsn, int bsn_len, int count);
+int GS_onlineSign(void* state, char* msg, int msg_len, char* bsn, int bsn_len, char* signature, int* len);
+int GS_getPresignCount(void* state, char* bsn, int bsn_len);
+int GS_getPresignPoolSize();
 int GS_verify(void* state, char* msg, int msg_len, char* bsn, int bsn_len, char* signature, int len);
+// Reentrant verification. A prepared group public key is never modified
+// once set, so any number of threads can share one. Each thread brings
+// its own random number generator, which GS_verify_r updates. Neither the
+// key nor the generator is locked, and the basename is mapped to a point
+// every time instead of going through the process-wide basename cache,
+// so that the only lock taken (in builds with GS_THREADS) is the one of
+// the revocation tables, if a revocation list is given. Mapping
+// costs a hash and a square root, little next to the pairings. GS_verify
+// is GS_verify_r with the key, the revocation list and the generator of
+// the state, but with the basename cache.
+//
+// Prepared keys take GS_getPreparedKeySize() bytes and are filled by
+// GS_prepareGroupPubKey, or borrowed from a state with
+// GS_getPreparedGroupPubKey (NULL if it has no group public key; valid
+// until the key of the state changes). Generators take GS_getRNGSize()
+// bytes and are seeded with GS_seedRNG, or with bytes drawn from another
+// generator (GS_forkRNG) or from the generator of a seeded state
+// (GS_forkStateRNG). Both are plain memory that can be copied.
+size_t GS_getPreparedKeySize();
+int GS_prepareGroupPubKey(void* key, char* data, int len);
+const void* GS_getPreparedGroupPubKey(void* state);
+size_t GS_getRNGSize();
+int GS_seedRNG(void* rng, char* seed, int seed_length);
+int GS_forkRNG(void* rng, void* out);
+int GS_forkStateRNG(void* state, void* out);
+int GS_verify_r(const void* key, const void* revoked, void* rng, char* msg, int msg_len, char* bsn, int bsn_len, char* signature, int len);
+// Same as GS_verify and GS_verify_r, but instead of failing for invalid
+// signatures they set reason to the stage at which the signature was
+// rejected (one of enum RejectReasons), or GS_REJECT_NONE if it is valid.
+// Verification stops at the first stage that fails: decoding B, D, NYM
+// and the proof, checking the proof of equality, checking the revocation
+// list (see GS_createRevocationList), decoding A and C, and the pairings. So
+// GS_verify only fails with GS_INVALID_SIGNATURE for an invalid A or C if
+// the proof of equality holds.
+int GS_verifyWithReason(void* state, char* msg, int msg_len, char* bsn, int bsn_len, char* signature, int len, int* reason);
+int GS_verifyWithReason_r(const void* key, const void* revoked, void* rng, char* msg, int msg_len, char* bsn, int bsn_len, char* signature, int len, int* reason);
+const char* GS_getRejectReasonName(int reason);
+// Verifies count signatures at once. results[i] is set to the value that
+// GS_verify would return for the i-th signature. Returns GS_RETURN_SUCCESS
+// only if all signatures are valid.
+int GS_verifyBatch(
+  void* state,
+  int count, // in
+  char** msgs, int* msg_lens, // in
+  char** bsns, int* bsn_lens, // in
+  char** signatures, int* lens, // in
+  int* results // out
+);
+// Lists of revoked user private keys (gsk, as output by GS_startJoin):
+// signatures by these keys are rejected with GS_REJECT_REVOKED once their
+// proof of equality holds. GS_createRevocationList makes a list of gsks,
+// the concatenation of the keys, and sets list to it (NULL if there are
+// none), to be freed with GS_freeRevocationList. The first check of a list
+// for each basename computes the tags of all its keys, later ones only
+// look the tag of the signature up.
+//
+// The state functions check the list of the state, which
+// GS_setRevocationList sets (NULL for none). The state owns it from then
+// on and frees the previous one, so GS_setRevocationList(state, NULL) must
+// be called before freeing a state that has a list. GS_getRevocationList
+// returns the list of the state, for GS_verify_r. The _r functions take
+// the list as an argument instead (NULL for none).
+int GS_createRevocationList(char* gsks, int len, void** list);
+void GS_freeRevocationList(void* list);
+int GS_getRevocationListCount(const void* list);
+void GS_setRevocationList(void* state, void* list);
+const void* GS_getRevocationList(void* state);
+// Process-wide cache of basenames mapped to points, shared by all states.
+// Changing the capacity empties the cache; 0 disables it.
+int GS_setBasenameCacheCapacity(int capacity);
+void GS_getBasenameCacheStats(
+  int* capacity, int* size, // out
+  unsigned long long* hits, unsigned long long* misses // out
+);
+// Hot-path statistics, process-wide and only recorded in builds with
+// GS_STATS=1 (see config.debug). For each stage, the number of calls, the
+// total ticks spent in them (in the unit of GS_getStatsClock(): "rdtsc",
+// "cntvct" or "ns") and a histogram of the ticks per call, where bucket i
+// counts the calls that took [2^i, 2^(i+1)) ticks (bucket 0 also counts 0,
+// the last bucket everything above). Stages nest: for example, hash and
+// mapit are also counted in basename, which is part of sign and verify.
+// GS_getStatsCount() is 0 in builds without statistics, where GS_getStats
+// fails. histogram must hold GS_STATS_BUCKETS counters.
+int GS_getStatsCount();
+const char* GS_getStatName(int stat);
+const char* GS_getStatsClock();
+int GS_getStats(
+  int stat, // in, one of enum Stats
+  unsigned long long* calls, unsigned long long* ticks, // out
+  unsigned long long* histogram // out
+);
+void GS_resetStats();
+// Only decodes the tag (NYM) of the signature: valid tags do not imply
+// valid signatures.
 int GS_getSignatureTag(char* signature, int sig_len, char* tag, int* tag_len);
+// Tag store, to detect signatures made with the same credentials and
+// basename. It keeps up to capacity tags, scoped by basename, in
+// GS_getTagStoreSize(capacity) bytes of memory owned by the caller (0 for
+// invalid capacities), which GS_initTagStore initializes. The memory is
+// plain data, so it can be copied or mapped from a file; GS_checkTagStore
+// validates such memory before it is used, including its count of tags.
+//
+// GS_insertTag inserts the tag of the signature for bsn, with the given
+// epoch, and sets duplicate to 1 if it was already there (keeping the
+// epoch of the first insertion), or to 0 otherwise. It fails with
+// GS_TAG_STORE_FULL if the tag is new and the store is full, and with
+// GS_INVALID_TAG_STORE if the memory was corrupted since. The
+// signature is not verified. GS_expireTags removes the tags inserted with
+// an epoch older than the given one, and returns how many.
+size_t GS_getTagStoreSize(int capacity);
+int GS_initTagStore(void* store, int capacity);
+int GS_checkTagStore(void* store, size_t size);
+int GS_insertTag(void* store, char* signature, int sig_len, char* bsn, int bsn_len, unsigned int epoch, int* duplicate);
+int GS_expireTags(void* store, unsigned int epoch);
+int GS_getTagCount(void* store);
+int GS_getTagStoreCapacity(void* store);
 size_t GS_getStateSize();
+// Largest serialized size of an object (one of enum Sizes) in any wire
+// format, which is enough for any output buffer. Returns 0 for unknown
+// objects.
+int GS_getMaxSize(int object);
+// Checks the nonce generator against known answers (the ChaCha20 test
+// vectors of RFC 8439 in builds with GS_DRBG). Returns GS_RETURN_SUCCESS
+// or GS_RETURN_FAILURE.
+int GS_selfTest();
 const char* GS_version();
 const char* GS_curve();
 int GS_success();
@@ -1,6 +1,16 @@
 #include <node_api.h>
+#include <uv.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 extern size_t GS_getStateSize();
 extern void GS_initState(void* state);
@@ -13,10 +23,77 @@ extern int GS_loadUserCredentials(void* state, char* in, int in_len);
 extern int GS_exportGroupPrivKey(void* state, char* out, int* out_len);
 extern int GS_exportGroupPubKey(void* state, char* out, int* out_len);
 extern int GS_exportUserCredentials(void* state, char* out, int* out_len);
+extern int GS_exportPreparedGroupPubKey(void* state, char* out, int* out_len);
+extern int GS_loadPreparedGroupPubKey(void* state, char* data, int len);
+extern int GS_getMaxSize(int object);
+#define GS_SIZE_GSK 2 // from enum Sizes in group-sign.h
+#define GS_SIZE_PREPARED_GROUP_PUBLIC_KEY 8 // from enum Sizes in group-sign.h
+extern int GS_setWireFormat(void* state, int version);
 extern int GS_processJoin(void* state, char* joinmsg, int joinmsg_len, char* challenge, int challenge_len, char* out, int* out_len);
+extern int GS_preissue(void* state, int count);
+extern int GS_getPreissueCount(void* state);
+extern int GS_getPreissuePoolSize();
+extern int GS_processJoinBatch(
+  void* state,
+  int count, // in
+  char** joinmsgs, int* joinmsg_lens, // in
+  char** challenges, int* challenge_lens, // in
+  char** outs, int* out_lens, // in/out
+  int* results // out
+);
 extern int GS_sign(void* state, char* msg, int msg_len, char* bsn, int bsn_len, char* signature, int* len);
+extern int GS_presign(void* state, char* bsn, int bsn_len, int count);
+extern int GS_onlineSign(void* state, char* msg, int msg_len, char* bsn, int bsn_len, char* signature, int* len);
+extern int GS_getPresignCount(void* state, char* bsn, int bsn_len);
+extern int GS_getPresignPoolSize();
 extern int GS_verify(void* state, char* msg, int msg_len, char* bsn, int bsn_len, char* signature, int len);
+extern const void* GS_getPreparedGroupPubKey(void* state);
+extern size_t GS_getPreparedKeySize();
+extern int GS_prepareGroupPubKey(void* key, char* data, int len);
+extern size_t GS_getRNGSize();
+extern int GS_seedRNG(void* rng, char* seed, int seed_length);
+extern int GS_forkRNG(void* rng, void* out);
+extern int GS_forkStateRNG(void* state, void* out);
+extern int GS_verify_r(const void* key, const void* revoked, void* rng, char* msg, int msg_len, char* bsn, int bsn_len, char* signature, int len);
+extern int GS_verifyBatch(
+  void* state,
+  int count, // in
+  char** msgs, int* msg_lens, // in
+  char** bsns, int* bsn_lens, // in
+  char** signatures, int* lens, // in
+  int* results // out
+);
+extern int GS_createRevocationList(char* gsks, int len, void** list);
+extern void GS_freeRevocationList(void* list);
+extern int GS_getRevocationListCount(const void* list);
+extern void GS_setRevocationList(void* state, void* list);
+extern const void* GS_getRevocationList(void* state);
+extern int GS_setBasenameCacheCapacity(int capacity);
+extern void GS_getBasenameCacheStats(
+  int* capacity, int* size, // out
+  unsigned long long* hits, unsigned long long* misses // out
+);
+extern int GS_verifyWithReason(void* state, char* msg, int msg_len, char* bsn, int bsn_len, char* signature, int len, int* reason);
+extern const char* GS_getRejectReasonName(int reason);
+#define GS_REJECT_NONE 0 // from enum RejectReasons in group-sign.h
+extern int GS_getStatsCount();
+extern const char* GS_getStatName(int stat);
+extern const char* GS_getStatsClock();
+extern int GS_getStats(
+  int stat, // in
+  unsigned long long* calls, unsigned long long* ticks, // out
+  unsigned long long* histogram // out
+);
+extern void GS_resetStats();
+#define GS_STATS_BUCKETS 32 // from group-sign.h
 extern int GS_getSignatureTag(char* signature, int sig_len, char* tag, int* tag_len);
+extern size_t GS_getTagStoreSize(int capacity);
+extern int GS_initTagStore(void* store, int capacity);
+extern int GS_checkTagStore(void* store, size_t size);
+extern int GS_insertTag(void* store, char* signature, int sig_len, char* bsn, int bsn_len, unsigned int epoch, int* duplicate);
+extern int GS_expireTags(void* store, unsigned int epoch);
+extern int GS_getTagCount(void* store);
+extern int GS_getTagStoreCapacity(void* store);
 extern int GS_startJoin(
   void* state,
   char* challenge, // in
@@ -32,6 +109,7 @@ extern int GS_finishJoin(
   char* credentials, int* len_credentials // out
 );
 
+extern int GS_selfTest();
 extern const char* GS_version();
 extern const char* GS_curve();
 extern int GS_success();
@@ -48,6 +126,9 @@ extern const char* GS_error(int error_code);
 #define DECLARE_NAPI_STATIC(name, value) \
   { name, 0, 0, 0, 0, value, napi_static, 0 }
 
+#define DECLARE_NAPI_STATIC_METHOD(name, func) \
+  { name, 0, func, 0, 0, 0, napi_static, 0 }
+
 #define NAPI_CALL(call) (assert(call == napi_ok))
 
 #define NAPI_GET_ARGS(nargs, env, info, argc, args, jsthis) \
@@ -76,22 +157,60 @@ do { \
   } \
 } while (0)
 
+// Throws if the instance has been destroyed or is running asynchronous
+// operations
+#define GS_UNWRAP(env, jsthis, obj) \
+do { \
+  NAPI_CALL(napi_unwrap(env, jsthis, (void**)(&obj))); \
+  if (obj->state == NULL) { \
+    NAPI_CALL(napi_throw_error(env, NULL, "GroupSigner has been destroyed")); \
+    return NULL; \
+  } \
+  if (obj->pending != NULL || obj->running > 0) { \
+    NAPI_CALL(napi_throw_error(env, NULL, "GroupSigner is busy")); \
+    return NULL; \
+  } \
+} while (0)
+
+struct AsyncCall;
+
+// The addon can be loaded by several environments at once (the main thread
+// and worker threads), so everything it keeps is per environment
+typedef struct {
+  napi_ref constructor;
+  napi_ref tagStoreConstructor;
+  napi_ref keyRegistryConstructor;
+
+  // Asynchronous calls must not run once the environment is torn down,
+  // since the states they use are freed with it
+  uv_mutex_t lock; // guards executing and closing
+  uv_cond_t idle; // signaled when executing drops to 0
+  int executing;
+  int closing;
+} AddonData;
+
 typedef struct {
   napi_env env_;
   napi_ref wrapper_;
 
-  void* state;
+  void* state; // NULL once destroyed
+  struct AsyncCall* pending; // running asynchronous call, then queued ones
+  struct AsyncCall* pendingTail;
+  int running; // asynchronous calls that run outside the queue
+  void* rng; // seeds the generators of those calls, NULL until seeded
 } GroupSigner;
 
 void Destructor(napi_env env, void* nativeObject, void* finalize_hint) {
   GroupSigner* obj = (GroupSigner*) nativeObject;
+  if (obj->state != NULL) {
+    GS_setRevocationList(obj->state, NULL);
+  }
   free(obj->state);
+  free(obj->rng);
   napi_delete_reference(obj->env_, obj->wrapper_);
   free(nativeObject);
 }
 
-napi_ref constructor;
-
 napi_value New(napi_env env, napi_callback_info info) {
   napi_value is_constructor;
   NAPI_CALL(napi_get_new_target(env, info, &is_constructor));
@@ -106,6 +225,10 @@ napi_value New(napi_env env, napi_callback_info info) {
     obj->state = malloc(GS_getStateSize());
     GS_initState(obj->state);
     obj->env_ = env;
+    obj->pending = NULL;
+    obj->pendingTail = NULL;
+    obj->running = 0;
+    obj->rng = NULL;
 
     NAPI_CALL(napi_wrap(env,
                        jsthis,
@@ -122,8 +245,10 @@ napi_value New(napi_env env, napi_callback_info info) {
     const size_t argc = 1;
     napi_value argv[] = {args[0]};
 
+    AddonData* data;
+    NAPI_CALL(napi_get_instance_data(env, (void**)(&data)));
     napi_value cons;
-    NAPI_CALL(napi_get_reference_value(env, constructor, &cons));
+    NAPI_CALL(napi_get_reference_value(env, data->constructor, &cons));
 
     napi_value instance;
     NAPI_CALL(napi_new_instance(env, cons, argc, argv, &instance));
@@ -142,24 +267,22 @@ char* getData(napi_env env, napi_value value, size_t* out_len) {
     return NULL;
   }
 
+  // The data pointer (rather than the one of the ArrayBuffer) also works
+  // for views of a SharedArrayBuffer
+  static char empty[1];
   napi_typedarray_type type;
-  napi_value input_buffer;
-  size_t byte_offset;
   size_t length;
+  char* data;
   NAPI_CALL(napi_get_typedarray_info(
-    env, value, &type, &length, NULL, &input_buffer, &byte_offset
+    env, value, &type, &length, (void**)(&data), NULL, NULL
   ));
 
   if (type != napi_uint8_array) {
     return NULL;
   }
 
-  char* data;
-  size_t byte_length;
-  NAPI_CALL(napi_get_arraybuffer_info(
-   env, input_buffer, (void**)(&data), &byte_length));
   *out_len = length;
-  return &data[byte_offset];
+  return data != NULL ? data : empty;
 }
 
 napi_value getUndefined(napi_env env) {
@@ -180,13 +303,24 @@ napi_value Seed(napi_env env, napi_callback_info info) {
   napi_value jsthis;
   NAPI_GET_ARGS(1, env, info, argc, args, jsthis);
   GroupSigner* obj;
-  NAPI_CALL(napi_unwrap(env, jsthis, (void**)(&obj)));
+  GS_UNWRAP(env, jsthis, obj);
 
   size_t len = 0;
   char* data = NULL;
   GS_GET_DATA(data, env, args[0], &len);
   GS_CALL(GS_seed(obj->state, data, len));
 
+  // Generator for verifyAsync, independent of the one of the state
+  if (obj->rng == NULL) {
+    obj->rng = malloc(GS_getRNGSize());
+  }
+  // Without it, verifyAsync falls back to queued GS_verify calls
+  if (obj->rng != NULL && GS_forkStateRNG(obj->state, obj->rng) != GS_success()) {
+    memset(obj->rng, 0, GS_getRNGSize());
+    free(obj->rng);
+    obj->rng = NULL;
+  }
+
   return getUndefined(env);
 }
 
@@ -196,7 +330,7 @@ napi_value SetupGroup(napi_env env, napi_callback_info info) {
   NAPI_GET_ARGS(0, env, info, argc, NULL, jsthis);
 
   GroupSigner* obj;
-  NAPI_CALL(napi_unwrap(env, jsthis, (void**)(&obj)));
+  GS_UNWRAP(env, jsthis, obj);
 
   GS_CALL(GS_setupGroup(obj->state));
 
@@ -208,7 +342,7 @@ napi_value GetGroupPubKey(napi_env env, napi_callback_info info) {
   napi_value jsthis;
   NAPI_GET_ARGS(0, env, info, argc, NULL, jsthis);
   GroupSigner* obj;
-  NAPI_CALL(napi_unwrap(env, jsthis, (void**)(&obj)));
+  GS_UNWRAP(env, jsthis, obj);
 
   char buf[4096];
   int out_len = sizeof(buf);
@@ -225,7 +359,7 @@ napi_value GetGroupPrivKey(napi_env env, napi_callback_info info) {
   napi_value jsthis;
   NAPI_GET_ARGS(0, env, info, argc, NULL, jsthis);
   GroupSigner* obj;
-  NAPI_CALL(napi_unwrap(env, jsthis, (void**)(&obj)));
+  GS_UNWRAP(env, jsthis, obj);
 
   char buf[4096];
   int out_len = sizeof(buf);
@@ -243,7 +377,7 @@ napi_value SetGroupPubKey(napi_env env, napi_callback_info info) {
   napi_value jsthis;
   NAPI_GET_ARGS(1, env, info, argc, args, jsthis);
   GroupSigner* obj;
-  NAPI_CALL(napi_unwrap(env, jsthis, (void**)(&obj)));
+  GS_UNWRAP(env, jsthis, obj);
 
   size_t len = 0;
   char* data = NULL;
@@ -254,13 +388,50 @@ napi_value SetGroupPubKey(napi_env env, napi_callback_info info) {
   return getUndefined(env);
 }
 
+napi_value SetPreparedGroupPubKey(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[1];
+  napi_value jsthis;
+  NAPI_GET_ARGS(1, env, info, argc, args, jsthis);
+  GroupSigner* obj;
+  GS_UNWRAP(env, jsthis, obj);
+
+  size_t len = 0;
+  char* data = NULL;
+  GS_GET_DATA(data, env, args[0], &len);
+
+  GS_CALL(GS_loadPreparedGroupPubKey(obj->state, data, len));
+
+  return getUndefined(env);
+}
+
+// Writes the prepared group public key to the Uint8Array argument, which
+// lib/native.js allocates in a SharedArrayBuffer
+napi_value ExportPreparedGroupPubKey(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[1];
+  napi_value jsthis;
+  NAPI_GET_ARGS(1, env, info, argc, args, jsthis);
+  GroupSigner* obj;
+  GS_UNWRAP(env, jsthis, obj);
+
+  size_t len = 0;
+  char* data = NULL;
+  GS_GET_DATA(data, env, args[0], &len);
+
+  int out_len = len;
+  GS_CALL(GS_exportPreparedGroupPubKey(obj->state, data, &out_len));
+
+  return getUndefined(env);
+}
+
 napi_value SetGroupPrivKey(napi_env env, napi_callback_info info) {
   size_t argc = 1;
   napi_value args[1];
   napi_value jsthis;
   NAPI_GET_ARGS(1, env, info, argc, args, jsthis);
   GroupSigner* obj;
-  NAPI_CALL(napi_unwrap(env, jsthis, (void**)(&obj)));
+  GS_UNWRAP(env, jsthis, obj);
 
   size_t len = 0;
   char* data = NULL;
@@ -277,7 +448,7 @@ napi_value ProcessJoin(napi_env env, napi_callback_info info) {
   napi_value jsthis;
   NAPI_GET_ARGS(2, env, info, argc, args, jsthis);
   GroupSigner* obj;
-  NAPI_CALL(napi_unwrap(env, jsthis, (void**)(&obj)));
+  GS_UNWRAP(env, jsthis, obj);
 
   size_t len_join = 0;
   char* join = NULL;
@@ -297,13 +468,177 @@ napi_value ProcessJoin(napi_env env, napi_callback_info info) {
   return out_buf;
 }
 
+napi_value Preissue(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[1];
+  napi_value jsthis;
+  NAPI_GET_ARGS(1, env, info, argc, args, jsthis);
+  GroupSigner* obj;
+  GS_UNWRAP(env, jsthis, obj);
+
+  int32_t count;
+  if (napi_get_value_int32(env, args[0], &count) != napi_ok || count < 0) {
+    NAPI_CALL(napi_throw_error(env, NULL, "count must be a non-negative integer"));
+    return NULL;
+  }
+  GS_CALL(GS_preissue(obj->state, count));
+
+  return getUndefined(env);
+}
+
+napi_value SetWireFormat(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[1];
+  napi_value jsthis;
+  NAPI_GET_ARGS(1, env, info, argc, args, jsthis);
+  GroupSigner* obj;
+  GS_UNWRAP(env, jsthis, obj);
+
+  int32_t version;
+  if (napi_get_value_int32(env, args[0], &version) != napi_ok) {
+    NAPI_CALL(napi_throw_error(env, NULL, "version must be an integer"));
+    return NULL;
+  }
+  GS_CALL(GS_setWireFormat(obj->state, version));
+
+  return getUndefined(env);
+}
+
+// Wipes and frees the state before the instance is garbage collected
+napi_value Destroy(napi_env env, napi_callback_info info) {
+  size_t argc = 0;
+  napi_value jsthis;
+  NAPI_GET_ARGS(0, env, info, argc, NULL, jsthis);
+  GroupSigner* obj;
+  NAPI_CALL(napi_unwrap(env, jsthis, (void**)(&obj)));
+  if (obj->pending != NULL || obj->running > 0) {
+    NAPI_CALL(napi_throw_error(env, NULL, "GroupSigner is busy"));
+    return NULL;
+  }
+
+  if (obj->state != NULL) {
+    GS_setRevocationList(obj->state, NULL);
+    memset(obj->state, 0, GS_getStateSize());
+    free(obj->state);
+    obj->state = NULL;
+  }
+  if (obj->rng != NULL) {
+    memset(obj->rng, 0, GS_getRNGSize());
+    free(obj->rng);
+    obj->rng = NULL;
+  }
+  return getUndefined(env);
+}
+
+napi_value GetPreissueCount(napi_env env, napi_callback_info info) {
+  size_t argc = 0;
+  napi_value jsthis;
+  NAPI_GET_ARGS(0, env, info, argc, NULL, jsthis);
+  GroupSigner* obj;
+  GS_UNWRAP(env, jsthis, obj);
+
+  napi_value result;
+  NAPI_CALL(napi_create_int32(env, GS_getPreissueCount(obj->state), &result));
+  return result;
+}
+
+napi_value ProcessJoinBatch(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value args[2];
+  napi_value jsthis;
+  NAPI_GET_ARGS(2, env, info, argc, args, jsthis);
+  GroupSigner* obj;
+  GS_UNWRAP(env, jsthis, obj);
+
+  uint32_t count = 0;
+  for (int k = 0; k < 2; ++k) {
+    bool is_array;
+    uint32_t len;
+    NAPI_CALL(napi_is_array(env, args[k], &is_array));
+    if (!is_array) {
+      NAPI_CALL(napi_throw_error(env, NULL, "input data must be arrays of uint8array"));
+      return NULL;
+    }
+    NAPI_CALL(napi_get_array_length(env, args[k], &len));
+    if (k > 0 && len != count) {
+      NAPI_CALL(napi_throw_error(env, NULL, "input arrays must have the same length"));
+      return NULL;
+    }
+    count = len;
+  }
+
+  // data and lens hold join messages, challenges and outputs (count each),
+  // lens is followed by the per-message results. Each output gets 1024 bytes.
+  char** data = (char**) malloc((3 * count + 1) * sizeof(char*));
+  int* lens = (int*) malloc((4 * count + 1) * sizeof(int));
+  char* bufs = (char*) malloc(1024 * count + 1);
+  int* results = &lens[3 * count];
+  if (!data || !lens || !bufs) {
+    free(data);
+    free(lens);
+    free(bufs);
+    NAPI_CALL(napi_throw_error(env, NULL, "out of memory"));
+    return NULL;
+  }
+
+  for (uint32_t k = 0; k < 2; ++k) {
+    for (uint32_t i = 0; i < count; ++i) {
+      napi_value elem;
+      size_t len = 0;
+      NAPI_CALL(napi_get_element(env, args[k], i, &elem));
+      data[k * count + i] = getData(env, elem, &len);
+      lens[k * count + i] = len;
+      if (data[k * count + i] == NULL) {
+        free(data);
+        free(lens);
+        free(bufs);
+        NAPI_CALL(napi_throw_error(env, NULL, "input data must be uint8array"));
+        return NULL;
+      }
+    }
+  }
+  for (uint32_t i = 0; i < count; ++i) {
+    data[2 * count + i] = &bufs[1024 * i];
+    lens[2 * count + i] = 1024;
+  }
+
+  int retcode = GS_processJoinBatch(obj->state, count,
+    &data[0], &lens[0],
+    &data[count], &lens[count],
+    &data[2 * count], &lens[2 * count],
+    results);
+
+  // Join responses, or null for the messages that could not be processed
+  napi_value out = NULL;
+  if (retcode == GS_success() || retcode == GS_failure()) {
+    NAPI_CALL(napi_create_array_with_length(env, count, &out));
+    for (uint32_t i = 0; i < count; ++i) {
+      napi_value elem;
+      if (results[i] == GS_success()) {
+        NAPI_CALL(napi_create_buffer_copy(
+             env, lens[2 * count + i], data[2 * count + i], NULL, &elem));
+      } else {
+        NAPI_CALL(napi_get_null(env, &elem));
+      }
+      NAPI_CALL(napi_set_element(env, out, i, elem));
+    }
+  } else {
+    NAPI_CALL(napi_throw_error(env, NULL, GS_error(retcode)));
+  }
+
+  free(data);
+  free(lens);
+  free(bufs);
+  return out;
+}
+
 napi_value Sign(napi_env env, napi_callback_info info) {
   size_t argc = 2;
   napi_value args[2];
   napi_value jsthis;
   NAPI_GET_ARGS(2, env, info, argc, args, jsthis);
   GroupSigner* obj;
-  NAPI_CALL(napi_unwrap(env, jsthis, (void**)(&obj)));
+  GS_UNWRAP(env, jsthis, obj);
 
   size_t len_msg = 0;
   char* msg = NULL;
@@ -323,13 +658,78 @@ napi_value Sign(napi_env env, napi_callback_info info) {
   return out_buf;
 }
 
+napi_value Presign(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value args[2];
+  napi_value jsthis;
+  NAPI_GET_ARGS(2, env, info, argc, args, jsthis);
+  GroupSigner* obj;
+  GS_UNWRAP(env, jsthis, obj);
+
+  size_t len_bsn = 0;
+  char* bsn = NULL;
+  GS_GET_DATA(bsn, env, args[0], &len_bsn);
+
+  int32_t count;
+  if (napi_get_value_int32(env, args[1], &count) != napi_ok || count < 0) {
+    NAPI_CALL(napi_throw_error(env, NULL, "count must be a non-negative integer"));
+    return NULL;
+  }
+  GS_CALL(GS_presign(obj->state, bsn, len_bsn, count));
+
+  return getUndefined(env);
+}
+
+napi_value OnlineSign(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value args[2];
+  napi_value jsthis;
+  NAPI_GET_ARGS(2, env, info, argc, args, jsthis);
+  GroupSigner* obj;
+  GS_UNWRAP(env, jsthis, obj);
+
+  size_t len_msg = 0;
+  char* msg = NULL;
+  GS_GET_DATA(msg, env, args[0], &len_msg);
+
+  size_t len_bsn = 0;
+  char* bsn = NULL;
+  GS_GET_DATA(bsn, env, args[1], &len_bsn);
+
+  char buf[1024];
+  int out_len = sizeof(buf);
+  GS_CALL(GS_onlineSign(obj->state, msg, len_msg, bsn, len_bsn, buf, &out_len));
+
+  napi_value out_buf;
+  NAPI_CALL(napi_create_buffer_copy(
+       env, out_len, buf, NULL, &out_buf));
+  return out_buf;
+}
+
+napi_value GetPresignCount(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[1];
+  napi_value jsthis;
+  NAPI_GET_ARGS(1, env, info, argc, args, jsthis);
+  GroupSigner* obj;
+  GS_UNWRAP(env, jsthis, obj);
+
+  size_t len_bsn = 0;
+  char* bsn = NULL;
+  GS_GET_DATA(bsn, env, args[0], &len_bsn);
+
+  napi_value result;
+  NAPI_CALL(napi_create_int32(env, GS_getPresignCount(obj->state, bsn, len_bsn), &result));
+  return result;
+}
+
 napi_value Verify(napi_env env, napi_callback_info info) {
   size_t argc = 3;
   napi_value args[3];
   napi_value jsthis;
   NAPI_GET_ARGS(3, env, info, argc, args, jsthis);
   GroupSigner* obj;
-  NAPI_CALL(napi_unwrap(env, jsthis, (void**)(&obj)));
+  GS_UNWRAP(env, jsthis, obj);
 
   size_t len_msg = 0;
   char* msg = NULL;
@@ -354,6 +754,117 @@ napi_value Verify(napi_env env, napi_callback_info info) {
   return NULL;
 }
 
+// Returns null if the signature is valid, otherwise the stage that
+// rejected it ("encoding", "proof", "revoked" or "pairing"; see
+// GS_verifyWithReason)
+napi_value GetRejectReason(napi_env env, napi_callback_info info) {
+  size_t argc = 3;
+  napi_value args[3];
+  napi_value jsthis;
+  NAPI_GET_ARGS(3, env, info, argc, args, jsthis);
+  GroupSigner* obj;
+  GS_UNWRAP(env, jsthis, obj);
+
+  size_t len_msg = 0;
+  char* msg = NULL;
+  GS_GET_DATA(msg, env, args[0], &len_msg);
+
+  size_t len_bsn = 0;
+  char* bsn = NULL;
+  GS_GET_DATA(bsn, env, args[1], &len_bsn);
+
+  size_t len_sig = 0;
+  char* sig = NULL;
+  GS_GET_DATA(sig, env, args[2], &len_sig);
+
+  int reason;
+  GS_CALL(GS_verifyWithReason(obj->state, msg, len_msg, bsn, len_bsn, sig, len_sig, &reason));
+
+  napi_value out;
+  if (reason == GS_REJECT_NONE) {
+    NAPI_CALL(napi_get_null(env, &out));
+  } else {
+    NAPI_CALL(napi_create_string_utf8(env, GS_getRejectReasonName(reason), NAPI_AUTO_LENGTH, &out));
+  }
+  return out;
+}
+
+// Arguments are three arrays of Uint8Array (messages, basenames, signatures)
+// of the same length. Returns an array of booleans, one per signature.
+napi_value VerifyBatch(napi_env env, napi_callback_info info) {
+  size_t argc = 3;
+  napi_value args[3];
+  napi_value jsthis;
+  NAPI_GET_ARGS(3, env, info, argc, args, jsthis);
+  GroupSigner* obj;
+  GS_UNWRAP(env, jsthis, obj);
+
+  uint32_t count = 0;
+  for (int k = 0; k < 3; ++k) {
+    bool is_array;
+    uint32_t len;
+    NAPI_CALL(napi_is_array(env, args[k], &is_array));
+    if (!is_array) {
+      NAPI_CALL(napi_throw_error(env, NULL, "input data must be arrays of uint8array"));
+      return NULL;
+    }
+    NAPI_CALL(napi_get_array_length(env, args[k], &len));
+    if (k > 0 && len != count) {
+      NAPI_CALL(napi_throw_error(env, NULL, "input arrays must have the same length"));
+      return NULL;
+    }
+    count = len;
+  }
+
+  // data and lens hold messages, basenames and signatures (count each),
+  // lens is followed by the per-signature results.
+  char** data = (char**) malloc((3 * count + 1) * sizeof(char*));
+  int* lens = (int*) malloc((4 * count + 1) * sizeof(int));
+  int* results = &lens[3 * count];
+  if (!data || !lens) {
+    free(data);
+    free(lens);
+    NAPI_CALL(napi_throw_error(env, NULL, "out of memory"));
+    return NULL;
+  }
+
+  for (uint32_t k = 0; k < 3; ++k) {
+    for (uint32_t i = 0; i < count; ++i) {
+      napi_value elem;
+      size_t len = 0;
+      NAPI_CALL(napi_get_element(env, args[k], i, &elem));
+      data[k * count + i] = getData(env, elem, &len);
+      lens[k * count + i] = len;
+      if (data[k * count + i] == NULL) {
+        free(data);
+        free(lens);
+        NAPI_CALL(napi_throw_error(env, NULL, "input data must be uint8array"));
+        return NULL;
+      }
+    }
+  }
+
+  int retcode = GS_verifyBatch(obj->state, count,
+    &data[0], &lens[0],
+    &data[count], &lens[count],
+    &data[2 * count], &lens[2 * count],
+    results);
+
+  napi_value out = NULL;
+  if (retcode == GS_success() || retcode == GS_failure()) {
+    NAPI_CALL(napi_create_array_with_length(env, count, &out));
+    for (uint32_t i = 0; i < count; ++i) {
+      NAPI_CALL(napi_set_element(env, out, i, getBoolean(env, results[i] == GS_success())));
+    }
+  } else {
+    NAPI_CALL(napi_throw_error(env, NULL, GS_error(retcode)));
+  }
+
+  free(data);
+  free(lens);
+  return out;
+}
+
 napi_value GetSignatureTag(napi_env env, napi_callback_info info) {
   size_t argc = 1;
   napi_value args[1];
@@ -379,7 +890,7 @@ napi_value GetUserCredentials(napi_env env, napi_callback_info info) {
   napi_value jsthis;
   NAPI_GET_ARGS(0, env, info, argc, NULL, jsthis);
   GroupSigner* obj;
-  NAPI_CALL(napi_unwrap(env, jsthis, (void**)(&obj)));
+  GS_UNWRAP(env, jsthis, obj);
 
   char buf[1024];
   int out_len = sizeof(buf);
@@ -397,7 +908,7 @@ napi_value SetUserCredentials(napi_env env, napi_callback_info info) {
   napi_value jsthis;
   NAPI_GET_ARGS(1, env, info, argc, args, jsthis);
   GroupSigner* obj;
-  NAPI_CALL(napi_unwrap(env, jsthis, (void**)(&obj)));
+  GS_UNWRAP(env, jsthis, obj);
 
   size_t len = 0;
   char* data = NULL;
@@ -415,7 +926,7 @@ napi_value StartJoin(napi_env env, napi_callback_info info) {
   NAPI_GET_ARGS(1, env, info, argc, args, jsthis);
 
   GroupSigner* obj;
-  NAPI_CALL(napi_unwrap(env, jsthis, (void**)(&obj)));
+  GS_UNWRAP(env, jsthis, obj);
 
   size_t len = 0;
   char* data = NULL;
@@ -471,40 +982,1136 @@ napi_value FinishJoin(napi_env env, napi_callback_info info) {
   return out_buf;
 }
 
-napi_value Init(napi_env env, napi_value exports) {
-  napi_value version, curve;
-  NAPI_CALL(napi_create_string_utf8(env, GS_version(), NAPI_AUTO_LENGTH, &version));
-  NAPI_CALL(napi_create_string_utf8(env, GS_curve(), NAPI_AUTO_LENGTH, &curve));
+napi_value SetBasenameCacheCapacity(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[1];
+  napi_value jsthis;
+  NAPI_GET_ARGS(1, env, info, argc, args, jsthis);
 
-  napi_property_descriptor properties[] = {
-    DECLARE_NAPI_METHOD("seed", Seed),
-    DECLARE_NAPI_METHOD("setupGroup", SetupGroup),
-    DECLARE_NAPI_METHOD("getGroupPubKey", GetGroupPubKey),
-    DECLARE_NAPI_METHOD("getGroupPrivKey", GetGroupPrivKey),
-    DECLARE_NAPI_METHOD("setGroupPubKey", SetGroupPubKey),
-    DECLARE_NAPI_METHOD("setGroupPrivKey", SetGroupPrivKey),
-    DECLARE_NAPI_METHOD("processJoin", ProcessJoin),
-    DECLARE_NAPI_METHOD("sign", Sign),
-    DECLARE_NAPI_METHOD("verify", Verify),
-    DECLARE_NAPI_METHOD("getSignatureTag", GetSignatureTag),
-    DECLARE_NAPI_METHOD("getUserCredentials", GetUserCredentials),
-    DECLARE_NAPI_METHOD("setUserCredentials", SetUserCredentials),
-    DECLARE_NAPI_METHOD("startJoin", StartJoin),
-    DECLARE_NAPI_METHOD("finishJoin", FinishJoin),
+  int32_t capacity;
+  if (napi_get_value_int32(env, args[0], &capacity) != napi_ok || capacity < 0) {
+    NAPI_CALL(napi_throw_error(env, NULL, "capacity must be a non-negative integer"));
+    return NULL;
+  }
+  GS_CALL(GS_setBasenameCacheCapacity(capacity));
 
-    DECLARE_NAPI_STATIC("_version", version),
-    DECLARE_NAPI_STATIC("_curve", curve)
-  };
+  return getUndefined(env);
+}
 
-  napi_value cons;
-  NAPI_CALL(napi_define_class(env, "GroupSigner", NAPI_AUTO_LENGTH, New, NULL, sizeof(properties)/sizeof(napi_property_descriptor), properties, &cons));
-  NAPI_CALL(napi_create_reference(env, cons, 1, &constructor));
-  NAPI_CALL(napi_set_named_property(env, exports, "GroupSigner", cons));
+// Makes a revocation list (see GS_createRevocationList) of an array of
+// user private keys (gsk, as returned by startJoin). Returns an error
+// message, or NULL on success
+const char* createRevocationList(napi_env env, napi_value value, void** list) {
+  bool is_array;
+  uint32_t count;
+  NAPI_CALL(napi_is_array(env, value, &is_array));
+  if (!is_array) {
+    return "input data must be arrays of uint8array";
+  }
+  NAPI_CALL(napi_get_array_length(env, value, &count));
 
-  return exports;
+  size_t size = GS_getMaxSize(GS_SIZE_GSK);
+  char* gsks = (char*) malloc(count * size + 1);
+  if (!gsks) {
+    return "out of memory";
+  }
+  for (uint32_t i = 0; i < count; ++i) {
+    napi_value elem;
+    size_t len = 0;
+    NAPI_CALL(napi_get_element(env, value, i, &elem));
+    char* gsk = getData(env, elem, &len);
+    if (gsk == NULL || len != size) {
+      memset(gsks, 0, count * size);
+      free(gsks);
+      return gsk == NULL ? "input data must be uint8array" : "invalid revocation list";
+    }
+    memcpy(&gsks[i * size], gsk, size);
+  }
+
+  int retcode = GS_createRevocationList(gsks, count * size, list);
+  memset(gsks, 0, count * size);
+  free(gsks);
+  return retcode == GS_success() ? NULL : GS_error(retcode);
 }
 
-NAPI_MODULE(NODE_GYP_MODULE_NAME, Init)
+// Takes an array of user private keys, whose signatures the instance
+// rejects from then on
+napi_value SetRevocationList(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[1];
+  napi_value jsthis;
+  NAPI_GET_ARGS(1, env, info, argc, args, jsthis);
+  GroupSigner* obj;
+  GS_UNWRAP(env, jsthis, obj);
+
+  void* list;
+  const char* error = createRevocationList(env, args[0], &list);
+  if (error != NULL) {
+    NAPI_CALL(napi_throw_error(env, NULL, error));
+    return NULL;
+  }
+  GS_setRevocationList(obj->state, list);
+  return getUndefined(env);
+}
+
+// Returns whether the known answer tests of GS_selfTest pass
+napi_value SelfTest(napi_env env, napi_callback_info info) {
+  size_t argc = 0;
+  napi_value jsthis;
+  NAPI_GET_ARGS(0, env, info, argc, NULL, jsthis);
+  return getBoolean(env, GS_selfTest() == GS_success());
+}
+
+napi_value GetRevocationListSize(napi_env env, napi_callback_info info) {
+  size_t argc = 0;
+  napi_value jsthis;
+  NAPI_GET_ARGS(0, env, info, argc, NULL, jsthis);
+  GroupSigner* obj;
+  GS_UNWRAP(env, jsthis, obj);
+
+  napi_value result;
+  NAPI_CALL(napi_create_int32(env, GS_getRevocationListCount(GS_getRevocationList(obj->state)), &result));
+  return result;
+}
+
+napi_value GetBasenameCacheStats(napi_env env, napi_callback_info info) {
+  size_t argc = 0;
+  napi_value jsthis;
+  NAPI_GET_ARGS(0, env, info, argc, NULL, jsthis);
+
+  int capacity, size;
+  unsigned long long hits, misses;
+  GS_getBasenameCacheStats(&capacity, &size, &hits, &misses);
+
+  napi_value out_obj, value;
+  NAPI_CALL(napi_create_object(env, &out_obj));
+  NAPI_CALL(napi_create_int32(env, capacity, &value));
+  NAPI_CALL(napi_set_named_property(env, out_obj, "capacity", value));
+  NAPI_CALL(napi_create_int32(env, size, &value));
+  NAPI_CALL(napi_set_named_property(env, out_obj, "size", value));
+  NAPI_CALL(napi_create_double(env, (double)hits, &value));
+  NAPI_CALL(napi_set_named_property(env, out_obj, "hits", value));
+  NAPI_CALL(napi_create_double(env, (double)misses, &value));
+  NAPI_CALL(napi_set_named_property(env, out_obj, "misses", value));
+  return out_obj;
+}
+
+// Returns null in builds without hot-path statistics (see GS_getStats)
+napi_value GetStats(napi_env env, napi_callback_info info) {
+  size_t argc = 0;
+  napi_value jsthis;
+  NAPI_GET_ARGS(0, env, info, argc, NULL, jsthis);
+
+  int count = GS_getStatsCount();
+  if (count == 0) {
+    napi_value null;
+    NAPI_CALL(napi_get_null(env, &null));
+    return null;
+  }
+
+  napi_value out_obj, stages, value;
+  NAPI_CALL(napi_create_object(env, &out_obj));
+  NAPI_CALL(napi_create_string_utf8(env, GS_getStatsClock(), NAPI_AUTO_LENGTH, &value));
+  NAPI_CALL(napi_set_named_property(env, out_obj, "clock", value));
+  NAPI_CALL(napi_create_object(env, &stages));
+  NAPI_CALL(napi_set_named_property(env, out_obj, "stages", stages));
+
+  for (int stat = 0; stat < count; ++stat) {
+    unsigned long long calls, ticks, histogram[GS_STATS_BUCKETS];
+    GS_CALL(GS_getStats(stat, &calls, &ticks, histogram));
+
+    napi_value stage, buckets;
+    NAPI_CALL(napi_create_object(env, &stage));
+    NAPI_CALL(napi_create_double(env, (double)calls, &value));
+    NAPI_CALL(napi_set_named_property(env, stage, "calls", value));
+    NAPI_CALL(napi_create_double(env, (double)ticks, &value));
+    NAPI_CALL(napi_set_named_property(env, stage, "ticks", value));
+    NAPI_CALL(napi_create_array_with_length(env, GS_STATS_BUCKETS, &buckets));
+    for (int i = 0; i < GS_STATS_BUCKETS; ++i) {
+      NAPI_CALL(napi_create_double(env, (double)histogram[i], &value));
+      NAPI_CALL(napi_set_element(env, buckets, i, value));
+    }
+    NAPI_CALL(napi_set_named_property(env, stage, "histogram", buckets));
+    NAPI_CALL(napi_set_named_property(env, stages, GS_getStatName(stat), stage));
+  }
+  return out_obj;
+}
+
+napi_value ResetStats(napi_env env, napi_callback_info info) {
+  size_t argc = 0;
+  napi_value jsthis;
+  NAPI_GET_ARGS(0, env, info, argc, NULL, jsthis);
+
+  GS_resetStats();
+  return getUndefined(env);
+}
+
+// Asynchronous operations (signAsync, verifyAsync and processJoinAsync)
+// run on the libuv threadpool and return a Promise. Inputs are copied, so
+// they can be modified as soon as the call returns.
+//
+// Signing and processing join messages update the state (at least its
+// random number generator), so an instance runs one of them at a time:
+// they are queued and run in order. Verification only reads the prepared
+// group public key, so verifyAsync calls run in parallel with everything
+// else, each with its own generator (see GS_verify_r); before the instance
+// is seeded they are queued too. Synchronous calls and destroy() throw
+// while any asynchronous call is pending. Different instances run in
+// parallel.
+enum AsyncOp {
+  ASYNC_SIGN,
+  ASYNC_VERIFY,
+  ASYNC_PROCESS_JOIN
+};
+
+struct AsyncCall {
+  napi_async_work work;
+  napi_deferred deferred;
+  napi_ref jsthis; // keeps the instance alive until the call completes
+  GroupSigner* obj;
+  AddonData* addon;
+  struct AsyncCall* next;
+
+  enum AsyncOp op;
+  const void* key; // for calls outside the queue
+  const void* revoked;
+  void* rng;
+  char* in[3]; // copies of the arguments, in a single block
+  int in_len[3];
+  char out[1024];
+  int out_len;
+  int retcode;
+};
+
+void ExecuteAsyncCall(napi_env env, void* data) {
+  struct AsyncCall* call = (struct AsyncCall*)data;
+  AddonData* addon = call->addon;
+  uv_mutex_lock(&addon->lock);
+  if (addon->closing) {
+    uv_mutex_unlock(&addon->lock);
+    return;
+  }
+  addon->executing++;
+  uv_mutex_unlock(&addon->lock);
+
+  void* state = call->obj->state;
+  switch (call->op) {
+    case ASYNC_SIGN:
+      call->retcode = GS_sign(state, call->in[0], call->in_len[0], call->in[1], call->in_len[1], call->out, &call->out_len);
+      break;
+    case ASYNC_VERIFY:
+      if (call->rng != NULL) {
+        call->retcode = GS_verify_r(call->key, call->revoked, call->rng, call->in[0], call->in_len[0], call->in[1], call->in_len[1], call->in[2], call->in_len[2]);
+      } else {
+        call->retcode = GS_verify(state, call->in[0], call->in_len[0], call->in[1], call->in_len[1], call->in[2], call->in_len[2]);
+      }
+      break;
+    case ASYNC_PROCESS_JOIN:
+      call->retcode = GS_processJoin(state, call->in[0], call->in_len[0], call->in[1], call->in_len[1], call->out, &call->out_len);
+      break;
+  }
+
+  uv_mutex_lock(&addon->lock);
+  if (--addon->executing == 0) {
+    uv_cond_signal(&addon->idle);
+  }
+  uv_mutex_unlock(&addon->lock);
+}
+
+void FreeAsyncCall(struct AsyncCall* call) {
+  free(call->in[0]);
+  if (call->rng != NULL) {
+    memset(call->rng, 0, GS_getRNGSize());
+    free(call->rng);
+  }
+  free(call);
+}
+
+void CompleteAsyncCall(napi_env env, napi_status status, void* data) {
+  struct AsyncCall* call = (struct AsyncCall*)data;
+  GroupSigner* obj = call->obj;
+
+  // The environment (and maybe the instance) is gone, and so is anyone
+  // waiting for the promise
+  if (call->addon->closing) {
+    FreeAsyncCall(call);
+    return;
+  }
+
+  if (call->rng != NULL) {
+    obj->running--;
+  } else {
+    // Start the next call on the instance before settling this one
+    obj->pending = call->next;
+    if (obj->pending == NULL) {
+      obj->pendingTail = NULL;
+    } else {
+      NAPI_CALL(napi_queue_async_work(env, obj->pending->work));
+    }
+  }
+
+  napi_value result;
+  if (call->op == ASYNC_VERIFY && (call->retcode == GS_success() || call->retcode == GS_failure())) {
+    NAPI_CALL(napi_get_boolean(env, call->retcode == GS_success(), &result));
+    NAPI_CALL(napi_resolve_deferred(env, call->deferred, result));
+  } else if (call->retcode == GS_success()) {
+    NAPI_CALL(napi_create_buffer_copy(env, call->out_len, call->out, NULL, &result));
+    NAPI_CALL(napi_resolve_deferred(env, call->deferred, result));
+  } else {
+    napi_value message;
+    NAPI_CALL(napi_create_string_utf8(env, GS_error(call->retcode), NAPI_AUTO_LENGTH, &message));
+    NAPI_CALL(napi_create_error(env, NULL, message, &result));
+    NAPI_CALL(napi_reject_deferred(env, call->deferred, result));
+  }
+
+  NAPI_CALL(napi_delete_async_work(env, call->work));
+  NAPI_CALL(napi_delete_reference(env, call->jsthis));
+  FreeAsyncCall(call);
+}
+
+// Takes nargs Uint8Array arguments and queues op on the instance
+napi_value QueueAsyncCall(napi_env env, napi_callback_info info, enum AsyncOp op, size_t nargs) {
+  size_t argc = 3;
+  napi_value args[3];
+  napi_value jsthis;
+  NAPI_CALL(napi_get_cb_info(env, info, &argc, args, &jsthis, NULL));
+  if (argc != nargs) {
+    char message[32];
+    snprintf(message, sizeof(message), "expected %d arguments", (int)nargs);
+    NAPI_CALL(napi_throw_error(env, NULL, message));
+    return NULL;
+  }
+  GroupSigner* obj;
+  NAPI_CALL(napi_unwrap(env, jsthis, (void**)(&obj)));
+  if (obj->state == NULL) {
+    NAPI_CALL(napi_throw_error(env, NULL, "GroupSigner has been destroyed"));
+    return NULL;
+  }
+
+  char* data[3];
+  size_t len[3];
+  size_t total = 0;
+  for (size_t i = 0; i < nargs; ++i) {
+    GS_GET_DATA(data[i], env, args[i], &len[i]);
+    total += len[i];
+  }
+
+  struct AsyncCall* call = (struct AsyncCall*)malloc(sizeof(struct AsyncCall));
+  char* in = (char*)malloc(total > 0 ? total : 1);
+  if (call == NULL || in == NULL) {
+    free(call);
+    free(in);
+    NAPI_CALL(napi_throw_error(env, NULL, "out of memory"));
+    return NULL;
+  }
+  for (size_t i = 0; i < nargs; ++i) {
+    memcpy(in, data[i], len[i]);
+    call->in[i] = in;
+    call->in_len[i] = len[i];
+    in += len[i];
+  }
+  call->obj = obj;
+  NAPI_CALL(napi_get_instance_data(env, (void**)(&call->addon)));
+  call->op = op;
+  call->next = NULL;
+  call->out_len = sizeof(call->out);
+  call->key = NULL;
+  call->revoked = NULL;
+  call->rng = NULL;
+  if (op == ASYNC_VERIFY && obj->rng != NULL) {
+    call->key = GS_getPreparedGroupPubKey(obj->state);
+    // Neither can change until the call completes, see GS_UNWRAP
+    call->revoked = GS_getRevocationList(obj->state);
+    if (call->key != NULL) {
+      call->rng = malloc(GS_getRNGSize());
+    }
+    if (call->rng != NULL) {
+      GS_forkRNG(obj->rng, call->rng);
+    }
+  }
+
+  napi_value promise, name;
+  NAPI_CALL(napi_create_promise(env, &call->deferred, &promise));
+  NAPI_CALL(napi_create_reference(env, jsthis, 1, &call->jsthis));
+  NAPI_CALL(napi_create_string_utf8(env, "GroupSigner", NAPI_AUTO_LENGTH, &name));
+  NAPI_CALL(napi_create_async_work(env, NULL, name, ExecuteAsyncCall, CompleteAsyncCall, call, &call->work));
+
+  if (call->rng != NULL) {
+    obj->running++;
+    NAPI_CALL(napi_queue_async_work(env, call->work));
+  } else if (obj->pending == NULL) {
+    obj->pending = call;
+    obj->pendingTail = call;
+    NAPI_CALL(napi_queue_async_work(env, call->work));
+  } else {
+    obj->pendingTail->next = call;
+    obj->pendingTail = call;
+  }
+  return promise;
+}
+
+napi_value SignAsync(napi_env env, napi_callback_info info) {
+  return QueueAsyncCall(env, info, ASYNC_SIGN, 2);
+}
+
+napi_value VerifyAsync(napi_env env, napi_callback_info info) {
+  return QueueAsyncCall(env, info, ASYNC_VERIFY, 3);
+}
+
+napi_value ProcessJoinAsync(napi_env env, napi_callback_info info) {
+  return QueueAsyncCall(env, info, ASYNC_PROCESS_JOIN, 2);
+}
+
+// Key registries hold the prepared group public keys of many groups, for
+// verifiers that serve all of them: each key takes GS_getPreparedKeySize()
+// bytes instead of a whole state, and all of them share one generator.
+// Keys are addressed by ids made of their slot and a generation, so that
+// the id of a removed key is not valid for the key that takes its slot.
+// Each key can have its own revocation list.
+#define KEY_REGISTRY_SLOT_BITS 16
+#define KEY_REGISTRY_MAX_KEYS (1 << KEY_REGISTRY_SLOT_BITS)
+#define KEY_REGISTRY_GENERATIONS (1 << (31 - KEY_REGISTRY_SLOT_BITS))
+
+typedef struct {
+  napi_env env_;
+  void* rng; // NULL until seeded
+  void** keys; // by slot, NULL if free
+  void** revoked; // revocation lists by slot, NULL if none
+  int* generations; // by slot
+  int slots;
+  int count;
+  int closed;
+} KeyRegistry;
+
+// Native memory held by the registry, also reported to the garbage collector
+size_t keyRegistryMemory(KeyRegistry* obj) {
+  return sizeof(KeyRegistry)
+    + (obj->rng != NULL ? GS_getRNGSize() : 0)
+    + obj->slots * (2 * sizeof(void*) + sizeof(int))
+    + obj->count * GS_getPreparedKeySize();
+}
+
+void closeKeyRegistry(KeyRegistry* obj) {
+  int64_t adjusted;
+  napi_adjust_external_memory(obj->env_, -(int64_t)keyRegistryMemory(obj), &adjusted);
+  for (int i = 0; i < obj->slots; ++i) {
+    free(obj->keys[i]);
+    GS_freeRevocationList(obj->revoked[i]);
+  }
+  free(obj->keys);
+  free(obj->revoked);
+  free(obj->generations);
+  if (obj->rng != NULL) {
+    memset(obj->rng, 0, GS_getRNGSize());
+    free(obj->rng);
+  }
+  obj->rng = NULL;
+  obj->keys = NULL;
+  obj->revoked = NULL;
+  obj->generations = NULL;
+  obj->slots = 0;
+  obj->count = 0;
+  obj->closed = 1;
+}
+
+void KeyRegistryDestructor(napi_env env, void* nativeObject, void* finalize_hint) {
+  closeKeyRegistry((KeyRegistry*) nativeObject);
+  free(nativeObject);
+}
+
+#define KEY_REGISTRY_UNWRAP(env, jsthis, obj) \
+do { \
+  NAPI_CALL(napi_unwrap(env, jsthis, (void**)(&obj))); \
+  if (obj->closed) { \
+    NAPI_CALL(napi_throw_error(env, NULL, "KeyRegistry has been closed")); \
+    return NULL; \
+  } \
+} while (0)
+
+// Prepared key with the given id, or NULL
+void* getRegisteredKey(KeyRegistry* obj, int64_t id) {
+  if (id < 0 || id >= (int64_t)KEY_REGISTRY_MAX_KEYS * KEY_REGISTRY_GENERATIONS) {
+    return NULL;
+  }
+  int slot = id & (KEY_REGISTRY_MAX_KEYS - 1);
+  int generation = id >> KEY_REGISTRY_SLOT_BITS;
+  if (slot >= obj->slots || obj->generations[slot] != generation) {
+    return NULL;
+  }
+  return obj->keys[slot];
+}
+
+napi_value NewKeyRegistry(napi_env env, napi_callback_info info) {
+  size_t argc = 0;
+  napi_value jsthis, target;
+  NAPI_GET_ARGS(0, env, info, argc, NULL, jsthis);
+  NAPI_CALL(napi_get_new_target(env, info, &target));
+  if (target == NULL) {
+    NAPI_CALL(napi_throw_error(env, NULL, "KeyRegistry must be called with new"));
+    return NULL;
+  }
+
+  KeyRegistry* obj = (KeyRegistry*) calloc(1, sizeof(KeyRegistry));
+  obj->env_ = env;
+  int64_t adjusted;
+  NAPI_CALL(napi_adjust_external_memory(env, keyRegistryMemory(obj), &adjusted));
+  NAPI_CALL(napi_wrap(env, jsthis, (void*)obj, KeyRegistryDestructor, NULL, NULL));
+  return jsthis;
+}
+
+napi_value KeyRegistrySeed(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[1];
+  napi_value jsthis;
+  NAPI_GET_ARGS(1, env, info, argc, args, jsthis);
+  KeyRegistry* obj;
+  KEY_REGISTRY_UNWRAP(env, jsthis, obj);
+
+  size_t len = 0;
+  char* data = NULL;
+  GS_GET_DATA(data, env, args[0], &len);
+
+  int64_t adjusted;
+  if (obj->rng == NULL) {
+    obj->rng = malloc(GS_getRNGSize());
+    if (obj->rng == NULL) {
+      NAPI_CALL(napi_throw_error(env, NULL, "out of memory"));
+      return NULL;
+    }
+    NAPI_CALL(napi_adjust_external_memory(env, GS_getRNGSize(), &adjusted));
+  }
+  int retcode = GS_seedRNG(obj->rng, data, len);
+  if (retcode != GS_success()) {
+    NAPI_CALL(napi_adjust_external_memory(env, -(int64_t)GS_getRNGSize(), &adjusted));
+    free(obj->rng);
+    obj->rng = NULL;
+    NAPI_CALL(napi_throw_error(env, NULL, GS_error(retcode)));
+    return NULL;
+  }
+  return getUndefined(env);
+}
+
+// Validates and prepares a group public key, and returns its id
+napi_value KeyRegistryAdd(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[1];
+  napi_value jsthis;
+  NAPI_GET_ARGS(1, env, info, argc, args, jsthis);
+  KeyRegistry* obj;
+  KEY_REGISTRY_UNWRAP(env, jsthis, obj);
+
+  size_t len = 0;
+  char* data = NULL;
+  GS_GET_DATA(data, env, args[0], &len);
+
+  int slot = 0;
+  while (slot < obj->slots && obj->keys[slot] != NULL) {
+    slot++;
+  }
+  int64_t adjusted;
+  if (slot == obj->slots) {
+    if (obj->slots == KEY_REGISTRY_MAX_KEYS) {
+      NAPI_CALL(napi_throw_error(env, NULL, "key registry full"));
+      return NULL;
+    }
+    int slots = obj->slots == 0 ? 16 : 2 * obj->slots;
+    void** keys = (void**) realloc(obj->keys, slots * sizeof(void*));
+    if (keys != NULL) {
+      obj->keys = keys;
+    }
+    void** revoked = (void**) realloc(obj->revoked, slots * sizeof(void*));
+    if (revoked != NULL) {
+      obj->revoked = revoked;
+    }
+    int* generations = (int*) realloc(obj->generations, slots * sizeof(int));
+    if (generations != NULL) {
+      obj->generations = generations;
+    }
+    if (keys == NULL || revoked == NULL || generations == NULL) {
+      NAPI_CALL(napi_throw_error(env, NULL, "out of memory"));
+      return NULL;
+    }
+    for (int i = obj->slots; i < slots; ++i) {
+      obj->keys[i] = NULL;
+      obj->revoked[i] = NULL;
+      obj->generations[i] = 0;
+    }
+    NAPI_CALL(napi_adjust_external_memory(env, (slots - obj->slots) * (2 * sizeof(void*) + sizeof(int)), &adjusted));
+    obj->slots = slots;
+  }
+
+  void* key = malloc(GS_getPreparedKeySize());
+  if (key == NULL) {
+    NAPI_CALL(napi_throw_error(env, NULL, "out of memory"));
+    return NULL;
+  }
+  int retcode = GS_prepareGroupPubKey(key, data, len);
+  if (retcode != GS_success()) {
+    free(key);
+    NAPI_CALL(napi_throw_error(env, NULL, GS_error(retcode)));
+    return NULL;
+  }
+  obj->keys[slot] = key;
+  obj->count++;
+  NAPI_CALL(napi_adjust_external_memory(env, GS_getPreparedKeySize(), &adjusted));
+
+  napi_value result;
+  NAPI_CALL(napi_create_int32(env, (obj->generations[slot] << KEY_REGISTRY_SLOT_BITS) | slot, &result));
+  return result;
+}
+
+int64_t getKeyId(napi_env env, napi_value value) {
+  double d;
+  if (napi_get_value_double(env, value, &d) != napi_ok || d != (double)(int64_t)d) {
+    return -1;
+  }
+  return (int64_t)d;
+}
+
+// Returns whether there was a key with the id
+napi_value KeyRegistryRemove(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[1];
+  napi_value jsthis;
+  NAPI_GET_ARGS(1, env, info, argc, args, jsthis);
+  KeyRegistry* obj;
+  KEY_REGISTRY_UNWRAP(env, jsthis, obj);
+
+  int64_t id = getKeyId(env, args[0]);
+  void* key = getRegisteredKey(obj, id);
+  if (key == NULL) {
+    return getBoolean(env, false);
+  }
+  int slot = id & (KEY_REGISTRY_MAX_KEYS - 1);
+  free(key);
+  GS_freeRevocationList(obj->revoked[slot]);
+  obj->keys[slot] = NULL;
+  obj->revoked[slot] = NULL;
+  obj->generations[slot] = (obj->generations[slot] + 1) % KEY_REGISTRY_GENERATIONS;
+  obj->count--;
+  int64_t adjusted;
+  NAPI_CALL(napi_adjust_external_memory(env, -(int64_t)GS_getPreparedKeySize(), &adjusted));
+  return getBoolean(env, true);
+}
+
+napi_value KeyRegistryVerify(napi_env env, napi_callback_info info) {
+  size_t argc = 4;
+  napi_value args[4];
+  napi_value jsthis;
+  NAPI_GET_ARGS(4, env, info, argc, args, jsthis);
+  KeyRegistry* obj;
+  KEY_REGISTRY_UNWRAP(env, jsthis, obj);
+
+  int64_t id = getKeyId(env, args[0]);
+  void* key = getRegisteredKey(obj, id);
+  if (key == NULL) {
+    NAPI_CALL(napi_throw_error(env, NULL, "unknown key id"));
+    return NULL;
+  }
+  if (obj->rng == NULL) {
+    NAPI_CALL(napi_throw_error(env, NULL, "not seeded"));
+    return NULL;
+  }
+
+  size_t len_msg = 0;
+  char* msg = NULL;
+  GS_GET_DATA(msg, env, args[1], &len_msg);
+
+  size_t len_bsn = 0;
+  char* bsn = NULL;
+  GS_GET_DATA(bsn, env, args[2], &len_bsn);
+
+  size_t len_sig = 0;
+  char* sig = NULL;
+  GS_GET_DATA(sig, env, args[3], &len_sig);
+
+  void* revoked = obj->revoked[id & (KEY_REGISTRY_MAX_KEYS - 1)];
+  int retcode = GS_verify_r(key, revoked, obj->rng, msg, len_msg, bsn, len_bsn, sig, len_sig);
+  if (retcode == GS_success()) {
+    return getBoolean(env, true);
+  }
+  if (retcode == GS_failure()) {
+    return getBoolean(env, false);
+  }
+  NAPI_CALL(napi_throw_error(env, NULL, GS_error(retcode)));
+  return NULL;
+}
+
+// Takes a key id and an array of user private keys, as setRevocationList
+// of a GroupSigner
+napi_value KeyRegistrySetRevocationList(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value args[2];
+  napi_value jsthis;
+  NAPI_GET_ARGS(2, env, info, argc, args, jsthis);
+  KeyRegistry* obj;
+  KEY_REGISTRY_UNWRAP(env, jsthis, obj);
+
+  int64_t id = getKeyId(env, args[0]);
+  if (getRegisteredKey(obj, id) == NULL) {
+    NAPI_CALL(napi_throw_error(env, NULL, "unknown key id"));
+    return NULL;
+  }
+  void* list;
+  const char* error = createRevocationList(env, args[1], &list);
+  if (error != NULL) {
+    NAPI_CALL(napi_throw_error(env, NULL, error));
+    return NULL;
+  }
+  int slot = id & (KEY_REGISTRY_MAX_KEYS - 1);
+  GS_freeRevocationList(obj->revoked[slot]);
+  obj->revoked[slot] = list;
+  return getUndefined(env);
+}
+
+napi_value KeyRegistryGetRevocationListSize(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[1];
+  napi_value jsthis;
+  NAPI_GET_ARGS(1, env, info, argc, args, jsthis);
+  KeyRegistry* obj;
+  KEY_REGISTRY_UNWRAP(env, jsthis, obj);
+
+  int64_t id = getKeyId(env, args[0]);
+  if (getRegisteredKey(obj, id) == NULL) {
+    NAPI_CALL(napi_throw_error(env, NULL, "unknown key id"));
+    return NULL;
+  }
+  napi_value result;
+  NAPI_CALL(napi_create_int32(env, GS_getRevocationListCount(obj->revoked[id & (KEY_REGISTRY_MAX_KEYS - 1)]), &result));
+  return result;
+}
+
+napi_value KeyRegistryGetKeyCount(napi_env env, napi_callback_info info) {
+  size_t argc = 0;
+  napi_value jsthis;
+  NAPI_GET_ARGS(0, env, info, argc, NULL, jsthis);
+  KeyRegistry* obj;
+  KEY_REGISTRY_UNWRAP(env, jsthis, obj);
+
+  napi_value result;
+  NAPI_CALL(napi_create_int32(env, obj->count, &result));
+  return result;
+}
+
+// Returns the number of keys, the bytes taken by each of them and the
+// bytes taken by the whole registry
+napi_value KeyRegistryGetMemoryUsage(napi_env env, napi_callback_info info) {
+  size_t argc = 0;
+  napi_value jsthis;
+  NAPI_GET_ARGS(0, env, info, argc, NULL, jsthis);
+  KeyRegistry* obj;
+  KEY_REGISTRY_UNWRAP(env, jsthis, obj);
+
+  napi_value out_obj, value;
+  NAPI_CALL(napi_create_object(env, &out_obj));
+  NAPI_CALL(napi_create_int32(env, obj->count, &value));
+  NAPI_CALL(napi_set_named_property(env, out_obj, "keys", value));
+  NAPI_CALL(napi_create_double(env, GS_getPreparedKeySize(), &value));
+  NAPI_CALL(napi_set_named_property(env, out_obj, "bytesPerKey", value));
+  NAPI_CALL(napi_create_double(env, keyRegistryMemory(obj), &value));
+  NAPI_CALL(napi_set_named_property(env, out_obj, "bytes", value));
+  return out_obj;
+}
+
+napi_value KeyRegistryClose(napi_env env, napi_callback_info info) {
+  size_t argc = 0;
+  napi_value jsthis;
+  NAPI_GET_ARGS(0, env, info, argc, NULL, jsthis);
+  KeyRegistry* obj;
+  NAPI_CALL(napi_unwrap(env, jsthis, (void**)(&obj)));
+  if (!obj->closed) {
+    closeKeyRegistry(obj);
+  }
+  return getUndefined(env);
+}
+
+// Tag stores live in memory, or in a file mapped with MAP_SHARED, so that
+// the tags survive restarts. The stores themselves are not locked (see
+// GS_insertTag), so the file is locked for as long as it is open: a second
+// TagStore on the same file, in this or another process, is rejected
+typedef struct {
+  void* store; // NULL once closed
+  size_t size;
+  int mapped;
+  int fd; // of the mapped file, holding the lock
+} TagStore;
+
+void closeTagStore(TagStore* obj) {
+  if (obj->store == NULL) {
+    return;
+  }
+#ifndef _WIN32
+  if (obj->mapped) {
+    munmap(obj->store, obj->size);
+    close(obj->fd); // releases the lock
+  } else
+#endif
+  {
+    free(obj->store);
+  }
+  obj->store = NULL;
+}
+
+void TagStoreDestructor(napi_env env, void* nativeObject, void* finalize_hint) {
+  closeTagStore((TagStore*) nativeObject);
+  free(nativeObject);
+}
+
+#define TAG_STORE_UNWRAP(env, jsthis, obj) \
+do { \
+  NAPI_CALL(napi_unwrap(env, jsthis, (void**)(&obj))); \
+  if (obj->store == NULL) { \
+    NAPI_CALL(napi_throw_error(env, NULL, "TagStore has been closed")); \
+    return NULL; \
+  } \
+} while (0)
+
+// Maps the store in the file at path, creating and initializing the file
+// if it is empty. Returns an error message, or NULL on success
+const char* mapTagStore(TagStore* obj, const char* path, int capacity) {
+#ifdef _WIN32
+  return "persistent tag stores are not supported on this platform";
+#else
+  int fd = open(path, O_RDWR | O_CREAT, 0600);
+  if (fd < 0) {
+    return "could not open tag store";
+  }
+  // Before reading the size, so that two openers cannot both initialize it
+  if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+    close(fd);
+    return "tag store is in use";
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return "could not open tag store";
+  }
+  int created = st.st_size == 0;
+  if (created) {
+    if (ftruncate(fd, obj->size) != 0) {
+      close(fd);
+      return "could not open tag store";
+    }
+  } else if ((size_t) st.st_size != obj->size) {
+    close(fd);
+    return "invalid tag store";
+  }
+  void* store = mmap(NULL, obj->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (store == MAP_FAILED) {
+    close(fd);
+    return "could not map tag store";
+  }
+  if (created) {
+    GS_initTagStore(store, capacity);
+  } else if (GS_checkTagStore(store, obj->size) != GS_success() ||
+             GS_getTagStoreCapacity(store) != capacity) {
+    munmap(store, obj->size);
+    close(fd);
+    return "invalid tag store";
+  }
+  obj->store = store;
+  obj->mapped = 1;
+  obj->fd = fd;
+  return NULL;
+#endif
+}
+
+napi_value NewTagStore(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value args[2];
+  napi_value jsthis, target;
+  NAPI_CALL(napi_get_cb_info(env, info, &argc, args, &jsthis, NULL));
+  NAPI_CALL(napi_get_new_target(env, info, &target));
+  if (target == NULL) {
+    NAPI_CALL(napi_throw_error(env, NULL, "TagStore must be called with new"));
+    return NULL;
+  }
+  if (argc < 1 || argc > 2) {
+    NAPI_CALL(napi_throw_error(env, NULL, "expected 1 or 2 arguments"));
+    return NULL;
+  }
+
+  int32_t capacity;
+  if (napi_get_value_int32(env, args[0], &capacity) != napi_ok ||
+      GS_getTagStoreSize(capacity) == 0) {
+    NAPI_CALL(napi_throw_error(env, NULL, "invalid tag store capacity"));
+    return NULL;
+  }
+
+  TagStore* obj = (TagStore*) malloc(sizeof(TagStore));
+  obj->size = GS_getTagStoreSize(capacity);
+  obj->mapped = 0;
+  obj->fd = -1;
+  obj->store = NULL;
+
+  if (argc == 2) {
+    char path[4096];
+    size_t path_len;
+    if (napi_get_value_string_utf8(env, args[1], path, sizeof(path), &path_len) != napi_ok ||
+        path_len == 0 || path_len >= sizeof(path) - 1) {
+      free(obj);
+      NAPI_CALL(napi_throw_error(env, NULL, "path must be a non-empty string"));
+      return NULL;
+    }
+    const char* error = mapTagStore(obj, path, capacity);
+    if (error != NULL) {
+      free(obj);
+      NAPI_CALL(napi_throw_error(env, NULL, error));
+      return NULL;
+    }
+  } else {
+    obj->store = malloc(obj->size);
+    if (obj->store == NULL) {
+      free(obj);
+      NAPI_CALL(napi_throw_error(env, NULL, "out of memory"));
+      return NULL;
+    }
+    GS_initTagStore(obj->store, capacity);
+  }
+
+  NAPI_CALL(napi_wrap(env, jsthis, (void*)obj, TagStoreDestructor, NULL, NULL));
+  return jsthis;
+}
+
+// napi_get_value_uint32 would wrap negative numbers around
+int getEpoch(napi_env env, napi_value value, uint32_t* epoch) {
+  double d;
+  if (napi_get_value_double(env, value, &d) != napi_ok ||
+      !(d >= 0 && d <= 4294967295.0) || d != (double)(uint32_t)d) {
+    return 0;
+  }
+  *epoch = (uint32_t)d;
+  return 1;
+}
+
+// Returns true if the tag is new, false if it was already in the store
+napi_value TagStoreInsert(napi_env env, napi_callback_info info) {
+  size_t argc = 3;
+  napi_value args[3];
+  napi_value jsthis;
+  NAPI_CALL(napi_get_cb_info(env, info, &argc, args, &jsthis, NULL));
+  if (argc < 2 || argc > 3) {
+    NAPI_CALL(napi_throw_error(env, NULL, "expected 2 or 3 arguments"));
+    return NULL;
+  }
+  TagStore* obj;
+  TAG_STORE_UNWRAP(env, jsthis, obj);
+
+  size_t len_sig = 0, len_bsn = 0;
+  char *sig = NULL, *bsn = NULL;
+  GS_GET_DATA(sig, env, args[0], &len_sig);
+  GS_GET_DATA(bsn, env, args[1], &len_bsn);
+
+  uint32_t epoch = 0;
+  if (argc == 3 && !getEpoch(env, args[2], &epoch)) {
+    NAPI_CALL(napi_throw_error(env, NULL, "epoch must be a non-negative integer"));
+    return NULL;
+  }
+
+  int duplicate;
+  GS_CALL(GS_insertTag(obj->store, sig, len_sig, bsn, len_bsn, epoch, &duplicate));
+
+  napi_value result;
+  NAPI_CALL(napi_get_boolean(env, !duplicate, &result));
+  return result;
+}
+
+// Removes the tags inserted with epochs before the given one, and returns
+// how many were removed
+napi_value TagStoreExpire(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[1];
+  napi_value jsthis;
+  NAPI_GET_ARGS(1, env, info, argc, args, jsthis);
+  TagStore* obj;
+  TAG_STORE_UNWRAP(env, jsthis, obj);
+
+  uint32_t epoch;
+  if (!getEpoch(env, args[0], &epoch)) {
+    NAPI_CALL(napi_throw_error(env, NULL, "epoch must be a non-negative integer"));
+    return NULL;
+  }
+
+  napi_value result;
+  NAPI_CALL(napi_create_int32(env, GS_expireTags(obj->store, epoch), &result));
+  return result;
+}
+
+napi_value TagStoreGetCount(napi_env env, napi_callback_info info) {
+  size_t argc = 0;
+  napi_value jsthis;
+  NAPI_GET_ARGS(0, env, info, argc, NULL, jsthis);
+  TagStore* obj;
+  TAG_STORE_UNWRAP(env, jsthis, obj);
+
+  napi_value result;
+  NAPI_CALL(napi_create_int32(env, GS_getTagCount(obj->store), &result));
+  return result;
+}
+
+napi_value TagStoreGetCapacity(napi_env env, napi_callback_info info) {
+  size_t argc = 0;
+  napi_value jsthis;
+  NAPI_GET_ARGS(0, env, info, argc, NULL, jsthis);
+  TagStore* obj;
+  TAG_STORE_UNWRAP(env, jsthis, obj);
+
+  napi_value result;
+  NAPI_CALL(napi_create_int32(env, GS_getTagStoreCapacity(obj->store), &result));
+  return result;
+}
+
+// Flushes a persistent store to its file; does nothing for stores in memory
+napi_value TagStoreSync(napi_env env, napi_callback_info info) {
+  size_t argc = 0;
+  napi_value jsthis;
+  NAPI_GET_ARGS(0, env, info, argc, NULL, jsthis);
+  TagStore* obj;
+  TAG_STORE_UNWRAP(env, jsthis, obj);
+
+#ifndef _WIN32
+  if (obj->mapped && msync(obj->store, obj->size, MS_SYNC) != 0) {
+    NAPI_CALL(napi_throw_error(env, NULL, "could not sync tag store"));
+    return NULL;
+  }
+#endif
+  return getUndefined(env);
+}
+
+napi_value TagStoreClose(napi_env env, napi_callback_info info) {
+  size_t argc = 0;
+  napi_value jsthis;
+  NAPI_GET_ARGS(0, env, info, argc, NULL, jsthis);
+  TagStore* obj;
+  NAPI_CALL(napi_unwrap(env, jsthis, (void**)(&obj)));
+  closeTagStore(obj);
+  return getUndefined(env);
+}
+
+void DeleteAddonData(napi_env env, void* raw, void* hint) {
+  AddonData* data = (AddonData*)raw;
+  napi_delete_reference(env, data->constructor);
+  napi_delete_reference(env, data->tagStoreConstructor);
+  napi_delete_reference(env, data->keyRegistryConstructor);
+  uv_cond_destroy(&data->idle);
+  uv_mutex_destroy(&data->lock);
+  free(data);
+}
+
+// Runs before the instances of the environment are finalized: waits for
+// the asynchronous calls that are running, and keeps the rest from starting
+void CleanupAddon(void* raw) {
+  AddonData* data = (AddonData*)raw;
+  uv_mutex_lock(&data->lock);
+  data->closing = 1;
+  while (data->executing > 0) {
+    uv_cond_wait(&data->idle, &data->lock);
+  }
+  uv_mutex_unlock(&data->lock);
+}
+
+NAPI_MODULE_INIT() {
+  AddonData* data = (AddonData*) malloc(sizeof(AddonData));
+  assert(data != NULL);
+  data->executing = 0;
+  data->closing = 0;
+  int ok = uv_mutex_init(&data->lock) == 0 && uv_cond_init(&data->idle) == 0;
+  assert(ok);
+
+  napi_value version, curve, presignPoolSize, preissuePoolSize, preparedGroupPubKeySize;
+  NAPI_CALL(napi_create_string_utf8(env, GS_version(), NAPI_AUTO_LENGTH, &version));
+  NAPI_CALL(napi_create_string_utf8(env, GS_curve(), NAPI_AUTO_LENGTH, &curve));
+  NAPI_CALL(napi_create_int32(env, GS_getPresignPoolSize(), &presignPoolSize));
+  NAPI_CALL(napi_create_int32(env, GS_getPreissuePoolSize(), &preissuePoolSize));
+  NAPI_CALL(napi_create_int32(env, GS_getMaxSize(GS_SIZE_PREPARED_GROUP_PUBLIC_KEY), &preparedGroupPubKeySize));
+
+  napi_property_descriptor properties[] = {
+    DECLARE_NAPI_METHOD("seed", Seed),
+    DECLARE_NAPI_METHOD("setupGroup", SetupGroup),
+    DECLARE_NAPI_METHOD("getGroupPubKey", GetGroupPubKey),
+    DECLARE_NAPI_METHOD("getGroupPrivKey", GetGroupPrivKey),
+    DECLARE_NAPI_METHOD("setGroupPubKey", SetGroupPubKey),
+    DECLARE_NAPI_METHOD("setGroupPrivKey", SetGroupPrivKey),
+    DECLARE_NAPI_METHOD("setPreparedGroupPubKey", SetPreparedGroupPubKey),
+    DECLARE_NAPI_METHOD("_exportPreparedGroupPubKey", ExportPreparedGroupPubKey),
+    DECLARE_NAPI_METHOD("processJoin", ProcessJoin),
+    DECLARE_NAPI_METHOD("processJoinAsync", ProcessJoinAsync),
+    DECLARE_NAPI_METHOD("processJoinBatch", ProcessJoinBatch),
+    DECLARE_NAPI_METHOD("preissue", Preissue),
+    DECLARE_NAPI_METHOD("getPreissueCount", GetPreissueCount),
+    DECLARE_NAPI_METHOD("sign", Sign),
+    DECLARE_NAPI_METHOD("signAsync", SignAsync),
+    DECLARE_NAPI_METHOD("presign", Presign),
+    DECLARE_NAPI_METHOD("onlineSign", OnlineSign),
+    DECLARE_NAPI_METHOD("getPresignCount", GetPresignCount),
+    DECLARE_NAPI_METHOD("verify", Verify),
+    DECLARE_NAPI_METHOD("verifyAsync", VerifyAsync),
+    DECLARE_NAPI_METHOD("verifyBatch", VerifyBatch),
+    DECLARE_NAPI_METHOD("getRejectReason", GetRejectReason),
+    DECLARE_NAPI_METHOD("setRevocationList", SetRevocationList),
+    DECLARE_NAPI_METHOD("getRevocationListSize", GetRevocationListSize),
+    DECLARE_NAPI_METHOD("getSignatureTag", GetSignatureTag),
+    DECLARE_NAPI_METHOD("getUserCredentials", GetUserCredentials),
+    DECLARE_NAPI_METHOD("setUserCredentials", SetUserCredentials),
+    DECLARE_NAPI_METHOD("setWireFormat", SetWireFormat),
+    DECLARE_NAPI_METHOD("destroy", Destroy),
+    DECLARE_NAPI_METHOD("startJoin", StartJoin),
+    DECLARE_NAPI_METHOD("finishJoin", FinishJoin),
+
+    DECLARE_NAPI_STATIC_METHOD("setBasenameCacheCapacity", SetBasenameCacheCapacity),
+    DECLARE_NAPI_STATIC_METHOD("getBasenameCacheStats", GetBasenameCacheStats),
+    DECLARE_NAPI_STATIC_METHOD("getStats", GetStats),
+    DECLARE_NAPI_STATIC_METHOD("resetStats", ResetStats),
+    DECLARE_NAPI_STATIC_METHOD("selfTest", SelfTest),
+    DECLARE_NAPI_STATIC("_version", version),
+    DECLARE_NAPI_STATIC("_curve", curve),
+    DECLARE_NAPI_STATIC("presignPoolSize", presignPoolSize),
+    DECLARE_NAPI_STATIC("preissuePoolSize", preissuePoolSize),
+    DECLARE_NAPI_STATIC("preparedGroupPubKeySize", preparedGroupPubKeySize)
+  };
+
+  napi_value cons;
+  NAPI_CALL(napi_define_class(env, "GroupSigner", NAPI_AUTO_LENGTH, New, NULL, sizeof(properties)/sizeof(napi_property_descriptor), properties, &cons));
+  NAPI_CALL(napi_create_reference(env, cons, 1, &data->constructor));
+  NAPI_CALL(napi_set_instance_data(env, data, DeleteAddonData, NULL));
+  NAPI_CALL(napi_add_env_cleanup_hook(env, CleanupAddon, data));
+
+  napi_property_descriptor tagStoreProperties[] = {
+    DECLARE_NAPI_METHOD("insert", TagStoreInsert),
+    DECLARE_NAPI_METHOD("expire", TagStoreExpire),
+    DECLARE_NAPI_METHOD("getCount", TagStoreGetCount),
+    DECLARE_NAPI_METHOD("getCapacity", TagStoreGetCapacity),
+    DECLARE_NAPI_METHOD("sync", TagStoreSync),
+    DECLARE_NAPI_METHOD("close", TagStoreClose)
+  };
+
+  napi_value tagStoreCons;
+  NAPI_CALL(napi_define_class(env, "TagStore", NAPI_AUTO_LENGTH, NewTagStore, NULL, sizeof(tagStoreProperties)/sizeof(napi_property_descriptor), tagStoreProperties, &tagStoreCons));
+  NAPI_CALL(napi_create_reference(env, tagStoreCons, 1, &data->tagStoreConstructor));
+  NAPI_CALL(napi_set_named_property(env, cons, "TagStore", tagStoreCons));
+
+  napi_property_descriptor keyRegistryProperties[] = {
+    DECLARE_NAPI_METHOD("seed", KeyRegistrySeed),
+    DECLARE_NAPI_METHOD("addGroupPubKey", KeyRegistryAdd),
+    DECLARE_NAPI_METHOD("removeGroupPubKey", KeyRegistryRemove),
+    DECLARE_NAPI_METHOD("verify", KeyRegistryVerify),
+    DECLARE_NAPI_METHOD("setRevocationList", KeyRegistrySetRevocationList),
+    DECLARE_NAPI_METHOD("getRevocationListSize", KeyRegistryGetRevocationListSize),
+    DECLARE_NAPI_METHOD("getKeyCount", KeyRegistryGetKeyCount),
+    DECLARE_NAPI_METHOD("getMemoryUsage", KeyRegistryGetMemoryUsage),
+    DECLARE_NAPI_METHOD("close", KeyRegistryClose)
+  };
+
+  napi_value keyRegistryCons;
+  NAPI_CALL(napi_define_class(env, "KeyRegistry", NAPI_AUTO_LENGTH, NewKeyRegistry, NULL, sizeof(keyRegistryProperties)/sizeof(napi_property_descriptor), keyRegistryProperties, &keyRegistryCons));
+  NAPI_CALL(napi_create_reference(env, keyRegistryCons, 1, &data->keyRegistryConstructor));
+  NAPI_CALL(napi_set_named_property(env, cons, "KeyRegistry", keyRegistryCons));
+
+  NAPI_CALL(napi_set_named_property(env, exports, "GroupSigner", cons));
+
+  return exports;
+}
 
 #undef GS_STR
 
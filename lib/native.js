@@ -1,6 +1,107 @@
 'use strict';
 const GroupSigner = require('bindings')('groupsign').GroupSigner;
 
+// Background refill of the presignature pool: while enabled for a basename,
+// presignatures are computed one at a time in setImmediate callbacks until
+// there are `high` of them, and again whenever onlineSign leaves fewer than
+// `low`. Refilling stops for a basename if presign fails (for example, if
+// the pool is full of presignatures for other basenames) and for all of
+// them when the signer is destroyed. While the signer is busy with
+// asynchronous calls, it is retried every REFILL_BUSY_DELAY milliseconds.
+const REFILL_BUSY_DELAY = 10;
+
+function scheduleRefill(signer, delay) {
+  if (signer._presignRefillTimer || !signer._presignRefill || signer._presignRefill.size === 0) {
+    return;
+  }
+  const tick = () => {
+    signer._presignRefillTimer = null;
+    for (const [key, target] of signer._presignRefill) {
+      try {
+        if (signer.getPresignCount(target.bsn) >= target.high) {
+          continue;
+        }
+        signer.presign(target.bsn, 1);
+      } catch (e) {
+        if (e.message === 'GroupSigner is busy') {
+          scheduleRefill(signer, REFILL_BUSY_DELAY);
+          return;
+        }
+        signer._presignRefill.delete(key);
+        continue;
+      }
+      scheduleRefill(signer);
+      return;
+    }
+  };
+  signer._presignRefillDelayed = delay !== undefined;
+  if (delay === undefined) {
+    // Not unref'd: the event loop would otherwise wait in poll before
+    // running it. Refilling stops by itself once the pool is full.
+    signer._presignRefillTimer = setImmediate(tick);
+  } else {
+    // Waiting for asynchronous calls alone should not keep the process alive
+    signer._presignRefillTimer = setTimeout(tick, delay);
+    signer._presignRefillTimer.unref();
+  }
+}
+
+GroupSigner.prototype.startPresignRefill = function(bsn, low, high) {
+  if (!(bsn instanceof Uint8Array)) {
+    throw new Error('input data must be uint8array');
+  }
+  if (!(Number.isInteger(low) && Number.isInteger(high) && low >= 0 && low <= high && high <= GroupSigner.presignPoolSize)) {
+    throw new Error('expected 0 <= low <= high <= presignPoolSize');
+  }
+  if (!this._presignRefill) {
+    this._presignRefill = new Map();
+  }
+  this._presignRefill.set(Buffer.from(bsn).toString('hex'), { bsn: new Uint8Array(bsn), low, high });
+  scheduleRefill(this);
+};
+
+// Stops refilling for bsn, or for all basenames if bsn is not given
+GroupSigner.prototype.stopPresignRefill = function(bsn) {
+  if (!this._presignRefill) {
+    return;
+  }
+  if (bsn === undefined) {
+    this._presignRefill.clear();
+  } else {
+    this._presignRefill.delete(Buffer.from(bsn).toString('hex'));
+  }
+  if (this._presignRefill.size === 0 && this._presignRefillTimer) {
+    (this._presignRefillDelayed ? clearTimeout : clearImmediate)(this._presignRefillTimer);
+    this._presignRefillTimer = null;
+  }
+};
+
+// Once destroyed (which throws if the signer is busy), nothing is left to refill
+const destroy = GroupSigner.prototype.destroy;
+GroupSigner.prototype.destroy = function() {
+  destroy.apply(this, arguments);
+  this.stopPresignRefill();
+};
+
+const onlineSign = GroupSigner.prototype.onlineSign;
+GroupSigner.prototype.onlineSign = function(msg, bsn) {
+  const sig = onlineSign.apply(this, arguments);
+  const target = this._presignRefill && this._presignRefill.get(Buffer.from(bsn).toString('hex'));
+  if (target && this.getPresignCount(bsn) < target.low) {
+    scheduleRefill(this);
+  }
+  return sig;
+};
+
+// Returns the group public key, already validated and prepared, in a
+// SharedArrayBuffer that can be posted to worker threads, where
+// setPreparedGroupPubKey sets it without validating it again
+GroupSigner.prototype.getPreparedGroupPubKey = function() {
+  const key = new Uint8Array(new SharedArrayBuffer(GroupSigner.preparedGroupPubKeySize));
+  this._exportPreparedGroupPubKey(key);
+  return key;
+};
+
 // Keep API compatibility with Emscripten builds...
 function getGroupSigner() {
   return Promise.resolve(GroupSigner);
@@ -1,33 +1,543 @@
-// This limits the size of the Uint8Array inputs.
-// For example, in sign() operation both msg and bsn
-// length must not be greater than BUFFER_SIZE
-var BUFFER_SIZE = 10 * 1024;
+// Maximum sizes of the outputs, by name (see initStaticMembers)
+var MAX_SIZE = {};
 
-function _arrayToPtr(data, ptr) {
-  if (data.length > BUFFER_SIZE) {
-    throw new Error('Data size exceeded');
+// Scratch memory for the arguments and outputs of a call, shared by all
+// instances of the module. Calls are synchronous, so it is reset (and
+// wiped) at the end of each of them. Blocks that do not fit are allocated
+// separately, and the arena then grows to fit the whole call next time.
+var scratch = { ptr: 0, size: 0, used: 0, needed: 0, extra: [] };
+
+function _scratchAlloc(size) {
+  size = (Math.max(size, 1) + 7) & ~7;
+  scratch.needed += size;
+  var ptr;
+  if (scratch.used + size <= scratch.size) {
+    ptr = scratch.ptr + scratch.used;
+    scratch.used += size;
+  } else {
+    ptr = _malloc(size);
+    if (!ptr) {
+      throw new Error('out of memory');
+    }
+    scratch.extra.push({ ptr: ptr, size: size });
   }
+  return ptr;
+}
+
+function _scratchReset() {
+  HEAPU8.fill(0, scratch.ptr, scratch.ptr + scratch.used);
+  scratch.extra.forEach(function(block) {
+    HEAPU8.fill(0, block.ptr, block.ptr + block.size);
+    _free(block.ptr);
+  });
+  if (scratch.extra.length) {
+    _free(scratch.ptr);
+    scratch.ptr = _malloc(scratch.needed);
+    scratch.size = scratch.ptr ? scratch.needed : 0;
+  }
+  scratch.used = 0;
+  scratch.needed = 0;
+  scratch.extra = [];
+}
+
+function _arrayToPtr(data, ptr) {
   writeArrayToMemory(data, ptr);
   return ptr;
 }
 
+function _wipeState(ptr, size) {
+  HEAPU8.fill(0, ptr, ptr + size);
+  _free(ptr);
+}
+
+// Frees the revocation list of a state (see GS_setRevocationList), then
+// wipes and frees the state
+function _freeState(ptr, size) {
+  Module._GS_setRevocationList(ptr, 0);
+  _wipeState(ptr, size);
+}
+
+// Frees the state of instances that were not destroyed
+var stateRegistry = typeof FinalizationRegistry === 'undefined' ? null :
+  new FinalizationRegistry(function(state) {
+    _freeState(state.ptr, state.size);
+  });
+
+// The state stays in the Module heap until destroy() is called
 function GroupSigner() {
-  this.buffers = [];
   this._makeBindings();
-
-  // Avoid storing state in Module heap
   this.stateSize = Module._GS_getStateSize();
-  var state = _malloc(this.stateSize);
-  Module._GS_initState(state);
-  this._updateState(state);
-  _free(state);
+  this.state = _malloc(this.stateSize);
+  if (!this.state) {
+    throw new Error('out of memory');
+  }
+  Module._GS_initState(this.state);
+  if (stateRegistry) {
+    stateRegistry.register(this, { ptr: this.state, size: this.stateSize }, this);
+  }
+}
+
+// Wipes and frees the state. The instance cannot be used afterwards.
+GroupSigner.prototype.destroy = function() {
+  if (this.state) {
+    if (stateRegistry) {
+      stateRegistry.unregister(this);
+    }
+    _freeState(this.state, this.stateSize);
+    this.state = 0;
+  }
 }
 
 function initStaticMembers() {
   GroupSigner._version = UTF8ToString(Module._GS_version());
   GroupSigner._curve = UTF8ToString(Module._GS_curve());
+  GroupSigner.presignPoolSize = Module._GS_getPresignPoolSize();
+  GroupSigner.preissuePoolSize = Module._GS_getPreissuePoolSize();
+  // Same order as enum Sizes in group-sign.h
+  ['groupPubKey', 'groupPrivKey', 'gsk', 'credentials', 'joinmsg', 'joinresp', 'signature', 'tag', 'preparedGroupPubKey']
+    .forEach(function(name, i) {
+      MAX_SIZE[name] = Module._GS_getMaxSize(i);
+    });
+  GroupSigner.preparedGroupPubKeySize = MAX_SIZE.preparedGroupPubKey;
+}
+
+// The basename cache is shared by all GroupSigner instances
+GroupSigner.setBasenameCacheCapacity = function(capacity) {
+  if (typeof capacity !== 'number' || capacity < 0 || capacity % 1 !== 0) {
+    throw new Error('capacity must be a non-negative integer');
+  }
+  var res = Module._GS_setBasenameCacheCapacity(capacity);
+  if (res !== Module._GS_success()) {
+    throw new Error(UTF8ToString(Module._GS_error(res)));
+  }
+}
+
+// Whether the known answer tests of GS_selfTest pass
+GroupSigner.selfTest = function() {
+  return Module._GS_selfTest() === Module._GS_success();
+}
+
+GroupSigner.getBasenameCacheStats = function() {
+  // capacity and size are i32, hits and misses are u64
+  var ptr = _malloc(24);
+  try {
+    Module._GS_getBasenameCacheStats(ptr, ptr + 4, ptr + 8, ptr + 16);
+    return {
+      capacity: getValue(ptr, 'i32'),
+      size: getValue(ptr + 4, 'i32'),
+      hits: HEAPU32[(ptr + 8) >> 2] + HEAPU32[(ptr + 12) >> 2] * 4294967296,
+      misses: HEAPU32[(ptr + 16) >> 2] + HEAPU32[(ptr + 20) >> 2] * 4294967296
+    };
+  } finally {
+    _free(ptr);
+  }
+}
+
+// Returns null in builds without hot-path statistics (see GS_getStats)
+GroupSigner.getStats = function() {
+  var count = Module._GS_getStatsCount();
+  if (count === 0) {
+    return null;
+  }
+  // calls, ticks and the histogram buckets are u64
+  var buckets = 32; // GS_STATS_BUCKETS
+  var ptr = _malloc(8 * (2 + buckets));
+  var u64 = function(i) {
+    return HEAPU32[(ptr + 8 * i) >> 2] + HEAPU32[(ptr + 8 * i + 4) >> 2] * 4294967296;
+  };
+  try {
+    var stages = {};
+    for (var stat = 0; stat < count; stat++) {
+      Module._GS_getStats(stat, ptr, ptr + 8, ptr + 16);
+      var histogram = [];
+      for (var i = 0; i < buckets; i++) {
+        histogram.push(u64(2 + i));
+      }
+      stages[UTF8ToString(Module._GS_getStatName(stat))] = {
+        calls: u64(0),
+        ticks: u64(1),
+        histogram: histogram
+      };
+    }
+    return {
+      clock: UTF8ToString(Module._GS_getStatsClock()),
+      stages: stages
+    };
+  } finally {
+    _free(ptr);
+  }
+}
+
+GroupSigner.resetStats = function() {
+  Module._GS_resetStats();
+}
+
+// Signature tags seen so far, to detect signatures linked by basename (see
+// GS_insertTag). The store stays in the Module heap until close() is called;
+// only the native module can keep it in a file.
+function TagStore(capacity, path) {
+  if (path !== undefined) {
+    throw new Error('persistent tag stores are only supported by the native module');
+  }
+  if (typeof capacity !== 'number' || capacity % 1 !== 0) {
+    throw new Error('invalid tag store capacity');
+  }
+  this.size = Module._GS_getTagStoreSize(capacity);
+  if (this.size === 0) {
+    throw new Error('invalid tag store capacity');
+  }
+  this.store = _malloc(this.size);
+  if (!this.store) {
+    throw new Error('out of memory');
+  }
+  Module._GS_initTagStore(this.store, capacity);
+  if (stateRegistry) {
+    stateRegistry.register(this, { ptr: this.store, size: this.size }, this);
+  }
+}
+
+TagStore.prototype._storeToPtr = function() {
+  if (!this.store) {
+    throw new Error('TagStore has been closed');
+  }
+  return this.store;
+}
+
+function _checkEpoch(epoch) {
+  if (typeof epoch !== 'number' || epoch < 0 || epoch > 4294967295 || epoch % 1 !== 0) {
+    throw new Error('epoch must be a non-negative integer');
+  }
 }
 
+// Returns true if the tag is new, false if it was already in the store
+TagStore.prototype.insert = function(signature, bsn, epoch) {
+  var store = this._storeToPtr();
+  if (arguments.length < 2 || arguments.length > 3) {
+    throw new Error('expected 2 or 3 arguments');
+  }
+  if (!(signature instanceof Uint8Array && bsn instanceof Uint8Array)) {
+    throw new Error('input data must be uint8array');
+  }
+  epoch = epoch === undefined ? 0 : epoch;
+  _checkEpoch(epoch);
+  try {
+    var sig = _arrayToPtr(signature, _scratchAlloc(signature.length));
+    var bsnPtr = _arrayToPtr(bsn, _scratchAlloc(bsn.length));
+    var duplicate = _scratchAlloc(4);
+    var res = Module._GS_insertTag(store, sig, signature.length, bsnPtr, bsn.length, epoch, duplicate);
+    if (res !== Module._GS_success()) {
+      throw new Error(UTF8ToString(Module._GS_error(res)));
+    }
+    return getValue(duplicate, 'i32') === 0;
+  } finally {
+    _scratchReset();
+  }
+}
+
+// Removes the tags inserted with epochs before the given one, and returns
+// how many were removed
+TagStore.prototype.expire = function(epoch) {
+  var store = this._storeToPtr();
+  _checkEpoch(epoch);
+  return Module._GS_expireTags(store, epoch);
+}
+
+TagStore.prototype.getCount = function() {
+  return Module._GS_getTagCount(this._storeToPtr());
+}
+
+TagStore.prototype.getCapacity = function() {
+  return Module._GS_getTagStoreCapacity(this._storeToPtr());
+}
+
+// Stores in the Module heap have nothing to flush
+TagStore.prototype.sync = function() {
+  this._storeToPtr();
+}
+
+TagStore.prototype.close = function() {
+  if (this.store) {
+    if (stateRegistry) {
+      stateRegistry.unregister(this);
+    }
+    _wipeState(this.store, this.size);
+    this.store = 0;
+  }
+}
+
+GroupSigner.TagStore = TagStore;
+
+// Prepared group public keys of many groups, for verifiers that serve all
+// of them: each key takes GS_getPreparedKeySize() bytes of the Module heap
+// instead of a whole state, and all of them share one generator. Ids are
+// made of the slot of the key and a generation, as in the native module.
+var KEY_REGISTRY_SLOT_BITS = 16;
+var KEY_REGISTRY_MAX_KEYS = 1 << KEY_REGISTRY_SLOT_BITS;
+var KEY_REGISTRY_GENERATIONS = 1 << (31 - KEY_REGISTRY_SLOT_BITS);
+
+// Makes a revocation list (see GS_createRevocationList) of an array of
+// user private keys (gsk, as returned by startJoin), and returns a pointer
+// to it (0 if empty)
+function _createRevocationList(gsks) {
+  if (!Array.isArray(gsks)) {
+    throw new Error('input data must be arrays of uint8array');
+  }
+  var size = MAX_SIZE.gsk;
+  var ptr = _scratchAlloc(gsks.length * size);
+  var out = _scratchAlloc(4);
+  try {
+    gsks.forEach(function(gsk, i) {
+      if (!(gsk instanceof Uint8Array)) {
+        throw new Error('input data must be uint8array');
+      }
+      if (gsk.length !== size) {
+        throw new Error('invalid revocation list');
+      }
+      writeArrayToMemory(gsk, ptr + i * size);
+    });
+    var res = Module._GS_createRevocationList(ptr, gsks.length * size, out);
+    if (res !== Module._GS_success()) {
+      throw new Error(UTF8ToString(Module._GS_error(res)));
+    }
+    return getValue(out, '*');
+  } finally {
+    HEAPU8.fill(0, ptr, ptr + gsks.length * size);
+    _scratchReset();
+  }
+}
+
+// Takes an array of user private keys, whose signatures the instance
+// rejects from then on
+GroupSigner.prototype.setRevocationList = function(gsks) {
+  var state = this._stateToPtr();
+  if (arguments.length !== 1) {
+    throw new Error('expected 1 arguments');
+  }
+  Module._GS_setRevocationList(state, _createRevocationList(gsks));
+}
+
+GroupSigner.prototype.getRevocationListSize = function() {
+  return Module._GS_getRevocationListCount(Module._GS_getRevocationList(this._stateToPtr()));
+}
+
+function _freeKeyRegistry(heap) {
+  heap.keys.forEach(function(key) {
+    if (key) {
+      _free(key);
+    }
+  });
+  heap.revoked.forEach(function(list) {
+    Module._GS_freeRevocationList(list);
+  });
+  if (heap.rng) {
+    _wipeState(heap.rng, Module._GS_getRNGSize());
+  }
+}
+
+var keyRegistryRegistry = typeof FinalizationRegistry === 'undefined' ? null :
+  new FinalizationRegistry(_freeKeyRegistry);
+
+function KeyRegistry() {
+  if (arguments.length !== 0) {
+    throw new Error('expected 0 arguments');
+  }
+  // Module heap memory of the registry, freed by close() or once the
+  // registry is garbage collected
+  this.heap = { rng: 0, keys: [], revoked: [] };
+  this.generations = [];
+  this.count = 0;
+  this.closed = false;
+  if (keyRegistryRegistry) {
+    keyRegistryRegistry.register(this, this.heap, this);
+  }
+}
+
+KeyRegistry.prototype._check = function() {
+  if (this.closed) {
+    throw new Error('KeyRegistry has been closed');
+  }
+}
+
+KeyRegistry.prototype._getKey = function(id) {
+  if (typeof id !== 'number' || id % 1 !== 0 || id < 0 || id >= KEY_REGISTRY_MAX_KEYS * KEY_REGISTRY_GENERATIONS) {
+    return 0;
+  }
+  var slot = id & (KEY_REGISTRY_MAX_KEYS - 1);
+  if (slot >= this.heap.keys.length || this.generations[slot] !== id >>> KEY_REGISTRY_SLOT_BITS) {
+    return 0;
+  }
+  return this.heap.keys[slot];
+}
+
+KeyRegistry.prototype.seed = function(seed) {
+  this._check();
+  if (arguments.length !== 1) {
+    throw new Error('expected 1 arguments');
+  }
+  if (!(seed instanceof Uint8Array)) {
+    throw new Error('input data must be uint8array');
+  }
+  if (!this.heap.rng) {
+    this.heap.rng = _malloc(Module._GS_getRNGSize());
+    if (!this.heap.rng) {
+      throw new Error('out of memory');
+    }
+  }
+  try {
+    var res = Module._GS_seedRNG(this.heap.rng, _arrayToPtr(seed, _scratchAlloc(seed.length)), seed.length);
+    if (res !== Module._GS_success()) {
+      _wipeState(this.heap.rng, Module._GS_getRNGSize());
+      this.heap.rng = 0;
+      throw new Error(UTF8ToString(Module._GS_error(res)));
+    }
+  } finally {
+    _scratchReset();
+  }
+}
+
+// Validates and prepares a group public key, and returns its id
+KeyRegistry.prototype.addGroupPubKey = function(pubKey) {
+  this._check();
+  if (arguments.length !== 1) {
+    throw new Error('expected 1 arguments');
+  }
+  if (!(pubKey instanceof Uint8Array)) {
+    throw new Error('input data must be uint8array');
+  }
+  var slot = this.heap.keys.indexOf(0);
+  if (slot === -1) {
+    if (this.heap.keys.length === KEY_REGISTRY_MAX_KEYS) {
+      throw new Error('key registry full');
+    }
+    slot = this.heap.keys.length;
+    this.heap.keys.push(0);
+    this.heap.revoked.push(0);
+    this.generations.push(0);
+  }
+  var key = _malloc(Module._GS_getPreparedKeySize());
+  if (!key) {
+    throw new Error('out of memory');
+  }
+  try {
+    var res = Module._GS_prepareGroupPubKey(key, _arrayToPtr(pubKey, _scratchAlloc(pubKey.length)), pubKey.length);
+    if (res !== Module._GS_success()) {
+      _free(key);
+      throw new Error(UTF8ToString(Module._GS_error(res)));
+    }
+  } finally {
+    _scratchReset();
+  }
+  this.heap.keys[slot] = key;
+  this.count++;
+  return (this.generations[slot] << KEY_REGISTRY_SLOT_BITS) | slot;
+}
+
+// Returns whether there was a key with the id
+KeyRegistry.prototype.removeGroupPubKey = function(id) {
+  this._check();
+  var key = this._getKey(id);
+  if (!key) {
+    return false;
+  }
+  var slot = id & (KEY_REGISTRY_MAX_KEYS - 1);
+  _free(key);
+  Module._GS_freeRevocationList(this.heap.revoked[slot]);
+  this.heap.keys[slot] = 0;
+  this.heap.revoked[slot] = 0;
+  this.generations[slot] = (this.generations[slot] + 1) % KEY_REGISTRY_GENERATIONS;
+  this.count--;
+  return true;
+}
+
+KeyRegistry.prototype.verify = function(id, msg, bsn, signature) {
+  this._check();
+  if (arguments.length !== 4) {
+    throw new Error('expected 4 arguments');
+  }
+  var key = this._getKey(id);
+  if (!key) {
+    throw new Error('unknown key id');
+  }
+  if (!this.heap.rng) {
+    throw new Error('not seeded');
+  }
+  if (!(msg instanceof Uint8Array && bsn instanceof Uint8Array && signature instanceof Uint8Array)) {
+    throw new Error('input data must be uint8array');
+  }
+  try {
+    var revoked = this.heap.revoked[id & (KEY_REGISTRY_MAX_KEYS - 1)];
+    var res = Module._GS_verify_r(key, revoked, this.heap.rng,
+      _arrayToPtr(msg, _scratchAlloc(msg.length)), msg.length,
+      _arrayToPtr(bsn, _scratchAlloc(bsn.length)), bsn.length,
+      _arrayToPtr(signature, _scratchAlloc(signature.length)), signature.length);
+    if (res === Module._GS_success()) {
+      return true;
+    } else if (res === Module._GS_failure()) {
+      return false;
+    }
+    throw new Error(UTF8ToString(Module._GS_error(res)));
+  } finally {
+    _scratchReset();
+  }
+}
+
+// Takes a key id and an array of user private keys, as setRevocationList
+// of a GroupSigner
+KeyRegistry.prototype.setRevocationList = function(id, gsks) {
+  this._check();
+  if (arguments.length !== 2) {
+    throw new Error('expected 2 arguments');
+  }
+  if (!this._getKey(id)) {
+    throw new Error('unknown key id');
+  }
+  var list = _createRevocationList(gsks);
+  var slot = id & (KEY_REGISTRY_MAX_KEYS - 1);
+  Module._GS_freeRevocationList(this.heap.revoked[slot]);
+  this.heap.revoked[slot] = list;
+}
+
+KeyRegistry.prototype.getRevocationListSize = function(id) {
+  this._check();
+  if (!this._getKey(id)) {
+    throw new Error('unknown key id');
+  }
+  return Module._GS_getRevocationListCount(this.heap.revoked[id & (KEY_REGISTRY_MAX_KEYS - 1)]);
+}
+
+KeyRegistry.prototype.getKeyCount = function() {
+  this._check();
+  return this.count;
+}
+
+// Returns the number of keys, the bytes taken by each of them and the
+// bytes of the Module heap taken by the whole registry
+KeyRegistry.prototype.getMemoryUsage = function() {
+  this._check();
+  var bytesPerKey = Module._GS_getPreparedKeySize();
+  return {
+    keys: this.count,
+    bytesPerKey: bytesPerKey,
+    bytes: (this.heap.rng ? Module._GS_getRNGSize() : 0) + this.count * bytesPerKey
+  };
+}
+
+KeyRegistry.prototype.close = function() {
+  if (this.closed) {
+    return;
+  }
+  if (keyRegistryRegistry) {
+    keyRegistryRegistry.unregister(this);
+  }
+  _freeKeyRegistry(this.heap);
+  this.heap = { rng: 0, keys: [], revoked: [] };
+  this.generations = [];
+  this.count = 0;
+  this.closed = true;
+}
+
+GroupSigner.KeyRegistry = KeyRegistry;
+
 if (Module['calledRun']) {
     initStaticMembers();
   } else {
@@ -39,27 +549,26 @@ if (Module['calledRun']) {
 }
 
 
-GroupSigner.prototype._getBuffer = function() {
-  // TODO: reduce the conservative upper bound BUFFER_SIZE
-  const buffer = _malloc(BUFFER_SIZE);
-  this.buffers.push(buffer);
-  return buffer;
+GroupSigner.prototype._getBuffer = function(size) {
+  return _scratchAlloc(size);
+}
+
+// An output buffer for size bytes, preceded by its length
+GroupSigner.prototype._getOutput = function(size) {
+  var ptr = this._getBuffer(size + 4);
+  setValue(ptr, size, 'i32');
+  return ptr;
 }
 
 GroupSigner.prototype._freeBuffers = function() {
-  this.buffers.forEach(function(buffer) {
-    _free(buffer);
-  });
-  this.buffers = [];
+  _scratchReset();
 }
 
-GroupSigner.prototype._updateState = function(state) {
-  // TODO: don't allocate every time
-  this.state = (new Uint8Array(
-    HEAPU8.buffer,
-    state,
-    this.stateSize
-  )).slice();
+GroupSigner.prototype._stateToPtr = function() {
+  if (!this.state) {
+    throw new Error('GroupSigner has been destroyed');
+  }
+  return this.state;
 }
 
 GroupSigner.prototype._makeBindings = function() {
@@ -71,7 +580,7 @@ GroupSigner.prototype._makeBindings = function() {
 
     return function() {
       try {
-        var state = _arrayToPtr(self.state, self._getBuffer());
+        var state = self._stateToPtr();
         var args = Array.prototype.slice.call(arguments);
         if (args.length !== inputs) {
           throw new Error('expected ' + inputs + ' arguments');
@@ -85,29 +594,28 @@ GroupSigner.prototype._makeBindings = function() {
           funcArgs.push(state);
         }
         for (var i = 0; i < inputs; ++i) {
-          var ptr = _arrayToPtr(args[i], self._getBuffer());
+          var ptr = _arrayToPtr(args[i], self._getBuffer(args[i].length));
           funcArgs.push(ptr);
           funcArgs.push(args[i].length);
         }
-        if (output === 'array') {
-          var ptr = self._getBuffer();
-          setValue(ptr, BUFFER_SIZE - 4, 'i32');
-          funcArgs.push(ptr + 4);
-          funcArgs.push(ptr);
-        } else if (output === 'joinstatic') {
-          var ptr = self._getBuffer();
-          setValue(ptr, BUFFER_SIZE - 4, 'i32');
+        // Any other output is the name of an object in MAX_SIZE
+        if (output === 'joinstatic') {
+          var ptr = self._getOutput(MAX_SIZE.gsk);
           funcArgs.push(ptr + 4);
           funcArgs.push(ptr);
 
-          var ptr2 = self._getBuffer();
-          setValue(ptr2, BUFFER_SIZE - 4, 'i32');
+          var ptr2 = self._getOutput(MAX_SIZE.joinmsg);
           funcArgs.push(ptr2 + 4);
           funcArgs.push(ptr2);
+        } else if (output === 'reason') {
+          funcArgs.push(self._getBuffer(4));
+        } else if (output && output !== 'boolean') {
+          var ptr = self._getOutput(MAX_SIZE[output]);
+          funcArgs.push(ptr + 4);
+          funcArgs.push(ptr);
         }
 
         var res = Module[func].apply(Module, funcArgs);
-        this._updateState(state);
 
         // TODO: we should probably have a way to check if there was an error for verify
         if (output === 'boolean') {
@@ -120,6 +628,10 @@ GroupSigner.prototype._makeBindings = function() {
         if (res !== Module._GS_success()) {
           throw new Error(UTF8ToString(Module._GS_error(res)));
         }
+        if (output === 'reason') {
+          var reason = getValue(funcArgs[funcArgs.length - 1], 'i32');
+          return reason === 0 ? null : UTF8ToString(Module._GS_getRejectReasonName(reason));
+        }
         if (output === 'joinstatic') {
           var ptrjoinmsg = funcArgs[funcArgs.length - 1];
           var ptrgsk = funcArgs[funcArgs.length - 3];
@@ -143,25 +655,260 @@ GroupSigner.prototype._makeBindings = function() {
           )).slice();
         }
       } finally {
-        this._freeBuffers();
+        self._freeBuffers();
+      }
+    }
+  }
+
+  // verifyBatch(msgs, bsns, sigs) takes three arrays of Uint8Array of the
+  // same length and returns an array of booleans, one per signature.
+  function batch() {
+    try {
+      var args = Array.prototype.slice.call(arguments);
+      if (args.length !== 3) {
+        throw new Error('expected 3 arguments');
+      }
+      if (!args.every(Array.isArray)) {
+        throw new Error('input data must be arrays of uint8array');
+      }
+      var count = args[0].length;
+      if (!args.every(function(arg) { return arg.length === count; })) {
+        throw new Error('input arrays must have the same length');
+      }
+
+      var state = self._stateToPtr();
+      var funcArgs = [state, count];
+      args.forEach(function(inputs) {
+        var ptrs = self._getBuffer(4 * count);
+        var lens = self._getBuffer(4 * count);
+        inputs.forEach(function(input, i) {
+          if (!(input instanceof Uint8Array)) {
+            throw new Error('input data must be uint8array');
+          }
+          setValue(ptrs + 4 * i, _arrayToPtr(input, self._getBuffer(input.length)), 'i32');
+          setValue(lens + 4 * i, input.length, 'i32');
+        });
+        funcArgs.push(ptrs);
+        funcArgs.push(lens);
+      });
+      var results = self._getBuffer(4 * count);
+      funcArgs.push(results);
+
+      var res = Module._GS_verifyBatch.apply(Module, funcArgs);
+
+      if (res !== Module._GS_success() && res !== Module._GS_failure()) {
+        throw new Error(UTF8ToString(Module._GS_error(res)));
+      }
+      var out = [];
+      for (var i = 0; i < count; ++i) {
+        out.push(getValue(results + 4 * i, 'i32') === Module._GS_success());
+      }
+      return out;
+    } finally {
+      self._freeBuffers();
+    }
+  }
+
+  // processJoinBatch(joinmsgs, challenges) takes two arrays of Uint8Array
+  // of the same length and returns an array with the join responses, or
+  // null for the join messages that could not be processed.
+  function joinBatch() {
+    try {
+      var args = Array.prototype.slice.call(arguments);
+      if (args.length !== 2) {
+        throw new Error('expected 2 arguments');
+      }
+      if (!args.every(Array.isArray)) {
+        throw new Error('input data must be arrays of uint8array');
+      }
+      var count = args[0].length;
+      if (!args.every(function(arg) { return arg.length === count; })) {
+        throw new Error('input arrays must have the same length');
+      }
+
+      var state = self._stateToPtr();
+      var funcArgs = [state, count];
+      args.forEach(function(inputs) {
+        var ptrs = self._getBuffer(4 * count);
+        var lens = self._getBuffer(4 * count);
+        inputs.forEach(function(input, i) {
+          if (!(input instanceof Uint8Array)) {
+            throw new Error('input data must be uint8array');
+          }
+          setValue(ptrs + 4 * i, _arrayToPtr(input, self._getBuffer(input.length)), 'i32');
+          setValue(lens + 4 * i, input.length, 'i32');
+        });
+        funcArgs.push(ptrs);
+        funcArgs.push(lens);
+      });
+      var outs = self._getBuffer(4 * count);
+      var outLens = self._getBuffer(4 * count);
+      for (var i = 0; i < count; ++i) {
+        setValue(outs + 4 * i, self._getBuffer(MAX_SIZE.joinresp), 'i32');
+        setValue(outLens + 4 * i, MAX_SIZE.joinresp, 'i32');
+      }
+      var results = self._getBuffer(4 * count);
+      funcArgs.push(outs, outLens, results);
+
+      var res = Module._GS_processJoinBatch.apply(Module, funcArgs);
+
+      if (res !== Module._GS_success() && res !== Module._GS_failure()) {
+        throw new Error(UTF8ToString(Module._GS_error(res)));
+      }
+      var out = [];
+      for (var i = 0; i < count; ++i) {
+        if (getValue(results + 4 * i, 'i32') === Module._GS_success()) {
+          out.push((new Uint8Array(
+            HEAPU8.buffer,
+            getValue(outs + 4 * i, 'i32'),
+            getValue(outLens + 4 * i, 'i32')
+          )).slice());
+        } else {
+          out.push(null);
+        }
+      }
+      return out;
+    } finally {
+      self._freeBuffers();
+    }
+  }
+
+  function preissue(count) {
+    try {
+      if (arguments.length !== 1) {
+        throw new Error('expected 1 arguments');
+      }
+      if (typeof count !== 'number' || count < 0 || count % 1 !== 0) {
+        throw new Error('count must be a non-negative integer');
+      }
+      var state = self._stateToPtr();
+      var res = Module._GS_preissue(state, count);
+      if (res !== Module._GS_success()) {
+        throw new Error(UTF8ToString(Module._GS_error(res)));
+      }
+    } finally {
+      self._freeBuffers();
+    }
+  }
+
+  function setWireFormat(version) {
+    try {
+      if (arguments.length !== 1) {
+        throw new Error('expected 1 arguments');
+      }
+      if (typeof version !== 'number' || version % 1 !== 0) {
+        throw new Error('version must be an integer');
+      }
+      var state = self._stateToPtr();
+      var res = Module._GS_setWireFormat(state, version);
+      if (res !== Module._GS_success()) {
+        throw new Error(UTF8ToString(Module._GS_error(res)));
+      }
+    } finally {
+      self._freeBuffers();
+    }
+  }
+
+  function getPreissueCount() {
+    try {
+      if (arguments.length !== 0) {
+        throw new Error('expected 0 arguments');
+      }
+      return Module._GS_getPreissueCount(self._stateToPtr());
+    } finally {
+      self._freeBuffers();
+    }
+  }
+
+  // presign(bsn, count) and getPresignCount(bsn) take an integer besides
+  // the basename, or return one
+  function presign(bsn, count) {
+    try {
+      if (arguments.length !== 2) {
+        throw new Error('expected 2 arguments');
+      }
+      if (!(bsn instanceof Uint8Array)) {
+        throw new Error('input data must be uint8array');
+      }
+      if (typeof count !== 'number' || count < 0 || count % 1 !== 0) {
+        throw new Error('count must be a non-negative integer');
       }
+      var state = self._stateToPtr();
+      var ptr = _arrayToPtr(bsn, self._getBuffer(bsn.length));
+      var res = Module._GS_presign(state, ptr, bsn.length, count);
+      if (res !== Module._GS_success()) {
+        throw new Error(UTF8ToString(Module._GS_error(res)));
+      }
+    } finally {
+      self._freeBuffers();
     }
   }
 
+  function getPresignCount(bsn) {
+    try {
+      if (arguments.length !== 1) {
+        throw new Error('expected 1 arguments');
+      }
+      if (!(bsn instanceof Uint8Array)) {
+        throw new Error('input data must be uint8array');
+      }
+      var state = self._stateToPtr();
+      var ptr = _arrayToPtr(bsn, self._getBuffer(bsn.length));
+      return Module._GS_getPresignCount(state, ptr, bsn.length);
+    } finally {
+      self._freeBuffers();
+    }
+  }
+
+  function promisify(func) {
+    return function() {
+      try {
+        return Promise.resolve(func.apply(self, arguments));
+      } catch (e) {
+        return Promise.reject(e);
+      }
+    };
+  }
+
+  var exportPrepared = _('_GS_exportPreparedGroupPubKey', 0, 'preparedGroupPubKey');
+
   this.seed = _('_GS_seed', 1);
   this.setupGroup = _('_GS_setupGroup');
-  this.getGroupPubKey = _('_GS_exportGroupPubKey', 0, 'array');
-  this.getGroupPrivKey = _('_GS_exportGroupPrivKey', 0, 'array');
-  this.getUserCredentials = _('_GS_exportUserCredentials', 0, 'array');
+  this.getGroupPubKey = _('_GS_exportGroupPubKey', 0, 'groupPubKey');
+  this.getGroupPrivKey = _('_GS_exportGroupPrivKey', 0, 'groupPrivKey');
+  this.getUserCredentials = _('_GS_exportUserCredentials', 0, 'credentials');
   this.setGroupPubKey = _('_GS_loadGroupPubKey', 1);
   this.setGroupPrivKey = _('_GS_loadGroupPrivKey', 1);
   this.setUserCredentials = _('_GS_loadUserCredentials', 1);
-  this.processJoin = _('_GS_processJoin', 2, 'array');
-  this.sign = _('_GS_sign', 2, 'array');
+  this.setPreparedGroupPubKey = _('_GS_loadPreparedGroupPubKey', 1);
+  this.getPreparedGroupPubKey = function() {
+    var key = exportPrepared();
+    if (typeof SharedArrayBuffer === 'undefined') {
+      return key;
+    }
+    var shared = new Uint8Array(new SharedArrayBuffer(key.length));
+    shared.set(key);
+    return shared;
+  };
+  this.setWireFormat = setWireFormat;
+  this.processJoin = _('_GS_processJoin', 2, 'joinresp');
+  this.processJoinBatch = joinBatch;
+  this.preissue = preissue;
+  this.getPreissueCount = getPreissueCount;
+  this.sign = _('_GS_sign', 2, 'signature');
+  this.presign = presign;
+  this.onlineSign = _('_GS_onlineSign', 2, 'signature');
+  this.getPresignCount = getPresignCount;
   this.verify = _('_GS_verify', 3, 'boolean');
-  this.getSignatureTag = _('_GS_getSignatureTag', 1, 'array', false);
+  this.getRejectReason = _('_GS_verifyWithReason', 3, 'reason');
+  this.verifyBatch = batch;
+  this.getSignatureTag = _('_GS_getSignatureTag', 1, 'tag', false);
   this.startJoin = _('_GS_startJoin', 1, 'joinstatic');
-  this.finishJoin = _('_GS_finishJoin', 3, 'array', false);
+  // Same API as the native addon, but running on the calling thread
+  this.signAsync = promisify(this.sign);
+  this.verifyAsync = promisify(this.verify);
+  this.processJoinAsync = promisify(this.processJoin);
+  this.finishJoin = _('_GS_finishJoin', 3, 'credentials', false);
 }
 
 Module.GroupSigner = GroupSigner;
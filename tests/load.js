@@ -0,0 +1,436 @@
+'use strict';
+// Load generator: measures throughput and latency of mixed sign, verify and
+// join workloads on several worker threads, for each build of the library.
+//
+//   node tests/load.js [options]
+//
+//   --modules native,wasm   builds to load (native, wasm, asmjs), one after the other
+//   --workers N             worker threads per build (default: number of CPUs)
+//   --duration S            measured seconds per build (default: 10)
+//   --warmup S              unmeasured seconds before that (default: 2)
+//   --mix sign=1,verify=4,join=0.1
+//                           relative weights of the operations
+//   --async N               use signAsync/verifyAsync/processJoinAsync with N
+//                           calls in flight per worker (default: 0, synchronous)
+//   --members N             signers in the corpus (default: 8)
+//   --corpus N              signatures and join messages in the corpus (default: 512)
+//   --output FILE           write the JSON report to FILE (default: stdout)
+//
+// The corpus (group keys, credentials, signatures and join messages) is
+// generated once, before anything is timed, and shared by all builds and
+// workers. Messages and basenames follow fixed size distributions, and
+// basenames are drawn from a skewed (Zipf-like) distribution, so that the
+// basename cache sees a realistic mix of hits and misses. Latencies are
+// measured with process.hrtime.bigint() around each call; each worker also
+// reports its heap usage and garbage collections, and the main thread
+// samples the resident set size of the process.
+const os = require('os');
+const fs = require('fs');
+const crypto = require('crypto');
+const { Worker, isMainThread, parentPort, workerData } = require('worker_threads');
+const { PerformanceObserver } = require('perf_hooks');
+
+const testModules = {
+  native: '../lib/native',
+  wasm: '../lib/wasm',
+  asmjs: '../lib/asmjs',
+};
+
+// Sizes in bytes, with their weights
+const MESSAGE_SIZES = [[32, 40], [256, 30], [1024, 20], [16384, 10]];
+const BASENAME_SIZES = [[8, 20], [32, 60], [64, 20]];
+const BASENAMES = 64;
+const ZIPF_EXPONENT = 1.1;
+
+// Deterministic choices (mulberry32), so that runs draw the same operations
+function makeRandom(seed) {
+  let a = seed >>> 0;
+  return () => {
+    a = (a + 0x6D2B79F5) >>> 0;
+    let t = a;
+    t = Math.imul(t ^ (t >>> 15), t | 1);
+    t ^= t + Math.imul(t ^ (t >>> 7), t | 61);
+    return ((t ^ (t >>> 14)) >>> 0) / 4294967296;
+  };
+}
+
+function makeWeighted(entries) {
+  const total = entries.reduce((sum, [, w]) => sum + w, 0);
+  return (random) => {
+    let x = random() * total;
+    for (const [value, w] of entries) {
+      x -= w;
+      if (x < 0) {
+        return value;
+      }
+    }
+    return entries[entries.length - 1][0];
+  };
+}
+
+function parseArgs(argv) {
+  const config = {
+    modules: ['native', 'wasm'],
+    workers: os.cpus().length,
+    duration: 10,
+    warmup: 2,
+    mix: { sign: 1, verify: 4, join: 0.1 },
+    async: 0,
+    members: 8,
+    corpus: 512,
+    output: null,
+  };
+  for (let i = 0; i < argv.length; i += 2) {
+    const key = argv[i].replace(/^--/, '');
+    const value = argv[i + 1];
+    if (value === undefined || !(key in config)) {
+      throw new Error(`unknown option or missing value: ${argv[i]}`);
+    }
+    if (key === 'modules') {
+      config.modules = value.split(',');
+      config.modules.forEach((name) => {
+        if (!testModules[name]) {
+          throw new Error(`unknown module: ${name}`);
+        }
+      });
+    } else if (key === 'mix') {
+      config.mix = {};
+      value.split(',').forEach((pair) => {
+        const [op, weight] = pair.split('=');
+        if (!['sign', 'verify', 'join'].includes(op) || !(Number(weight) >= 0)) {
+          throw new Error(`invalid mix: ${pair}`);
+        }
+        config.mix[op] = Number(weight);
+      });
+    } else if (key === 'output') {
+      config.output = value;
+    } else {
+      config[key] = Number(value);
+      if (!(config[key] >= 0)) {
+        throw new Error(`invalid value for ${argv[i]}: ${value}`);
+      }
+    }
+  }
+  return config;
+}
+
+function loadGroupSigner(name) {
+  return require(testModules[name])();
+}
+
+function makeCorpus(GroupSigner, config) {
+  const random = makeRandom(1);
+  const messageSize = makeWeighted(MESSAGE_SIZES);
+  const basenameSize = makeWeighted(BASENAME_SIZES);
+  const zipf = [];
+  for (let k = 0; k < BASENAMES; k += 1) {
+    zipf.push([k, 1 / Math.pow(k + 1, ZIPF_EXPONENT)]);
+  }
+  const basenameIndex = makeWeighted(zipf);
+
+  const basenames = [];
+  for (let k = 0; k < BASENAMES; k += 1) {
+    basenames.push(new Uint8Array(crypto.randomBytes(basenameSize(random))));
+  }
+
+  const issuer = new GroupSigner();
+  issuer.seed(new Uint8Array(crypto.randomBytes(128)));
+  issuer.setupGroup();
+  const groupPubKey = issuer.getGroupPubKey();
+
+  const members = [];
+  for (let i = 0; i < config.members; i += 1) {
+    const signer = new GroupSigner();
+    signer.seed(new Uint8Array(crypto.randomBytes(128)));
+    const challenge = new Uint8Array(crypto.randomBytes(32));
+    const { gsk, joinmsg } = signer.startJoin(challenge);
+    const credentials = signer.finishJoin(groupPubKey, gsk, issuer.processJoin(joinmsg, challenge));
+    signer.setUserCredentials(credentials);
+    members.push({ signer, credentials });
+  }
+
+  // (message, basename, signature) triples for verify; sign draws the
+  // message and basename of a random entry
+  const entries = [];
+  for (let i = 0; i < config.corpus; i += 1) {
+    const msg = new Uint8Array(crypto.randomBytes(messageSize(random)));
+    const bsn = basenames[basenameIndex(random)];
+    const sig = members[i % members.length].signer.sign(msg, bsn);
+    entries.push({ msg, bsn, sig });
+  }
+
+  const joins = [];
+  for (let i = 0; i < config.corpus; i += 1) {
+    const signer = members[i % members.length].signer;
+    const challenge = new Uint8Array(crypto.randomBytes(32));
+    joins.push({ joinmsg: signer.startJoin(challenge).joinmsg, challenge });
+  }
+
+  const corpus = {
+    groupPrivKey: issuer.getGroupPrivKey(),
+    groupPubKey,
+    credentials: members.map((m) => m.credentials),
+    entries,
+    joins,
+  };
+  issuer.destroy();
+  members.forEach((m) => m.signer.destroy());
+  return corpus;
+}
+
+function percentile(sorted, p) {
+  if (sorted.length === 0) {
+    return 0;
+  }
+  return sorted[Math.min(sorted.length - 1, Math.ceil(p * sorted.length) - 1)];
+}
+
+function summarize(latencies, seconds) {
+  const sorted = Float64Array.from(latencies).sort();
+  const sum = sorted.reduce((a, b) => a + b, 0);
+  const us = (ns) => Math.round(ns / 10) / 100;
+  return {
+    count: sorted.length,
+    opsPerSec: Math.round(sorted.length / seconds),
+    latencyUs: {
+      p50: us(percentile(sorted, 0.5)),
+      p99: us(percentile(sorted, 0.99)),
+      p999: us(percentile(sorted, 0.999)),
+      max: us(sorted.length ? sorted[sorted.length - 1] : 0),
+      mean: us(sorted.length ? sum / sorted.length : 0),
+    },
+  };
+}
+
+function runModule(name, corpus, config) {
+  let rssPeak = process.memoryUsage().rss;
+  const sampler = setInterval(() => {
+    rssPeak = Math.max(rssPeak, process.memoryUsage().rss);
+  }, 50);
+  const workers = [];
+  for (let i = 0; i < config.workers; i += 1) {
+    workers.push(new Promise((resolve, reject) => {
+      const worker = new Worker(__filename, { workerData: { name, corpus, config, index: i } });
+      worker.on('message', resolve);
+      worker.on('error', reject);
+      worker.on('exit', (code) => {
+        if (code !== 0) {
+          reject(new Error(`worker exited with code ${code}`));
+        }
+      });
+    }));
+  }
+  return Promise.all(workers).then((results) => {
+    clearInterval(sampler);
+    const operations = {};
+    Object.keys(config.mix).forEach((op) => {
+      const all = [];
+      results.forEach((r) => {
+        for (const latency of r.latencies[op]) {
+          all.push(latency);
+        }
+      });
+      operations[op] = summarize(all, config.duration);
+    });
+    const total = Object.values(operations).reduce((sum, o) => sum + o.count, 0);
+    return {
+      workers: config.workers,
+      ops: total,
+      opsPerSec: Math.round(total / config.duration),
+      operations,
+      memory: {
+        rssPeakBytes: rssPeak,
+        heapUsedPeakBytes: results.reduce((sum, r) => sum + r.heapUsedPeak, 0),
+        gc: {
+          count: results.reduce((sum, r) => sum + r.gcCount, 0),
+          durationMs: Math.round(results.reduce((sum, r) => sum + r.gcDuration, 0) * 100) / 100,
+        },
+      },
+    };
+  });
+}
+
+function main() {
+  const config = parseArgs(process.argv.slice(2));
+  const report = {
+    node: process.version,
+    platform: `${os.platform()} ${os.arch()}`,
+    cpus: os.cpus().length,
+    cpuModel: os.cpus()[0].model,
+    config,
+    modules: {},
+  };
+  return loadGroupSigner(config.modules[0]).then((GroupSigner) => {
+    const corpus = makeCorpus(GroupSigner, config);
+    return config.modules.reduce((promise, name) => promise.then(() => {
+      console.error(`[${name}] ${config.workers} workers, ${config.warmup}s warm-up, ${config.duration}s...`);
+      return runModule(name, corpus, config).then((result) => {
+        report.modules[name] = result;
+        Object.keys(result.operations).forEach((op) => {
+          const o = result.operations[op];
+          console.error(`[${name}] ${op.padEnd(6)} ${String(o.opsPerSec).padStart(8)} ops/s  p50 ${o.latencyUs.p50}us  p99 ${o.latencyUs.p99}us  p999 ${o.latencyUs.p999}us`);
+        });
+      });
+    }), Promise.resolve());
+  }).then(() => {
+    const json = JSON.stringify(report, null, 2);
+    if (config.output) {
+      fs.writeFileSync(config.output, json + '\n');
+    } else {
+      console.log(json);
+    }
+  });
+}
+
+function worker() {
+  const { name, corpus, config, index } = workerData;
+  const random = makeRandom(1000 + index);
+  const ops = Object.keys(config.mix);
+  const pickOp = makeWeighted(ops.map((op) => [op, config.mix[op]]));
+
+  let gcCount = 0;
+  let gcDuration = 0;
+  const observer = new PerformanceObserver((list) => {
+    list.getEntries().forEach((entry) => {
+      gcCount += 1;
+      gcDuration += entry.duration;
+    });
+  });
+
+  return loadGroupSigner(name).then((GroupSigner) => {
+    const seed = () => new Uint8Array(crypto.randomBytes(128));
+    // One issuer and signer per call in flight, since each instance signs
+    // or processes join messages one at a time; verifiers are shared
+    const lanes = Math.max(1, config.async);
+    const issuers = [];
+    const signers = [];
+    for (let i = 0; i < lanes; i += 1) {
+      const issuer = new GroupSigner();
+      issuer.seed(seed());
+      issuer.setGroupPrivKey(corpus.groupPrivKey);
+      issuers.push(issuer);
+      const lane = [];
+      corpus.credentials.forEach((credentials) => {
+        const signer = new GroupSigner();
+        signer.seed(seed());
+        signer.setUserCredentials(credentials);
+        lane.push(signer);
+      });
+      signers.push(lane);
+    }
+    const verifier = new GroupSigner();
+    verifier.seed(seed());
+    verifier.setGroupPubKey(corpus.groupPubKey);
+
+    const pick = (array) => array[Math.floor(random() * array.length)];
+    const syncOps = {
+      sign: (lane) => {
+        const { msg, bsn } = pick(corpus.entries);
+        return pick(signers[lane]).sign(msg, bsn);
+      },
+      verify: () => {
+        const { msg, bsn, sig } = pick(corpus.entries);
+        return verifier.verify(msg, bsn, sig);
+      },
+      join: (lane) => {
+        const { joinmsg, challenge } = pick(corpus.joins);
+        return issuers[lane].processJoin(joinmsg, challenge);
+      },
+    };
+    const asyncOps = {
+      sign: (lane) => {
+        const { msg, bsn } = pick(corpus.entries);
+        return pick(signers[lane]).signAsync(msg, bsn);
+      },
+      verify: () => {
+        const { msg, bsn, sig } = pick(corpus.entries);
+        return verifier.verifyAsync(msg, bsn, sig);
+      },
+      join: (lane) => {
+        const { joinmsg, challenge } = pick(corpus.joins);
+        return issuers[lane].processJoinAsync(joinmsg, challenge);
+      },
+    };
+
+    // Sampled every few calls, since synchronous runs block timers
+    let heapUsedPeak = 0;
+    let calls = 0;
+    const record = (op, t0) => {
+      latencies[op].push(Number(process.hrtime.bigint() - t0));
+      calls += 1;
+      if ((calls & 255) === 0) {
+        heapUsedPeak = Math.max(heapUsedPeak, process.memoryUsage().heapUsed);
+      }
+    };
+
+    let latencies;
+    const reset = () => {
+      latencies = {};
+      ops.forEach((op) => {
+        latencies[op] = [];
+      });
+    };
+    reset();
+
+    const runSync = (until) => {
+      while (process.hrtime.bigint() < until) {
+        const op = pickOp(random);
+        const t0 = process.hrtime.bigint();
+        syncOps[op](0);
+        record(op, t0);
+      }
+      return Promise.resolve();
+    };
+    const runAsync = (until) => {
+      const loop = (lane) => {
+        if (process.hrtime.bigint() >= until) {
+          return Promise.resolve();
+        }
+        const op = pickOp(random);
+        const t0 = process.hrtime.bigint();
+        return asyncOps[op](lane).then(() => {
+          record(op, t0);
+          return loop(lane);
+        });
+      };
+      const loops = [];
+      for (let lane = 0; lane < lanes; lane += 1) {
+        loops.push(loop(lane));
+      }
+      return Promise.all(loops);
+    };
+    const run = config.async > 0 ? runAsync : runSync;
+    const deadline = (seconds) => process.hrtime.bigint() + BigInt(Math.round(seconds * 1e9));
+
+    return run(deadline(config.warmup)).then(() => {
+      reset();
+      observer.observe({ entryTypes: ['gc'] });
+      heapUsedPeak = process.memoryUsage().heapUsed;
+      return run(deadline(config.duration));
+    }).then(() => {
+      heapUsedPeak = Math.max(heapUsedPeak, process.memoryUsage().heapUsed);
+      // GC entries are delivered asynchronously
+      return new Promise((resolve) => setTimeout(resolve, 10));
+    }).then(() => {
+      observer.disconnect();
+      issuers.forEach((issuer) => issuer.destroy());
+      signers.forEach((lane) => lane.forEach((signer) => signer.destroy()));
+      verifier.destroy();
+      parentPort.postMessage({ latencies, heapUsedPeak, gcCount, gcDuration });
+    });
+  });
+}
+
+if (isMainThread) {
+  main().catch((e) => {
+    console.error(e);
+    process.exit(1);
+  });
+} else {
+  worker().catch((e) => {
+    // Rejected promises do not end workers by themselves
+    setImmediate(() => {
+      throw e;
+    });
+  });
+}
@@ -27,6 +27,17 @@ function doTests(name, moduleName) {
         GroupSigner = s;
       });
     });
+
+    // A new signer, seeded with seed, with credentials from server
+    function makeMember(server, seed) {
+      const signer = new GroupSigner();
+      signer.seed(seed);
+      const challenge = new Uint8Array(32);
+      const { gsk, joinmsg } = signer.startJoin(challenge);
+      signer.setUserCredentials(signer.finishJoin(server.getGroupPubKey(), gsk, server.processJoin(joinmsg, challenge)));
+      return { signer, gsk };
+    }
+
     it('seed', () => {
       expect(() => {
         const signer = new GroupSigner();
@@ -90,6 +101,25 @@ function doTests(name, moduleName) {
       expect(Buffer.from(signer.getGroupPrivKey()).toString('base64')).to.equal('A6Rnm7aewxlszEDU2rfd6dM+w1GppZXfYSF3llh/YNwDBoniR8rxIgWvqeBtEo/GLn2x6VZNPCo2DoVonXLD+wk12dSj9vOPBXocHw24ji8mcm1DrGzQk7miCA6ncw1ZCch1x656rcGoK1kNxh1CiVfh7hLqzwHoYAnl9zVzuWoEOsh2Gv2XQn8io8kH0XCEnEl//87YDe9AM0hpUQBY2BkDnwdYS9p3fJLJmPIsr1cX2xFLYOuGysRvPzw67HRtBvUmNvszK8KzhZwQjEIA+vIhalehDAdPtvIrajQ0rcMURF0+hhoMNozPkmj3eTc19HCoMDP/Xf7mCHRaiU40uAsMVXAquRr8rwJRnTeyO8bOjIuu8JYRFhuLlBovKGYWIiTZEveUfONnWsmnX2OXVzK8HacKo6A5lub1ANXS3UYLMa5VZgiCeS/dEKkOAPhHjHgAGmpqi8XmaWcYHN1FHwEWk0VWL6AukuXszCxH1p0kVcJGbZlwr2EpU5Gx25adIekebbnK9CvXhJMfwFXbW41KShxBw+WLbfrF8P9uMJQEmtJ0HaNT4LxY7NL8yL/pOnZh4uKLkL+puRcffZSSjg==');
     });
 
+    it('setGroupPubKey - validated keys', () => {
+      const issuer = new GroupSigner();
+      issuer.seed(seed1);
+      issuer.setupGroup();
+      const pubKey = issuer.getGroupPubKey();
+
+      // A tampered proof must be rejected even after the original key was
+      // accepted, and every time it is loaded
+      const tampered = new Uint8Array(pubKey);
+      tampered[tampered.length - 1] ^= 1;
+      const signer = new GroupSigner();
+      for (let i = 0; i < 2; i += 1) {
+        signer.setGroupPubKey(pubKey);
+        expect(() => signer.setGroupPubKey(tampered)).to.throw('invalid group public key');
+      }
+      signer.setGroupPubKey(pubKey);
+      expect(signer.getGroupPubKey()).to.deep.equal(pubKey);
+    });
+
     it('joinStatic', () => {
       const server = new GroupSigner();
       server.seed(seed1);
@@ -136,6 +166,769 @@ function doTests(name, moduleName) {
       expect(signer.getSignatureTag(sig)).to.not.deep.equal(signer.getSignatureTag(sig3));
     });
 
+    it('verifyBatch', () => {
+      const server = new GroupSigner();
+      server.seed(seed1);
+      server.setupGroup();
+
+      const { signer } = makeMember(server, seed2);
+
+      const verifier = new GroupSigner();
+      verifier.seed(seed2);
+      verifier.setGroupPubKey(server.getGroupPubKey());
+
+      const msgs = [];
+      const bsns = [];
+      const sigs = [];
+      for (let i = 0; i < 7; i += 1) {
+        msgs.push(new Uint8Array(crypto.randomBytes(32)));
+        bsns.push(new Uint8Array(crypto.randomBytes(i)));
+        sigs.push(signer.sign(msgs[i], bsns[i]));
+      }
+      expect(verifier.verifyBatch([], [], [])).to.deep.equal([]);
+      expect(verifier.verifyBatch(msgs, bsns, sigs)).to.deep.equal([true, true, true, true, true, true, true]);
+
+      // Wrong message, swapped signatures and undecodable signature
+      msgs[1] = new Uint8Array(32);
+      const tmp = sigs[3];
+      sigs[3] = sigs[4];
+      sigs[4] = tmp;
+      sigs[6] = new Uint8Array(1024);
+      expect(verifier.verifyBatch(msgs, bsns, sigs)).to.deep.equal([true, false, true, false, false, true, false]);
+      msgs.forEach((msg, i) => {
+        expect(verifier.verifyBatch([msg], [bsns[i]], [sigs[i]])).to.deep.equal([i !== 6 && verifier.verify(msg, bsns[i], sigs[i])]);
+      });
+
+      expect(() => verifier.verifyBatch()).to.throw('expected 3 arguments');
+      expect(() => verifier.verifyBatch(msgs, bsns)).to.throw('expected 3 arguments');
+      expect(() => verifier.verifyBatch(msgs, bsns, sigs[0])).to.throw('input data must be arrays of uint8array');
+      expect(() => verifier.verifyBatch(msgs, bsns, sigs.slice(1))).to.throw('input arrays must have the same length');
+      expect(() => verifier.verifyBatch(msgs, bsns, [1, 2, 3, 4, 5, 6, 7])).to.throw('input data must be uint8array');
+      expect(() => (new GroupSigner()).verifyBatch(msgs, bsns, sigs)).to.throw('group public key not set');
+    });
+
+    it('presign', () => {
+      const server = new GroupSigner();
+      server.seed(seed1);
+      server.setupGroup();
+
+      const stranger = new GroupSigner();
+      stranger.seed(seed2);
+      expect(() => stranger.presign(new Uint8Array(32), 1)).to.throw('user credentials not set');
+      const { signer } = makeMember(server, seed2);
+      signer.setGroupPubKey(server.getGroupPubKey());
+
+      const bsn = new Uint8Array(crypto.randomBytes(32));
+      const bsn2 = new Uint8Array(crypto.randomBytes(32));
+      const msg = new Uint8Array(crypto.randomBytes(32));
+      expect(GroupSigner.presignPoolSize).to.be.at.least(4);
+      expect(signer.getPresignCount(bsn)).to.equal(0);
+      expect(() => signer.onlineSign(msg, bsn)).to.throw('no presignature for basename');
+
+      signer.presign(bsn, 2);
+      signer.presign(bsn2, 1);
+      expect(signer.getPresignCount(bsn)).to.equal(2);
+      expect(signer.getPresignCount(bsn2)).to.equal(1);
+      expect(() => signer.presign(bsn, GroupSigner.presignPoolSize)).to.throw('presignature pool full');
+      expect(() => signer.presign(bsn, -1)).to.throw();
+
+      const sig = signer.onlineSign(msg, bsn);
+      const sig2 = signer.onlineSign(msg, bsn);
+      const sig3 = signer.onlineSign(msg, bsn2);
+      expect(() => signer.onlineSign(msg, bsn)).to.throw('no presignature for basename');
+      expect(signer.getPresignCount(bsn)).to.equal(0);
+      expect(sig).to.not.deep.equal(sig2);
+      expect(signer.verify(msg, bsn, sig)).to.be.true;
+      expect(signer.verify(msg, bsn, sig2)).to.be.true;
+      expect(signer.verify(msg, bsn2, sig3)).to.be.true;
+      expect(signer.verify(msg, bsn2, sig)).to.be.false;
+      expect(signer.getSignatureTag(sig)).to.deep.equal(signer.getSignatureTag(signer.sign(msg, bsn)));
+
+      // New credentials discard the pool
+      signer.presign(bsn, 1);
+      signer.setUserCredentials(signer.getUserCredentials());
+      expect(signer.getPresignCount(bsn)).to.equal(0);
+    });
+
+    it('presign refill', function() {
+      if (!GroupSigner.prototype.startPresignRefill) {
+        this.skip();
+      }
+      const server = new GroupSigner();
+      server.seed(seed1);
+      server.setupGroup();
+
+      const { signer } = makeMember(server, seed2);
+      signer.setGroupPubKey(server.getGroupPubKey());
+
+      const bsn = new Uint8Array(crypto.randomBytes(32));
+      const msg = new Uint8Array(crypto.randomBytes(32));
+      const waitFor = (count) => new Promise((resolve) => {
+        const check = () => (signer.getPresignCount(bsn) === count ? resolve() : setTimeout(check, 5));
+        check();
+      });
+      expect(() => signer.startPresignRefill(bsn, 3, 2)).to.throw();
+      signer.startPresignRefill(bsn, 1, 3);
+      return waitFor(3).then(() => {
+        expect(signer.verify(msg, bsn, signer.onlineSign(msg, bsn))).to.be.true;
+        expect(signer.verify(msg, bsn, signer.onlineSign(msg, bsn))).to.be.true;
+        expect(signer.verify(msg, bsn, signer.onlineSign(msg, bsn))).to.be.true;
+        return waitFor(3);
+      }).then(() => {
+        signer.stopPresignRefill();
+        signer.onlineSign(msg, bsn);
+        expect(signer.getPresignCount(bsn)).to.equal(2);
+      });
+    });
+
+    it('presign refill - asynchronous calls', function() {
+      if (!GroupSigner.prototype.startPresignRefill) {
+        this.skip();
+      }
+      const server = new GroupSigner();
+      server.seed(seed1);
+      server.setupGroup();
+
+      const { signer } = makeMember(server, seed2);
+      signer.setGroupPubKey(server.getGroupPubKey());
+
+      const bsn = new Uint8Array(crypto.randomBytes(32));
+      const msg = new Uint8Array(crypto.randomBytes(32));
+      const waitFor = (count) => new Promise((resolve) => {
+        const check = () => (signer.getPresignCount(bsn) === count ? resolve() : setTimeout(check, 5));
+        check();
+      });
+      const sleep = (ms) => new Promise((resolve) => setTimeout(resolve, ms));
+
+      // Refilling waits while the signer is busy, instead of throwing
+      signer.startPresignRefill(bsn, 2, 4);
+      return Promise.all([signer.signAsync(msg, bsn), signer.signAsync(msg, bsn)]).then((sigs) => {
+        sigs.forEach((sig) => expect(signer.verify(msg, bsn, sig)).to.be.true);
+        return waitFor(4);
+      }).then(() => {
+        // Refilling stops when the signer is destroyed
+        signer.onlineSign(msg, bsn);
+        signer.onlineSign(msg, bsn);
+        signer.onlineSign(msg, bsn);
+        signer.destroy();
+        return sleep(50);
+      });
+    });
+
+    it('basename cache', () => {
+      const server = new GroupSigner();
+      server.seed(seed1);
+      server.setupGroup();
+
+      const { signer } = makeMember(server, seed2);
+      signer.setGroupPubKey(server.getGroupPubKey());
+
+      const { capacity } = GroupSigner.getBasenameCacheStats();
+      try {
+        GroupSigner.setBasenameCacheCapacity(2);
+        const bsns = [1, 2, 3].map(() => new Uint8Array(crypto.randomBytes(32)));
+        const msg = new Uint8Array(crypto.randomBytes(32));
+        const sigs = bsns.map(bsn => signer.sign(msg, bsn));
+
+        // sign() looked up bsns[0], bsns[1] and bsns[2]; bsns[0] was evicted
+        let stats = GroupSigner.getBasenameCacheStats();
+        expect(stats.capacity).to.equal(2);
+        expect(stats.size).to.equal(2);
+        const { hits, misses } = stats;
+        expect(signer.verify(msg, bsns[2], sigs[2])).to.be.true;
+        expect(signer.verify(msg, bsns[1], sigs[1])).to.be.true;
+        expect(signer.verify(msg, bsns[0], sigs[0])).to.be.true;
+        expect(signer.verify(msg, bsns[2], sigs[1])).to.be.false;
+        stats = GroupSigner.getBasenameCacheStats();
+        expect(stats.hits - hits).to.equal(2);
+        expect(stats.misses - misses).to.equal(2);
+
+        // Key registries map basenames without the cache
+        const registry = new GroupSigner.KeyRegistry();
+        registry.seed(seed1);
+        const id = registry.addGroupPubKey(server.getGroupPubKey());
+        expect(registry.verify(id, msg, bsns[2], sigs[2])).to.be.true;
+        expect(registry.verify(id, msg, bsns[0], sigs[0])).to.be.true;
+        registry.close();
+        const { hits: registryHits, misses: registryMisses } = GroupSigner.getBasenameCacheStats();
+        expect(registryHits).to.equal(stats.hits);
+        expect(registryMisses).to.equal(stats.misses);
+
+        GroupSigner.setBasenameCacheCapacity(0);
+        expect(signer.verify(msg, bsns[0], sigs[0])).to.be.true;
+        expect(signer.verify(msg, bsns[0], signer.sign(msg, bsns[0]))).to.be.true;
+        expect(GroupSigner.getBasenameCacheStats().size).to.equal(0);
+
+        expect(() => GroupSigner.setBasenameCacheCapacity(-1)).to.throw();
+        expect(() => GroupSigner.setBasenameCacheCapacity('1')).to.throw();
+      } finally {
+        GroupSigner.setBasenameCacheCapacity(capacity);
+      }
+    });
+
+    it('getRejectReason', () => {
+      const server = new GroupSigner();
+      server.seed(seed1);
+      server.setupGroup();
+      const { signer } = makeMember(server, seed2);
+      const msg = new Uint8Array(32);
+      const bsn = new Uint8Array(32);
+      const sig = signer.sign(msg, bsn);
+      const pointSize = (sig.length - 64) / 5; // A, B, C, D, NYM, c and s
+
+      expect(server.getRejectReason(msg, bsn, sig)).to.equal(null);
+      expect(server.getRejectReason(msg, bsn, sig.slice(0, 10))).to.equal('encoding');
+      expect(server.getRejectReason(new Uint8Array(31), bsn, sig)).to.equal('proof');
+      expect(server.getRejectReason(msg, new Uint8Array(31), sig)).to.equal('proof');
+
+      // A and C are only decoded if the proof of equality holds
+      const badA = new Uint8Array(sig);
+      badA[1] ^= 1;
+      expect(server.getRejectReason(msg, bsn, badA)).to.equal('encoding');
+      expect(() => server.verify(msg, bsn, badA)).to.throw('invalid signature');
+      expect(server.getRejectReason(new Uint8Array(31), bsn, badA)).to.equal('proof');
+      expect(server.verify(new Uint8Array(31), bsn, badA)).to.be.false;
+
+      // Credentials of another group
+      const other = new GroupSigner();
+      other.seed(seed2);
+      other.setupGroup();
+      expect(other.getRejectReason(msg, bsn, sig)).to.equal('pairing');
+      expect(other.verify(msg, bsn, sig)).to.be.false;
+
+      // Replace A with C: the proof holds, but not the pairings
+      const swapped = new Uint8Array(sig);
+      swapped.set(sig.slice(2 * pointSize, 3 * pointSize), 0);
+      expect(server.getRejectReason(msg, bsn, swapped)).to.equal('pairing');
+      expect(() => new GroupSigner().getRejectReason(msg, bsn, sig)).to.throw('group public key not set');
+    });
+
+    it('revocation', async () => {
+      const server = new GroupSigner();
+      server.seed(seed1);
+      server.setupGroup();
+      const revoked = makeMember(server, seed1);
+      const other = makeMember(server, seed2);
+      const msg = new Uint8Array(32);
+      const bsn = new Uint8Array(32);
+      const bsn2 = new Uint8Array(31);
+      const sig = revoked.signer.sign(msg, bsn);
+      const sig2 = revoked.signer.sign(msg, bsn2);
+      const sig3 = other.signer.sign(msg, bsn);
+
+      server.setRevocationList([revoked.gsk]);
+      expect(server.getRevocationListSize()).to.equal(1);
+      expect(server.verify(msg, bsn, sig)).to.be.false;
+      expect(server.getRejectReason(msg, bsn, sig)).to.equal('revoked');
+      expect(server.verify(msg, bsn2, sig2)).to.be.false;
+      expect(server.verify(msg, bsn, sig3)).to.be.true;
+      expect(server.verifyBatch([msg, msg, msg], [bsn, bsn2, bsn], [sig, sig2, sig3])).to.deep.equal([false, false, true]);
+      expect(await server.verifyAsync(msg, bsn, sig)).to.be.false;
+      expect(await server.verifyAsync(msg, bsn, sig3)).to.be.true;
+      // The proof of equality is checked first
+      expect(server.getRejectReason(new Uint8Array(31), bsn, sig)).to.equal('proof');
+
+      // Lists belong to each instance and registry key
+      const verifier = new GroupSigner();
+      verifier.seed(seed2);
+      verifier.setGroupPubKey(server.getGroupPubKey());
+      expect(verifier.getRevocationListSize()).to.equal(0);
+      expect(verifier.verify(msg, bsn, sig)).to.be.true;
+      const registry = new GroupSigner.KeyRegistry();
+      registry.seed(seed2);
+      const ids = [registry.addGroupPubKey(server.getGroupPubKey()), registry.addGroupPubKey(server.getGroupPubKey())];
+      registry.setRevocationList(ids[0], [revoked.gsk]);
+      expect(registry.getRevocationListSize(ids[0])).to.equal(1);
+      expect(registry.getRevocationListSize(ids[1])).to.equal(0);
+      expect(registry.verify(ids[0], msg, bsn, sig)).to.be.false;
+      expect(registry.verify(ids[0], msg, bsn, sig3)).to.be.true;
+      expect(registry.verify(ids[1], msg, bsn, sig)).to.be.true;
+      registry.removeGroupPubKey(ids[0]);
+      expect(() => registry.setRevocationList(ids[0], [])).to.throw('unknown key id');
+      expect(() => registry.getRevocationListSize(ids[0])).to.throw('unknown key id');
+      registry.close();
+
+      // A new list replaces the tables built for the previous one
+      server.setRevocationList([other.gsk, new Uint8Array(revoked.gsk.length).fill(1)]);
+      expect(server.verify(msg, bsn, sig)).to.be.true;
+      expect(server.getRejectReason(msg, bsn, sig3)).to.equal('revoked');
+
+      expect(() => server.setRevocationList(revoked.gsk)).to.throw('input data must be arrays of uint8array');
+      expect(() => server.setRevocationList([revoked.gsk.slice(1)])).to.throw('invalid revocation list');
+      expect(() => server.setRevocationList([new Uint8Array(revoked.gsk.length)])).to.throw('invalid revocation list');
+      expect(() => server.setRevocationList([new Uint8Array(revoked.gsk.length).fill(255)])).to.throw('invalid revocation list');
+      expect(server.getRevocationListSize()).to.equal(2);
+
+      server.setRevocationList([]);
+      expect(server.getRevocationListSize()).to.equal(0);
+      expect(server.verify(msg, bsn, sig)).to.be.true;
+      server.setRevocationList([revoked.gsk]);
+      server.destroy();
+    });
+
+    it('selfTest', () => {
+      // Known answers of the nonce generator (RFC 8439 ChaCha20 blocks)
+      expect(GroupSigner.selfTest()).to.be.true;
+    });
+
+    it('stats', function() {
+      // Only debug builds record statistics
+      if (GroupSigner.getStats() === null) {
+        GroupSigner.resetStats();
+        this.skip();
+      }
+      const server = new GroupSigner();
+      server.seed(seed1);
+      server.setupGroup();
+      const { signer } = makeMember(server, seed2);
+      const msg = new Uint8Array(32);
+      const bsn = new Uint8Array(crypto.randomBytes(32));
+      const sig = signer.sign(msg, bsn);
+
+      GroupSigner.resetStats();
+      let stats = GroupSigner.getStats();
+      expect(stats.clock).to.be.a('string');
+      expect(Object.keys(stats.stages)).to.deep.equal(['sign', 'verify', 'deserialize', 'hash', 'basename', 'mapit', 'proof', 'aux', 'pairing']);
+      Object.values(stats.stages).forEach((stage) => {
+        expect(stage.calls).to.equal(0);
+        expect(stage.ticks).to.equal(0);
+        expect(stage.histogram).to.have.lengthOf(32);
+      });
+
+      expect(server.verify(msg, bsn, sig)).to.be.true;
+      const tampered = new Uint8Array(sig);
+      tampered[tampered.length - 1] ^= 1;
+      // The proof of equality fails, so there are no pairings
+      expect(server.verify(msg, bsn, tampered)).to.be.false;
+      stats = GroupSigner.getStats();
+      expect(stats.stages.verify.calls).to.equal(2);
+      // The tampered signature is rejected before decoding A and C
+      expect(stats.stages.deserialize.calls).to.equal(3);
+      expect(stats.stages.pairing.calls).to.equal(1);
+      expect(stats.stages.sign.calls).to.equal(0);
+      Object.values(stats.stages).forEach((stage) => {
+        expect(stage.histogram.reduce((a, b) => a + b, 0)).to.equal(stage.calls);
+      });
+      expect(stats.stages.verify.ticks).to.be.at.least(stats.stages.pairing.ticks);
+    });
+
+    it('processJoinBatch', () => {
+      const server = new GroupSigner();
+      server.seed(seed1);
+      server.setupGroup();
+      // Same keys and random state as server
+      const server2 = new GroupSigner();
+      server2.seed(seed1);
+      server2.setupGroup();
+
+      const client = new GroupSigner();
+      client.seed(seed2);
+      const challenges = [];
+      const gsks = [];
+      const joinmsgs = [];
+      for (let i = 0; i < 5; i += 1) {
+        challenges.push(new Uint8Array(crypto.randomBytes(32)));
+        const { gsk, joinmsg } = client.startJoin(challenges[i]);
+        gsks.push(gsk);
+        joinmsgs.push(joinmsg);
+      }
+      // Wrong challenge and undecodable join message
+      challenges[1] = new Uint8Array(32);
+      joinmsgs[3] = new Uint8Array(10);
+
+      expect(server.processJoinBatch([], [])).to.deep.equal([]);
+      const responses = server.processJoinBatch(joinmsgs, challenges);
+      expect(responses.map(r => r === null)).to.deep.equal([false, true, false, true, false]);
+
+      // Same responses as processing the join messages one by one
+      joinmsgs.forEach((joinmsg, i) => {
+        if (responses[i] === null) {
+          expect(() => server2.processJoin(joinmsg, challenges[i])).to.throw('invalid join message');
+        } else {
+          expect(new Uint8Array(server2.processJoin(joinmsg, challenges[i]))).to.deep.equal(new Uint8Array(responses[i]));
+        }
+      });
+
+      const msg = new Uint8Array(32);
+      const bsn = new Uint8Array(32);
+      [0, 2, 4].forEach((i) => {
+        const signer = new GroupSigner();
+        signer.seed(seed2);
+        signer.setGroupPubKey(server.getGroupPubKey());
+        signer.setUserCredentials(signer.finishJoin(server.getGroupPubKey(), gsks[i], responses[i]));
+        expect(signer.verify(msg, bsn, signer.sign(msg, bsn))).to.be.true;
+      });
+
+      expect(() => server.processJoinBatch(joinmsgs)).to.throw('expected 2 arguments');
+      expect(() => server.processJoinBatch(joinmsgs, challenges[0])).to.throw('input data must be arrays of uint8array');
+      expect(() => server.processJoinBatch(joinmsgs, challenges.slice(1))).to.throw('input arrays must have the same length');
+      expect(() => server.processJoinBatch([1], [challenges[0]])).to.throw('input data must be uint8array');
+      expect(() => client.processJoinBatch(joinmsgs, challenges)).to.throw('group private key not set');
+    });
+
+    it('preissue', () => {
+      const server = new GroupSigner();
+      server.seed(seed1);
+      expect(() => server.preissue(1)).to.throw('group private key not set');
+      server.setupGroup();
+      expect(server.getPreissueCount()).to.equal(0);
+      server.preissue(2);
+      expect(server.getPreissueCount()).to.equal(2);
+      expect(() => server.preissue(GroupSigner.preissuePoolSize)).to.throw('issuance pool full');
+      expect(() => server.preissue(-1)).to.throw();
+
+      const client = new GroupSigner();
+      client.seed(seed2);
+      const msg = new Uint8Array(32);
+      const bsn = new Uint8Array(32);
+      const challenge = new Uint8Array(32);
+      for (let i = 0; i < 3; i += 1) {
+        const { gsk, joinmsg } = client.startJoin(challenge);
+        expect(() => server.processJoin(joinmsg, new Uint8Array(1))).to.throw('invalid join message');
+        const joinresp = server.processJoin(joinmsg, challenge);
+        expect(server.getPreissueCount()).to.equal(Math.max(1 - i, 0));
+        const signer = new GroupSigner();
+        signer.seed(seed2);
+        signer.setGroupPubKey(server.getGroupPubKey());
+        signer.setUserCredentials(signer.finishJoin(server.getGroupPubKey(), gsk, joinresp));
+        expect(signer.verify(msg, bsn, signer.sign(msg, bsn))).to.be.true;
+      }
+
+      // New keys discard the pool
+      server.preissue(1);
+      server.setGroupPrivKey(server.getGroupPrivKey());
+      expect(server.getPreissueCount()).to.equal(0);
+    });
+
+    it('wire format v2', () => {
+      const v1 = new GroupSigner();
+      v1.seed(seed1);
+      v1.setupGroup();
+      const v2 = new GroupSigner();
+      v2.seed(seed1);
+      v2.setupGroup();
+      v2.setWireFormat(2);
+      expect(() => v2.setWireFormat(3)).to.throw('invalid wire format');
+
+      // Same keys, in both formats
+      const pubKey1 = v1.getGroupPubKey();
+      const pubKey2 = v2.getGroupPubKey();
+      expect(pubKey2[0]).to.equal(0xC2);
+      expect(pubKey2.length).to.be.below(pubKey1.length);
+      expect(v2.getGroupPrivKey()[0]).to.equal(0xC2);
+      const loaded = new GroupSigner();
+      loaded.setGroupPrivKey(v2.getGroupPrivKey());
+      expect(loaded.getGroupPubKey()).to.deep.equal(pubKey1);
+      loaded.setGroupPubKey(pubKey2);
+      expect(loaded.getGroupPubKey()).to.deep.equal(pubKey1);
+
+      // Credentials follow the format of the join response
+      const client = new GroupSigner();
+      client.seed(seed2);
+      client.setWireFormat(2);
+      const challenge = new Uint8Array(32);
+      const { gsk, joinmsg } = client.startJoin(challenge);
+      expect(joinmsg[0]).to.equal(0xC2);
+      const joinresp1 = v1.processJoin(joinmsg, challenge);
+      const joinresp2 = v2.processJoin(joinmsg, challenge);
+      expect(joinresp2[0]).to.equal(0xC2);
+      const credentials1 = client.finishJoin(pubKey2, gsk, joinresp1);
+      const credentials2 = client.finishJoin(pubKey1, gsk, joinresp2);
+      expect(credentials2[0]).to.equal(0xC2);
+      expect(credentials2.length).to.be.below(credentials1.length);
+
+      const signer = new GroupSigner();
+      signer.seed(seed2);
+      signer.setUserCredentials(credentials2);
+      expect(signer.getUserCredentials()).to.deep.equal(credentials1);
+      const msg = new Uint8Array(32);
+      const bsn = new Uint8Array(32);
+      const sig1 = signer.sign(msg, bsn);
+      signer.setWireFormat(2);
+      signer.presign(bsn, 1);
+      const sig2 = signer.sign(msg, bsn);
+      const sig3 = signer.onlineSign(msg, bsn);
+      expect(sig2[0]).to.equal(0xC2);
+      expect(sig3.length).to.equal(sig2.length);
+      expect(sig2.length).to.be.below(sig1.length);
+
+      // Both formats are accepted, and tags do not depend on the format
+      for (const sig of [sig1, sig2, sig3]) {
+        expect(v1.verify(msg, bsn, sig)).to.be.true;
+        expect(v2.verify(msg, bsn, sig)).to.be.true;
+        expect(v1.getSignatureTag(sig)).to.deep.equal(v1.getSignatureTag(sig1));
+      }
+      expect(v1.verifyBatch([msg, msg], [bsn, bsn], [sig1, sig2])).to.deep.equal([true, true]);
+      const tampered = new Uint8Array(sig2);
+      tampered[tampered.length - 1] ^= 1;
+      expect(v1.verify(msg, bsn, tampered)).to.be.false;
+    });
+
+    it('async', () => {
+      const server = new GroupSigner();
+      server.seed(seed1);
+      server.setupGroup();
+      const challenge = new Uint8Array(32);
+      const msg = new Uint8Array(32);
+      const bsn = new Uint8Array(32);
+      const signers = [seed1, seed2].map((seed) => {
+        const signer = new GroupSigner();
+        signer.seed(seed);
+        signer.setGroupPubKey(server.getGroupPubKey());
+        return signer;
+      });
+
+      return Promise.all(signers.map((signer) => {
+        const { gsk, joinmsg } = signer.startJoin(challenge);
+        return server.processJoinAsync(joinmsg, challenge).then((joinresp) => {
+          signer.setUserCredentials(signer.finishJoin(server.getGroupPubKey(), gsk, joinresp));
+        });
+      })).then(() => {
+        // Calls on the same instance are queued, and inputs are copied
+        const msg2 = new Uint8Array(msg);
+        const calls = [signers[0].signAsync(msg2, bsn), signers[0].signAsync(msg, bsn), signers[1].signAsync(msg, bsn)];
+        msg2[0] = 1;
+        if (name === 'native') {
+          expect(() => signers[0].sign(msg, bsn)).to.throw('GroupSigner is busy');
+          expect(() => signers[0].destroy()).to.throw('GroupSigner is busy');
+        }
+        return Promise.all(calls);
+      }).then((sigs) => {
+        const tampered = new Uint8Array(sigs[0]);
+        tampered[tampered.length - 1] ^= 1;
+        return Promise.all(sigs.concat([tampered]).map((sig) => server.verifyAsync(msg, bsn, sig)));
+      }).then((results) => {
+        expect(results).to.deep.equal([true, true, true, false]);
+        expect(server.verify(msg, bsn, signers[0].sign(msg, bsn))).to.be.true;
+        return server.verifyAsync(msg, bsn, new Uint8Array(1)).then(() => {
+          throw new Error('expected rejection');
+        }, (e) => {
+          expect(e.message).to.equal('invalid signature');
+        });
+      }).then(() => {
+        return server.signAsync(msg, bsn).then(() => {
+          throw new Error('expected rejection');
+        }, (e) => {
+          expect(e.message).to.equal('user credentials not set');
+        });
+      });
+    });
+
+    it('prepared group public key', () => {
+      const server = new GroupSigner();
+      server.seed(seed1);
+      server.setupGroup();
+      const { signer } = makeMember(server, seed2);
+      const msg = new Uint8Array(32);
+      const bsn = new Uint8Array(32);
+      const sig = signer.sign(msg, bsn);
+
+      const key = server.getPreparedGroupPubKey();
+      expect(key.length).to.equal(GroupSigner.preparedGroupPubKeySize);
+      const verifier = new GroupSigner();
+      expect(() => verifier.getPreparedGroupPubKey()).to.throw('group public key not set');
+      expect(() => verifier.setPreparedGroupPubKey(new Uint8Array(10))).to.throw('invalid group public key');
+      // Right size, but without the header or with a modified key
+      expect(() => verifier.setPreparedGroupPubKey(new Uint8Array(key.length))).to.throw('invalid group public key');
+      const modified = new Uint8Array(key);
+      modified[key.length - 1] ^= 1;
+      expect(() => verifier.setPreparedGroupPubKey(modified)).to.throw('invalid group public key');
+      verifier.setPreparedGroupPubKey(key);
+      expect(verifier.getGroupPubKey()).to.deep.equal(server.getGroupPubKey());
+      expect(verifier.getPreparedGroupPubKey()).to.deep.equal(key);
+      expect(verifier.verify(msg, bsn, sig)).to.be.true;
+      msg[0] = 1;
+      expect(verifier.verify(msg, bsn, sig)).to.be.false;
+    });
+
+    it('worker threads', function() {
+      if (name !== 'native') {
+        this.skip();
+      }
+      const { Worker } = require('worker_threads');
+      const server = new GroupSigner();
+      server.seed(seed1);
+      server.setupGroup();
+      const { signer } = makeMember(server, seed2);
+      const msg = new Uint8Array(32);
+      const bsn = new Uint8Array(32);
+      const sig = signer.sign(msg, bsn);
+
+      const key = server.getPreparedGroupPubKey();
+      expect(key.buffer).to.be.instanceof(SharedArrayBuffer);
+      expect(key.length).to.equal(GroupSigner.preparedGroupPubKeySize);
+      const verifier = new GroupSigner();
+      verifier.setPreparedGroupPubKey(key);
+      expect(verifier.verify(msg, bsn, sig)).to.be.true;
+
+      // Each worker loads the addon in its own environment
+      const workerData = { module: require.resolve(moduleName), key, msg, bsn, sig };
+      return Promise.all([0, 1].map(() => new Promise((resolve, reject) => {
+        const worker = new Worker(`
+          const { parentPort, workerData } = require('worker_threads');
+          const GroupSigner = require(workerData.module).GroupSigner;
+          const verifier = new GroupSigner();
+          verifier.seed(new Uint8Array(128));
+          verifier.setPreparedGroupPubKey(workerData.key);
+          verifier.verifyAsync(workerData.msg, workerData.bsn, workerData.sig).then((valid) => {
+            parentPort.postMessage(valid);
+          });
+        `, { eval: true, workerData });
+        worker.on('message', resolve);
+        worker.on('error', reject);
+      }))).then((results) => {
+        expect(results).to.deep.equal([true, true]);
+      });
+    });
+
+    it('tag store', () => {
+      const server = new GroupSigner();
+      server.seed(seed1);
+      server.setupGroup();
+      const { signer } = makeMember(server, seed2);
+      const bsn = new Uint8Array(32);
+      const bsn2 = new Uint8Array(31);
+      const sig = signer.sign(new Uint8Array(32), bsn);
+      const sig2 = signer.sign(new Uint8Array(31), bsn);
+      const sig3 = signer.sign(new Uint8Array(32), bsn2);
+
+      const store = new GroupSigner.TagStore(2);
+      expect(store.getCapacity()).to.equal(2);
+      expect(store.insert(sig, bsn, 1)).to.be.true;
+      expect(store.insert(sig, bsn, 1)).to.be.false;
+      // Linked by basename, even though the signatures differ
+      expect(store.insert(sig2, bsn, 2)).to.be.false;
+      expect(store.insert(sig3, bsn2, 2)).to.be.true;
+      expect(store.getCount()).to.equal(2);
+      expect(() => store.insert(signer.sign(new Uint8Array(32), new Uint8Array(30)), bsn)).to.throw('tag store full');
+      expect(() => store.insert(new Uint8Array(10), bsn)).to.throw('invalid signature');
+      expect(() => store.insert(sig)).to.throw('expected 2 or 3 arguments');
+      expect(() => store.insert(sig, bsn, -1)).to.throw('epoch must be a non-negative integer');
+
+      // A duplicate keeps the epoch of the first insertion
+      expect(store.expire(2)).to.equal(1);
+      expect(store.getCount()).to.equal(1);
+      expect(store.insert(sig2, bsn, 2)).to.be.true;
+      expect(store.insert(sig3, bsn2)).to.be.false;
+      expect(store.expire(3)).to.equal(2);
+      expect(store.getCount()).to.equal(0);
+
+      store.close();
+      expect(() => store.getCount()).to.throw('TagStore has been closed');
+      store.close();
+      expect(() => new GroupSigner.TagStore(0)).to.throw('invalid tag store capacity');
+    });
+
+    it('key registry', () => {
+      const servers = [seed1, seed2].map((seed) => {
+        const server = new GroupSigner();
+        server.seed(seed);
+        server.setupGroup();
+        return server;
+      });
+      const signers = servers.map((server) => makeMember(server, seed2).signer);
+      const msg = new Uint8Array(32);
+      const bsn = new Uint8Array(32);
+      const sigs = signers.map((signer) => signer.sign(msg, bsn));
+
+      const registry = new GroupSigner.KeyRegistry();
+      const ids = servers.map((server) => registry.addGroupPubKey(server.getGroupPubKey()));
+      expect(ids[0]).to.not.equal(ids[1]);
+      expect(registry.getKeyCount()).to.equal(2);
+      expect(() => registry.verify(ids[0], msg, bsn, sigs[0])).to.throw('not seeded');
+      expect(() => registry.seed(new Uint8Array(10))).to.throw('seed too small');
+      registry.seed(seed1);
+
+      expect(registry.verify(ids[0], msg, bsn, sigs[0])).to.be.true;
+      expect(registry.verify(ids[1], msg, bsn, sigs[1])).to.be.true;
+      expect(registry.verify(ids[0], msg, bsn, sigs[1])).to.be.false;
+      expect(registry.verify(ids[1], new Uint8Array(31), bsn, sigs[1])).to.be.false;
+      expect(() => registry.verify(ids[0], msg, bsn, sigs[0].slice(0, 10))).to.throw('invalid signature');
+      expect(() => registry.verify(ids[0], msg, bsn)).to.throw('expected 4 arguments');
+      expect(() => registry.verify(12345, msg, bsn, sigs[0])).to.throw('unknown key id');
+      expect(() => registry.addGroupPubKey(new Uint8Array(10))).to.throw('invalid group public key');
+
+      const usage = registry.getMemoryUsage();
+      expect(usage.keys).to.equal(2);
+      expect(usage.bytesPerKey).to.be.above(0);
+      expect(usage.bytes).to.be.at.least(2 * usage.bytesPerKey);
+
+      // Ids of removed keys are not valid for the keys that take their slots
+      expect(registry.removeGroupPubKey(ids[0])).to.be.true;
+      expect(registry.removeGroupPubKey(ids[0])).to.be.false;
+      expect(registry.getMemoryUsage().bytes).to.equal(usage.bytes - usage.bytesPerKey);
+      const id = registry.addGroupPubKey(servers[1].getGroupPubKey());
+      expect(id).to.not.equal(ids[0]);
+      expect(() => registry.verify(ids[0], msg, bsn, sigs[1])).to.throw('unknown key id');
+      expect(registry.verify(id, msg, bsn, sigs[1])).to.be.true;
+
+      registry.close();
+      expect(() => registry.getKeyCount()).to.throw('KeyRegistry has been closed');
+      registry.close();
+    });
+
+    it('persistent tag store', function() {
+      if (name !== 'native' || process.platform === 'win32') {
+        this.skip();
+      }
+      const fs = require('fs');
+      const os = require('os');
+      const path = require('path');
+      const server = new GroupSigner();
+      server.seed(seed1);
+      server.setupGroup();
+      const { signer } = makeMember(server, seed2);
+      const bsn = new Uint8Array(32);
+      const sig = signer.sign(new Uint8Array(32), bsn);
+
+      const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'groupsign-'));
+      const file = path.join(dir, 'tags');
+      try {
+        const store = new GroupSigner.TagStore(16, file);
+        expect(store.insert(sig, bsn, 1)).to.be.true;
+        expect(() => new GroupSigner.TagStore(16, file)).to.throw('tag store is in use');
+        store.sync();
+        store.close();
+
+        const reopened = new GroupSigner.TagStore(16, file);
+        expect(reopened.getCount()).to.equal(1);
+        expect(reopened.insert(signer.sign(new Uint8Array(31), bsn), bsn, 2)).to.be.false;
+        reopened.close();
+
+        expect(() => new GroupSigner.TagStore(32, file)).to.throw('invalid tag store');
+        fs.writeFileSync(file, new Uint8Array(fs.statSync(file).size));
+        expect(() => new GroupSigner.TagStore(16, file)).to.throw('invalid tag store');
+
+        // A used slot that the count of a valid empty store does not include
+        fs.writeFileSync(file, new Uint8Array(0));
+        new GroupSigner.TagStore(16, file).close();
+        const bytes = fs.readFileSync(file);
+        const entrySize = (bytes.length - 24) / 32; // 24 byte header, 32 slots
+        bytes.writeInt32LE(1, 24 + entrySize - 4); // used flag of the first entry
+        fs.writeFileSync(file, bytes);
+        expect(() => new GroupSigner.TagStore(16, file)).to.throw('invalid tag store');
+      } finally {
+        fs.rmSync(dir, { recursive: true, force: true });
+      }
+    });
+
+    it('destroy', () => {
+      const signer = new GroupSigner();
+      signer.seed(seed1);
+      signer.setupGroup();
+      const pubKey = signer.getGroupPubKey();
+      signer.destroy();
+      expect(() => signer.getGroupPubKey()).to.throw('GroupSigner has been destroyed');
+      expect(() => signer.seed(seed1)).to.throw('GroupSigner has been destroyed');
+      signer.destroy();
+
+      // Other instances are not affected
+      const verifier = new GroupSigner();
+      verifier.setGroupPubKey(pubKey);
+      expect(verifier.getGroupPubKey()).to.deep.equal(pubKey);
+      verifier.destroy();
+    });
+
     it('joinStatic - regression', () => {
       const server = new GroupSigner();
       server.seed(seed1);